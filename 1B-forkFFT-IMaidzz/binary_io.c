@@ -0,0 +1,343 @@
+/**
+ * @file binary_io.c
+ * @author Name Surname <3 <matrikelnummer@student.tuwien.ac.at>
+ * @date 13.11.2023
+ *
+ * @brief binary input and output of complex numbers
+ * 
+ * @details input from a regular file is mapped with mmap, so nothing is parsed or copied before the
+ * numbers are converted. The bytes are always decoded as little endian, no matter what the host uses
+ **/
+
+#include "binary_io.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <errno.h>
+#include <string.h>
+
+#define NPY_MAGIC "\x93NUMPY"
+#define NPY_MAGIC_LENGTH (6)
+
+// the header of a version 1 file is padded so the data starts at a multiple of this
+#define NPY_ALIGNMENT (64)
+
+
+/**
+ * @brief reads everything from the file descriptor into a growing buffer.
+ *
+ * @return Returns 0 if successful. Otherwise -1 is returned.
+ */
+static int read_all(int fd, binary_input *input){
+    size_t capacity = 1 << 16;
+    size_t size = 0;
+    unsigned char *buffer = malloc(capacity);
+    if (buffer == NULL)
+    {
+        return -1;
+    }
+
+    while (1)
+    {
+        if (size == capacity)
+        {
+            capacity *= 2;
+            unsigned char *buffer_temp = realloc(buffer, capacity);
+            if (buffer_temp == NULL)
+            {
+                free(buffer);
+                return -1;
+            }
+            buffer = buffer_temp;
+        }
+
+        ssize_t n = read(fd, buffer + size, capacity - size);
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n == -1)
+        {
+            free(buffer);
+            return -1;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        size += n;
+    }
+
+    input->memory = buffer;
+    input->memory_size = size;
+    input->mapped = 0;
+    return 0;
+}
+
+
+/**
+ * @brief returns the value of the key in the header dictionary (leading spaces are skipped).
+ */
+static const char *find_value(const char *header, const char *key){
+    const char *value = strstr(header, key);
+    if (value == NULL)
+    {
+        return NULL;
+    }
+    value += strlen(key);
+    while (*value == ' ')
+    {
+        value++;
+    }
+    return value;
+}
+
+
+/**
+ * @brief parses the header of a .npy file.
+ *
+ * @details Only one dimensional arrays of '<c8' or '<c16' are supported.
+ *
+ * @return Returns 0 if successful. Otherwise -1 is returned (malformed or not supported).
+ */
+static int parse_npy_header(binary_input *input){
+    const unsigned char *bytes = input->memory;
+    size_t size = input->memory_size;
+    size_t header_start;
+    size_t header_length;
+
+    if (size < 10)
+    {
+        return -1;
+    }
+    if (bytes[6] == 1)
+    {
+        header_start = 10;
+        header_length = bytes[8] | (size_t)bytes[9] << 8;
+    }
+    else if ((bytes[6] == 2 || bytes[6] == 3) && size >= 12)
+    {
+        header_start = 12;
+        header_length = bytes[8] | (size_t)bytes[9] << 8 | (size_t)bytes[10] << 16 | (size_t)bytes[11] << 24;
+    }
+    else
+    {
+        return -1;
+    }
+    if (header_start + header_length > size)
+    {
+        return -1;
+    }
+
+    char *header = malloc(header_length + 1);
+    if (header == NULL)
+    {
+        return -1;
+    }
+    memcpy(header, bytes + header_start, header_length);
+    header[header_length] = '\0';
+
+    int result = -1;
+    const char *descr = find_value(header, "'descr':");
+    const char *shape = find_value(header, "'shape':");
+    input->precision = 0;
+    if (descr != NULL && strncmp(descr, "'<c8'", 5) == 0)
+    {
+        input->precision = 4;
+    }
+    else if (descr != NULL && strncmp(descr, "'<c16'", 6) == 0)
+    {
+        input->precision = 8;
+    }
+
+    // only the shape (n,) is supported
+    if (input->precision != 0 && shape != NULL && *shape == '(')
+    {
+        char *end = NULL;
+        errno = 0;
+        input->count = strtoull(shape + 1, &end, 10);
+        if (errno == 0 && end != shape + 1)
+        {
+            end += strspn(end, " ");
+            if (*end == ',')
+            {
+                end += 1 + strspn(end + 1, " ");
+                result = *end == ')' ? 0 : -1;
+            }
+        }
+    }
+    free(header);
+
+    if (result == 0)
+    {
+        input->data = bytes + header_start + header_length;
+        input->npy = 1;
+        if (input->count > (size - header_start - header_length) / (2 * (size_t)input->precision))
+        {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+int binary_input_open(int fd, int precision, binary_input *input){
+    struct stat info;
+    memset(input, 0, sizeof(binary_input));
+
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            return -1;
+        }
+        // the numbers are read once from front to back
+        madvise(map, info.st_size, MADV_SEQUENTIAL);
+        input->memory = map;
+        input->memory_size = info.st_size;
+        input->mapped = 1;
+    }
+    else if (read_all(fd, input) == -1)
+    {
+        return -1;
+    }
+
+    if (input->memory_size >= NPY_MAGIC_LENGTH && memcmp(input->memory, NPY_MAGIC, NPY_MAGIC_LENGTH) == 0)
+    {
+        if (parse_npy_header(input) == -1)
+        {
+            binary_input_close(input);
+            errno = EINVAL;
+            return -1;
+        }
+        return 0;
+    }
+
+    input->data = input->memory;
+    input->precision = precision;
+    input->count = input->memory_size / (2 * precision);
+    if (input->memory_size % (2 * precision) != 0)
+    {
+        binary_input_close(input);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief decodes a little-endian float32 or float64.
+ */
+static double decode(const unsigned char *bytes, int precision){
+    if (precision == 4)
+    {
+        uint32_t bits = 0;
+        for (int i = 3; i >= 0; i--)
+        {
+            bits = bits << 8 | bytes[i];
+        }
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint64_t bits = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        bits = bits << 8 | bytes[i];
+    }
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+/**
+ * @brief encodes the value as little-endian float32 or float64.
+ */
+static void encode(unsigned char *bytes, int precision, double value){
+    uint64_t bits;
+    if (precision == 4)
+    {
+        float single = value;
+        uint32_t single_bits;
+        memcpy(&single_bits, &single, sizeof(single_bits));
+        bits = single_bits;
+    }
+    else
+    {
+        memcpy(&bits, &value, sizeof(bits));
+    }
+
+    for (int i = 0; i < precision; i++)
+    {
+        bytes[i] = bits >> (8 * i);
+    }
+}
+
+void binary_input_get(const binary_input *input, size_t i, double *real, double *imaginary){
+    const unsigned char *number = input->data + 2 * (size_t)input->precision * i;
+    *real = decode(number, input->precision);
+    *imaginary = decode(number + input->precision, input->precision);
+}
+
+void binary_input_close(binary_input *input){
+    if (input->memory == NULL)
+    {
+        return;
+    }
+    if (input->mapped)
+    {
+        munmap(input->memory, input->memory_size);
+    }
+    else
+    {
+        free(input->memory);
+    }
+    input->memory = NULL;
+}
+
+int binary_output_header(FILE *out, int precision, int npy, size_t count){
+    if (!npy)
+    {
+        return 0;
+    }
+
+    char header[NPY_ALIGNMENT * 2];
+    int length = snprintf(header, sizeof(header), "{'descr': '<c%d', 'fortran_order': False, 'shape': (%zu,), }",
+                          2 * precision, count);
+
+    // magic, version, header length, header, padding and newline
+    size_t total = NPY_MAGIC_LENGTH + 4 + length + 1;
+    size_t padding = (NPY_ALIGNMENT - total % NPY_ALIGNMENT) % NPY_ALIGNMENT;
+    size_t header_length = length + padding + 1;
+    unsigned char prefix[] = {1, 0, header_length & 0xff, header_length >> 8};
+
+    if (fwrite(NPY_MAGIC, 1, NPY_MAGIC_LENGTH, out) != NPY_MAGIC_LENGTH ||
+        fwrite(prefix, 1, sizeof(prefix), out) != sizeof(prefix) ||
+        fwrite(header, 1, length, out) != (size_t)length)
+    {
+        return -1;
+    }
+    for (size_t i = 0; i < padding; i++)
+    {
+        if (fputc(' ', out) == EOF)
+        {
+            return -1;
+        }
+    }
+    return fputc('\n', out) == EOF ? -1 : 0;
+}
+
+int binary_output_write(FILE *out, int precision, double real, double imaginary){
+    unsigned char number[16];
+    encode(number, precision, real);
+    encode(number + precision, precision, imaginary);
+    return fwrite(number, 1, 2 * precision, out) == (size_t)(2 * precision) ? 0 : -1;
+}
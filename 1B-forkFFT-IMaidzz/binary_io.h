@@ -0,0 +1,72 @@
+/**
+ * @file binary_io.h
+ * @author Name Surname <3 <matrikelnummer@student.tuwien.ac.at>
+ * @date 13.11.2023
+ *
+ * @brief binary input and output of complex numbers
+ * 
+ * @details The numbers are raw little-endian pairs of float32 or float64 (real part, imaginary part),
+ * the same layout as numpy's complex64/complex128. Input that starts with the .npy magic string
+ * is read as a numpy array of shape (n,) and dtype '<c8' or '<c16'.
+ **/
+
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief binary input that is mapped or read into memory
+ * 
+ * @details data is the first number, count the number of complex numbers, precision the size
+ * of one part in bytes (4 or 8), npy is 1 if the input was a .npy file. memory and memory_size
+ * describe the mapping (mapped is 1) or the buffer (mapped is 0) that needs to be released.
+*/
+typedef struct binary_input{
+    const unsigned char *data;
+    size_t count;
+    int precision;
+    int npy;
+    void *memory;
+    size_t memory_size;
+    int mapped;
+} binary_input;
+
+/**
+ * @brief reads all numbers from the file descriptor
+ * 
+ * @details regular files are mapped with mmap instead of read
+ * 
+ * @param fd the file descriptor to read from
+ * @param precision 4 or 8, the size of a part of raw input (.npy input brings its own)
+ * @param input where the input is stored
+ * @return 0 on success and -1 on error (errno is EINVAL if the input is malformed)
+*/
+int binary_input_open(int fd, int precision, binary_input *input);
+
+/**
+ * @brief returns the i-th number of the input
+*/
+void binary_input_get(const binary_input *input, size_t i, double *real, double *imaginary);
+
+/**
+ * @brief releases the memory of the input
+*/
+void binary_input_close(binary_input *input);
+
+/**
+ * @brief writes the .npy header for count numbers, does nothing if npy is 0
+ * 
+ * @return 0 on success and -1 on error
+*/
+int binary_output_header(FILE *out, int precision, int npy, size_t count);
+
+/**
+ * @brief writes one number as little-endian pair with precision bytes per part
+ * 
+ * @return 0 on success and -1 on error
+*/
+int binary_output_write(FILE *out, int precision, double real, double imaginary);
+
+#endif
@@ -6,6 +6,8 @@
  * @brief The program calculates the FFT value of the given inputs which must be two floating point values per line
  * symbolising the real and imaginary part of the imaginary number, and there must be an even number of imaginary numbers
  * The only optinal arggument -p symply specifies that the result should not print more than 3 deimal values after the dot
+ * With -b the numbers are read and written as binary little-endian complex pairs instead (see binary_io.h)
+ * With -s the processes work on one shared memory region and the pipes only signal that a child is done
  **/
 
 
@@ -13,6 +15,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <regex.h>
 #include <string.h>
 #include <math.h>
@@ -20,6 +23,8 @@
 #include <errno.h>
 #include <ctype.h>
 
+#include "binary_io.h"
+
 //from the four pipes the one designated for the first child to read from
 #define FIRST_CHILD_READ (0)
 //from the four pipes the one designated for the first child to write to
@@ -40,6 +45,9 @@
 //standin buffersize for memory allocation
 #define BUFSIZE (200)
 
+//in shared memory mode subtrees with at most this many numbers are calculated without forking
+#define SHARED_LEAF_SIZE (4096)
+
 char * prog_name;
 
 /**
@@ -70,8 +78,11 @@ void error_exit(const char * msg){
  * @param prog_name the name of the program
 */
 void usage(char* prog_name){
-    fprintf(stdout, "USAGE: %s [-p]\n",prog_name);
+    fprintf(stdout, "USAGE: %s [-p] [-b [-d]]\n",prog_name);
     fprintf(stdout, "[-p]: Option argument specifying that the output numbers should only have 3 decimal places, otherwise it's 6\n");
+    fprintf(stdout, "[-b]: Option argument specifying that the numbers are read and written as binary float32 pairs or .npy files\n");
+    fprintf(stdout, "[-d]: Option argument specifying that the binary pairs are float64\n");
+    fprintf(stdout, "[-s]: Option argument specifying that the children calculate in shared memory, the input size must be a power of two\n");
 }
 
 /**
@@ -296,6 +307,411 @@ double complex get_imaginary_num_from_line(char *input) {
     return c;
 }
 
+/**
+ * @brief
+ * combines one result of each child
+ * 
+ * @details
+ * calculates R[k] = E[k] + W^k * O[k] and R[k + n/2] = E[k] - W^k * O[k] 
+ * with the twiddle factor W^k = e^(-2*pi*i*k/n)
+ * 
+ * @param c the result E[k] of the first child (even inputs)
+ * @param c2 the result O[k] of the second child (odd inputs)
+ * @param k the index of the results
+ * @param n the number of inputs of this process
+ * @param rez where R[k] is stored
+ * @param rez2 where R[k + n/2] is stored
+*/
+
+void butterfly(double complex c, double complex c2, int k, int n, double complex *rez, double complex *rez2){
+
+    double constant = -2*PI/n;
+
+    //multiplication formula in complex numbers
+
+    //the middle part
+    double complex w = cos(constant*k) + sin(constant*k)*I;
+    //multiplzing with the odd result
+    w = w*c2;
+    //adding with the even result
+    *rez = creal(w) + creal(c) + (cimag(w) + cimag(c))*I;
+    //substracting from the odd result
+    *rez2 = creal(c) - creal(w) + (cimag(c) - cimag(w))*I;
+}
+
+/**
+ * @brief
+ * forks a child process that runs this program again
+ * 
+ * @details
+ * the child reads its stdin from pipes[write_pipe] and writes its stdout to pipes[read_pipe],
+ * in binary mode it is started with -b -d so the numbers keep their full precision
+ * 
+ * @param pipes the four pipes of the parent
+ * @param read_pipe the pipe the parent reads the results of the child from
+ * @param write_pipe the pipe the parent writes the inputs of the child to
+ * @param binary 1 if the child should run in binary mode
+ * @return the pid of the child
+*/
+
+pid_t fork_child(int pipes[4][2], int read_pipe, int write_pipe, int binary){
+
+    pid_t pid = fork();
+
+    if (pid == -1)
+    {
+        error_exit("error while forking child");
+    }
+
+    if (pid == 0)
+    {
+        //duping the child pipes to stdin and stdout respectively
+        if (dup2(pipes[write_pipe][READ], STDIN_FILENO) == -1)
+        {
+            error_exit("error while dupping reading pipe of child");
+        }
+
+        if (dup2(pipes[read_pipe][WRITE], STDOUT_FILENO) == -1)
+        {
+            error_exit("error while dupping writing pipe of child");
+        }
+
+        close_all_pipes(pipes);
+
+        //executing the parent program in the child recursively
+        if (binary > 0)
+        {
+            execlp(prog_name, prog_name, "-b", "-d", NULL);
+        }else{
+            execlp(prog_name, prog_name, NULL);
+        }
+
+        //this line should not be reached if execlp was succsessful
+        error_exit("execlp didnt work properly");
+    }
+
+    return pid;
+}
+
+/**
+ * @brief
+ * calculates the FFT of a slice of the shared memory region
+ * 
+ * @details
+ * moves the even numbers of the slice to its first and the odd ones to its second half,
+ * lets two children calculate the halves in place and combines their results. The children
+ * are forked without exec so they see the same mapping, the pipe of each child only carries
+ * one byte when it is done. Slices with at most SHARED_LEAF_SIZE numbers are calculated in 
+ * this process
+ * 
+ * @param data the slice, the result replaces the numbers
+ * @param scratch a slice of the same size for moving the numbers
+ * @param n the number of numbers in the slice (a power of two)
+*/
+
+void shared_fft(double complex *data, double complex *scratch, size_t n){
+
+    if (n == 1)
+    {
+        return;
+    }
+
+    size_t half = n / 2;
+
+    for (size_t i = 0; i < half; i++)
+    {
+        scratch[i] = data[2 * i];
+        scratch[i + half] = data[2 * i + 1];
+    }
+    memcpy(data, scratch, n * sizeof(double complex));
+
+    if (n <= SHARED_LEAF_SIZE)
+    {
+        shared_fft(data, scratch, half);
+        shared_fft(data + half, scratch + half, half);
+    }else{
+        int done[2][2];
+        pid_t pid[2];
+
+        for (int i = 0; i < 2; i++)
+        {
+            if (pipe(done[i]) == -1)
+            {
+                error_exit("Error while creating pipes");
+            }
+
+            if ((pid[i] = fork()) == -1)
+            {
+                error_exit("error while forking child");
+            }
+
+            if (pid[i] == 0)
+            {
+                close(done[i][READ]);
+                shared_fft(data + i * half, scratch + i * half, half);
+
+                if (write(done[i][WRITE], "", 1) != 1)
+                {
+                    error_exit("could not tell the parent that the child is done");
+                }
+
+                //_exit so the stdio buffers copied from the parent are not flushed twice
+                _exit(EXIT_SUCCESS);
+            }
+
+            close(done[i][WRITE]);
+        }
+
+        for (int i = 0; i < 2; i++)
+        {
+            char signal;
+            ssize_t r;
+
+            while ((r = read(done[i][READ], &signal, 1)) == -1 && errno == EINTR);
+
+            close(done[i][READ]);
+
+            if (r != 1)
+            {
+                error_exit("a child died before it was done");
+            }
+        }
+
+        wait_for_kid(pid[0], pid[1]);
+    }
+
+    for (size_t k = 0; k < half; k++)
+    {
+        butterfly(data[k], data[k + half], k, n, &data[k], &data[k + half]);
+    }
+}
+
+/**
+ * @brief
+ * calculates the FFT of the numbers with a process tree working in shared memory
+ * 
+ * @details
+ * maps one anonymous shared region for the numbers and the scratch space before forking,
+ * so no number goes through a pipe. The result replaces the numbers
+ * 
+ * @param numbers the numbers
+ * @param count the number of numbers (a power of two)
+*/
+
+void fft_shared(double complex *numbers, size_t count){
+
+    if (count == 0 || (count & (count - 1)) != 0)
+    {
+        error_exit("the input size must be a power of two with -s");
+    }
+
+    size_t size = 2 * count * sizeof(double complex);
+    double complex *region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (region == MAP_FAILED)
+    {
+        error_exit("could not map the shared memory");
+    }
+
+    memcpy(region, numbers, count * sizeof(double complex));
+
+    //no output is pending, but the children must not inherit anything buffered
+    fflush(stdout);
+
+    shared_fft(region, region + count, count);
+
+    memcpy(numbers, region, count * sizeof(double complex));
+    munmap(region, size);
+}
+
+/**
+ * @brief
+ * writes the results in binary format and terminates the program
+ * 
+ * @param rez the results
+ * @param count the number of results
+ * @param precision 4 or 8, the size of a part
+ * @param npy 1 if a .npy header is written first
+*/
+
+void write_binary_results(double complex *rez, size_t count, int precision, int npy){
+
+    int failed = binary_output_header(stdout, precision, npy, count) == -1;
+
+    for (size_t i = 0; i < count && !failed; i++)
+    {
+        failed = binary_output_write(stdout, precision, creal(rez[i]), cimag(rez[i])) == -1;
+    }
+
+    free(rez);
+
+    if (failed || fflush(stdout) == EOF)
+    {
+        error_exit("could not write the binary output");
+    }
+
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * @brief
+ * calculates the FFT of binary input
+ * 
+ * @details
+ * reads all numbers from stdin (mapped if stdin is a file), sends the even and odd ones to two
+ * children as binary float64 pairs, combines their binary results and writes the result in the
+ * format of the input to stdout. Terminates the program
+ * 
+ * @param precision 4 or 8, the size of a part of raw binary input
+ * @param shared 1 if the FFT is calculated in shared memory (see fft_shared)
+*/
+
+void run_binary(int precision, int shared){
+
+    binary_input input;
+
+    if (binary_input_open(STDIN_FILENO, precision, &input) == -1)
+    {
+        error_exit("could not read the binary input");
+    }
+
+    //the output has the format of the input
+    size_t count = input.count;
+    int out_precision = input.precision;
+    int npy = input.npy;
+
+    if (count == 1)
+    {
+        double real;
+        double imaginary;
+        binary_input_get(&input, 0, &real, &imaginary);
+        binary_input_close(&input);
+
+        if (binary_output_header(stdout, out_precision, npy, 1) == -1 ||
+            binary_output_write(stdout, out_precision, real, imaginary) == -1 || fflush(stdout) == EOF)
+        {
+            error_exit("could not write the binary output");
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    if (count == 0 || count % 2 != 0)
+    {
+        binary_input_close(&input);
+        error_exit(count == 0 ? "no input" : "uneven input");
+    }
+
+    if (shared > 0)
+    {
+        double complex * numbers = (double complex *)malloc(sizeof(double complex) * count);
+
+        if (numbers == NULL)
+        {
+            error_exit("could not allocate memory for the numbers");
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            double real;
+            double imaginary;
+            binary_input_get(&input, i, &real, &imaginary);
+            numbers[i] = real + imaginary*I;
+        }
+
+        binary_input_close(&input);
+        fft_shared(numbers, count);
+        write_binary_results(numbers, count, out_precision, npy);
+    }
+
+    int pipes[4][2];
+
+    if (pipe(pipes[0]) ==-1 || pipe(pipes[1]) ==-1 || pipe(pipes[2]) ==-1 ||pipe(pipes[3]) ==-1)
+    {
+        error_exit("Error while creating pipes");
+    }
+
+    pid_t pid = fork_child(pipes, FIRST_CHILD_READ, FIRST_CHILD_WRITE, 1);
+    pid_t pid2 = fork_child(pipes, SECOND_CHILD_READ, SECOMD_CHILD_WRITE, 1);
+
+    close(pipes[FIRST_CHILD_READ][WRITE]);
+    close(pipes[FIRST_CHILD_WRITE][READ]);
+    close(pipes[SECOND_CHILD_READ][WRITE]);
+    close(pipes[SECOMD_CHILD_WRITE][READ]);
+
+    FILE * to_first = fdopen(pipes[FIRST_CHILD_WRITE][WRITE], "w");
+    FILE * to_second = fdopen(pipes[SECOMD_CHILD_WRITE][WRITE], "w");
+
+    if (to_first == NULL || to_second == NULL)
+    {
+        error_exit("could not open the pipes to the kid processes");
+    }
+
+    //writing the even numbers to the first and the odd ones to the second child
+    for (size_t i = 0; i < count; i++)
+    {
+        double real;
+        double imaginary;
+        binary_input_get(&input, i, &real, &imaginary);
+
+        if (binary_output_write(i % 2 == 0 ? to_first : to_second, 8, real, imaginary) == -1)
+        {
+            error_exit("Smthing wrong with writing to the kid processes");
+        }
+    }
+
+    binary_input_close(&input);
+
+    if (fclose(to_first) == EOF || fclose(to_second) == EOF)
+    {
+        error_exit("Smthing wrong with writing to the kid processes");
+    }
+
+    //reading the results before waiting, so a kid never blocks on a full pipe
+
+    binary_input first;
+    binary_input second;
+
+    if (binary_input_open(pipes[FIRST_CHILD_READ][READ], 8, &first) == -1 ||
+        binary_input_open(pipes[SECOND_CHILD_READ][READ], 8, &second) == -1)
+    {
+        error_exit("could not read the results of the kid processes");
+    }
+
+    close(pipes[FIRST_CHILD_READ][READ]);
+    close(pipes[SECOND_CHILD_READ][READ]);
+
+    wait_for_kid(pid, pid2);
+
+    if (first.count != count / 2 || second.count != count / 2)
+    {
+        error_exit("kid processes returned the wrong number of results");
+    }
+
+    double complex * rez = (double complex *)malloc(sizeof(double complex) * count);
+
+    if (rez == NULL)
+    {
+        error_exit("could not allocate memory for the results");
+    }
+
+    for (size_t i = 0; i < count / 2; i++)
+    {
+        double real;
+        double imaginary;
+        binary_input_get(&first, i, &real, &imaginary);
+        double complex c = real + imaginary*I;
+        binary_input_get(&second, i, &real, &imaginary);
+        double complex c2 = real + imaginary*I;
+
+        butterfly(c, c2, i, count, &rez[i], &rez[i + count / 2]);
+    }
+
+    binary_input_close(&first);
+    binary_input_close(&second);
+
+    write_binary_results(rez, count, out_precision, npy);
+}
+
 int main(int argc , char **argv){
 
 
@@ -308,6 +724,9 @@ prog_name = argv[0];
 double complex * complex_num ;
 int complex_num_count = 0 ;
 int p_option = 0;
+int b_option = 0;
+int s_option = 0;
+int precision = 4;
 int c;
 int array_size = BUFSIZE;
 
@@ -315,7 +734,7 @@ complex_num = (double complex *)malloc(BUFSIZE * sizeof(double complex));
 
 //get option argument p
 
-while ((c = getopt(argc, argv,":p")) != -1)
+while ((c = getopt(argc, argv,":pbds")) != -1)
 {
     switch (c)
     {
@@ -328,6 +747,18 @@ while ((c = getopt(argc, argv,":p")) != -1)
         }
         break;
 
+    case 'b':
+        b_option++;
+        break;
+
+    case 'd':
+        precision = 8;
+        break;
+
+    case 's':
+        s_option++;
+        break;
+
     case '?':
         usage(prog_name);
         error_exit("Invalid argument given");
@@ -339,6 +770,18 @@ while ((c = getopt(argc, argv,":p")) != -1)
 
 }
 
+if (b_option > 0)
+{
+    free(complex_num);
+    run_binary(precision, s_option);
+}
+
+if (precision == 8)
+{
+    usage(prog_name);
+    error_exit("-d only works together with -b");
+}
+
 //we are getting the input lines either from the parent process or from the user
 
 while (getline(&input, &count, stdin) != -1){
@@ -357,6 +800,27 @@ while (getline(&input, &count, stdin) != -1){
 
 free(input);
 
+//in shared memory mode the whole FFT is calculated before anything is printed
+if (s_option > 0 && complex_num_count > 0)
+{
+    fft_shared(complex_num, complex_num_count);
+
+    for (int i = 0; i < complex_num_count; i++)
+    {
+        double complex rez = check_for_minus_zeros(complex_num[i]);
+
+        if (p_option > 0)
+        {
+            fprintf(stdout, "%.3f %.3f*i\n", creal(rez), cimag(rez));
+        }else{
+            fprintf(stdout, "%.6f %.6f*i\n", creal(rez), cimag(rez));
+        }
+    }
+
+    free(complex_num);
+    exit(EXIT_SUCCESS);
+}
+
 //if the input is just one compley number that one is just printed out
 if (complex_num_count == 1)
 {
@@ -402,58 +866,9 @@ if (pipe(pipes[0]) ==-1 || pipe(pipes[1]) ==-1 || pipe(pipes[2]) ==-1 ||pipe(pip
 }
 
 
-//creating the first child process
-if ((pid = fork()) ==-1)
-{
-    error_exit("error while forking child");
-}
-
-if (pid == 0)
-{
-    //duping the first child pipes to stdin and stdout respectively
-    if (dup2(pipes[FIRST_CHILD_WRITE][READ], STDIN_FILENO) == -1)
-    {
-        error_exit("error while dupping reading pipe of child");
-    }
-
-    if (dup2(pipes[FIRST_CHILD_READ][WRITE], STDOUT_FILENO) == -1)
-    {
-        error_exit("error while dupping writing pipe of child");
-    }
-
-    close_all_pipes(pipes);
-
-    //executing the parent program in the child recursively
-    execlp(prog_name, prog_name, NULL);
-
-    //this line should not be reached if execlp was succsessful
-    error_exit("execlp didnt work properly");
-}
-
-//creating the second child process
-if ((pid2 = fork()) ==-1)
-{
-    error_exit("error while forking child");
-}
-
-if (pid2 == 0)
-{
-    if (dup2(pipes[SECOMD_CHILD_WRITE][READ], STDIN_FILENO) == -1)
-    {
-        error_exit("error while dupping reading pipe of child");
-    }
-
-    if (dup2(pipes[SECOND_CHILD_READ][WRITE], STDOUT_FILENO) == -1)
-    {
-        error_exit("error while dupping writing pipe of child");
-    }
-
-    close_all_pipes(pipes);
-
-    execlp(prog_name, prog_name, NULL);
-
-    error_exit("execlp didnt work properly");
-}
+//creating the child processes
+pid = fork_child(pipes, FIRST_CHILD_READ, FIRST_CHILD_WRITE, 0);
+pid2 = fork_child(pipes, SECOND_CHILD_READ, SECOMD_CHILD_WRITE, 0);
 
 //cclose all unneccaserry pipes for parents 
 
@@ -539,19 +954,10 @@ for (int i = 0; i < (complex_num_count/2); i++)
     c = get_imaginary_num_from_line(input_first);
     c2 = get_imaginary_num_from_line(input_second);
 
-    double constant = -2*PI/complex_num_count;
-
-    //multiplication formula in complex numbers
+    double complex rez;
+    double complex rez2;
 
-    //the middle part
-    double complex rez = cos(constant*i) + sin(constant*i)*I;
-    //multiplzing with the odd result
-    rez = rez*c2;
-    double complex rez2 = rez;
-    //adding with the even result
-    rez = creal(rez) + creal(c) + (cimag(rez) + cimag(c))*I;
-    //substracting from the odd result
-    rez2 =creal(c) - creal(rez2) + (cimag(c) - cimag(rez2))*I;
+    butterfly(c, c2, i, complex_num_count, &rez, &rez2);
 
     rez = check_for_minus_zeros(rez);
     rez2 = check_for_minus_zeros(rez2);
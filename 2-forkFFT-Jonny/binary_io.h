@@ -0,0 +1,95 @@
+/**
+ * @file binary_io.h
+ * @author Jonny X (12345678) <e12345678@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief Binary input and output of complex numbers.
+ *
+ * @details The numbers are raw little-endian pairs of float32 or float64 (real part, imaginary part),
+ * which is the layout of numpy's complex64/complex128. Input that starts with the .npy magic string
+ * is read as a numpy array of shape (n,) and dtype '<c8' or '<c16'.
+ **/
+
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/** Binary input struct
+ * @brief Binary input which is mapped or read into memory.
+ *
+ * @details Consists of
+ * data - the first number.
+ * count - the number of complex numbers.
+ * precision - the size of one part in bytes, 4 (float32) or 8 (float64).
+ * npy - true if the input was a .npy file.
+ * memory - the mapping or buffer which has to be released.
+ * memory_size - the size of memory in bytes.
+ * mapped - true if memory is a mapping, false if it was allocated.
+ */
+typedef struct binary_input
+{
+    const unsigned char *data;
+    size_t count;
+    int precision;
+    bool npy;
+    void *memory;
+    size_t memory_size;
+    bool mapped;
+} binary_input;
+
+
+
+
+/** binary_input_open function
+ * @brief Reads all numbers from a file descriptor.
+ *
+ * @details Regular files are mapped with mmap instead of read.
+ *
+ * @param fd The file descriptor to read from.
+ * @param precision 4 or 8, the size of a part of raw input (.npy input brings its own).
+ * @param input The struct where the input is stored.
+ *
+ * @return Returns 0 if successful. Otherwise -1 is returned (errno is EINVAL if the input is malformed).
+ */
+int binary_input_open(int fd, int precision, binary_input *input);
+
+
+
+
+/** binary_input_get function
+ * @brief Returns the number at index i of the input.
+ */
+void binary_input_get(const binary_input *input, size_t i, double *real, double *imaginary);
+
+
+
+
+/** binary_input_close function
+ * @brief Releases the memory of the input.
+ */
+void binary_input_close(binary_input *input);
+
+
+
+
+/** binary_output_header function
+ * @brief Writes the .npy header for count numbers. Does nothing if npy is false.
+ *
+ * @return Returns 0 if successful. Otherwise -1 is returned.
+ */
+int binary_output_header(FILE *out, int precision, bool npy, size_t count);
+
+
+
+
+/** binary_output_write function
+ * @brief Writes one number as a little-endian pair with precision bytes per part.
+ *
+ * @return Returns 0 if successful. Otherwise -1 is returned.
+ */
+int binary_output_write(FILE *out, int precision, double real, double imaginary);
+
+#endif
@@ -23,10 +23,16 @@
 #include <string.h>
 #include <assert.h>
 
+#include "binary_io.h"
+#include "thread_pool.h"
+
 #define PI 3.141592654
 
 static char *prog_name;
 
+// rounds the results of every level like the text pipes of the process tree (not in binary mode)
+static bool emulate_pipes = true;
+
 /**
  * @brief
  * Prints the usage format to explain which arguments are expected. 
@@ -37,8 +43,10 @@ static char *prog_name;
 **/
 void usage(void)
 {
-    fprintf(stderr, "[%s] Usage: %s\n", prog_name, prog_name);
+    fprintf(stderr, "[%s] Usage: %s [-p] [-t threads] [-b [-d]]\n", prog_name, prog_name);
     fprintf(stderr, "Example inputs after program start: 1 0 and 1 0\n");
+    fprintf(stderr, "-p computes the FFT with a thread pool instead of child processes, -t sets the number of threads (implies -p)\n");
+    fprintf(stderr, "-b reads and writes little-endian float32 complex pairs or .npy (implies -p), -d uses float64 pairs\n");
     exit(EXIT_FAILURE);
 }
 
@@ -79,15 +87,15 @@ void output_padding(size_t padding)
 
 /**
  * @brief
- * Outputs the branch line for a tree.
+ * Outputs the branches for a tree.
  * 
  * @details
- * Outputs the padding and the branches in one line. The left branch is dislayed by printing a slash (/) 
+ * Outputs the padding and the branches without a newline. The left branch is dislayed by printing a slash (/) 
  * and the right one by printing a blackslash (\)
  * 
  * @param length The total line length.
 **/
-void output_branch_line(size_t length)
+void output_branch(size_t length)
 {
     for (int i = 0; i < length; i++)
     {
@@ -105,6 +113,20 @@ void output_branch_line(size_t length)
             fprintf(stdout, " ");
         }
     }
+}
+
+/**
+ * @brief
+ * Outputs the branch line for a tree.
+ * 
+ * @details
+ * Outputs the padding and the branches in one line (see output_branch).
+ * 
+ * @param length The total line length.
+**/
+void output_branch_line(size_t length)
+{
+    output_branch(length);
     fprintf(stdout, "\n");
 }
 
@@ -268,9 +290,474 @@ void wait_for_both_children(pid_t pid1, pid_t pid2)
         ;
 }
 
+/**
+ * @brief
+ * Calculates two results of the FFT from the results of both children.
+ * 
+ * @details
+ * Combines R[k] = E[k] + W^k * O[k] and R[k + n/2] = E[k] - W^k * O[k]. Both modes use this function
+ * so they calculate bit for bit the same results.
+ * 
+ * @param re The result E[k] of child 1 (even inputs).
+ * @param ro The result O[k] of child 2 (odd inputs).
+ * @param k The index of the results.
+ * @param n The number of inputs of the current process.
+ * @param result1 The pointer where R[k] is written to.
+ * @param result2 The pointer where R[k + n/2] is written to.
+**/
+void butterfly(float complex re, float complex ro, int k, size_t n, float complex *result1, float complex *result2)
+{
+    *result1 = re + (cos((-(2 * PI) / n) * k) + I * sin((-(2 * PI) / n) * k)) * ro;
+    *result2 = re - (cos((-(2 * PI) / n) * k) + I * sin((-(2 * PI) / n) * k)) * ro;
+}
+
+/**
+ * @brief
+ * Rounds a result like the pipe between a child and its parent does.
+ * 
+ * @details
+ * A child writes its results with "%f %f" and the parent parses them again, so every level of the
+ * process tree rounds the results to six decimal places. The thread pool mode does the same to
+ * output exactly the same values.
+ * 
+ * @param value The pointer to the result which is rounded.
+**/
+void pass_through_pipe(float complex *value)
+{
+    // "%f" of the largest float has 46 characters
+    char line[128];
+    snprintf(line, sizeof(line), "%f %f\n", creal(*value), cimag(*value));
+    parse_input(line, value);
+}
+
+/**
+ * @brief
+ * Combines the results of both halves into the results of the whole input.
+ * 
+ * @details
+ * results[0, n/2) holds the results of child 1 and results[n/2, n) the results of child 2. They are
+ * replaced by the results R[0, n).
+ * 
+ * @param results The results of both children.
+ * @param n The number of results.
+**/
+void combine(float complex *results, size_t n)
+{
+    for (int k = 0; k < n / 2; k++)
+    {
+        float complex re = results[k];
+        float complex ro = results[k + n / 2];
+        if (emulate_pipes)
+        {
+            pass_through_pipe(&re);
+            pass_through_pipe(&ro);
+        }
+        butterfly(re, ro, k, n, &results[k], &results[k + n / 2]);
+    }
+}
+
+/**
+ * @brief
+ * Calculates the FFT recursively in the current thread.
+ * 
+ * @details
+ * Does the same as the process tree (child 1 gets the even, child 2 the odd inputs) but
+ * depth first in one thread, so the small subtrees are calculated while they are in the cache.
+ * 
+ * @param input The first input.
+ * @param stride The distance between two inputs of this subtree.
+ * @param n The number of inputs (a power of two).
+ * @param results The array where the n results are written to.
+**/
+void fft_sequential(const float complex *input, size_t stride, size_t n, float complex *results)
+{
+    if (n == 1)
+    {
+        results[0] = input[0];
+        return;
+    }
+    fft_sequential(input, stride * 2, n / 2, results);
+    fft_sequential(input + stride, stride * 2, n / 2, results + n / 2);
+    combine(results, n);
+}
+
+/** FFT node struct
+ * @brief A subtree of the FFT which is calculated by a task of the thread pool.
+ * 
+ * @details Consists of
+ * input, stride, n, results - like the parameters of fft_sequential.
+ * children - the two children if this node is split, NULL if the subtree is calculated sequentially.
+ * parent - the parent node or NULL for the root.
+ * pending - the number of children which are not finished yet (changed with the __atomic builtins).
+ */
+typedef struct fft_node
+{
+    const float complex *input;
+    size_t stride;
+    size_t n;
+    float complex *results;
+    struct fft_node *children;
+    struct fft_node *parent;
+    int pending;
+} fft_node;
+
+/**
+ * @brief
+ * Creates the nodes of the top levels of the FFT.
+ * 
+ * @details
+ * nodes[index] gets the subtree and its children are nodes[2 * index + 1] and nodes[2 * index + 2] (like a heap).
+ * 
+ * @param nodes The array of 2^(levels + 1) - 1 nodes.
+ * @param index The index of the node which is created.
+ * @param levels The number of levels below this node which are split.
+ * @param parent The parent of the node.
+**/
+void create_nodes(fft_node *nodes, size_t index, size_t levels, fft_node *parent)
+{
+    fft_node *node = &nodes[index];
+    node->parent = parent;
+    if (levels == 0)
+    {
+        node->children = NULL;
+        return;
+    }
+
+    fft_node *children = &nodes[2 * index + 1];
+    children[0].input = node->input;
+    children[1].input = node->input + node->stride;
+    for (int i = 0; i < 2; i++)
+    {
+        children[i].stride = node->stride * 2;
+        children[i].n = node->n / 2;
+        children[i].results = node->results + i * (node->n / 2);
+        create_nodes(nodes, 2 * index + 1 + i, levels - 1, node);
+    }
+    node->children = children;
+    node->pending = 2;
+}
+
+/**
+ * @brief
+ * Marks a node as finished.
+ * 
+ * @details
+ * The child which finishes last combines the results of its parent and finishes the parent,
+ * so no thread has to wait for its children. When the root is finished the thread pool is stopped.
+ * 
+ * @param self The worker which finished the node.
+ * @param node The finished node.
+**/
+void finish_node(worker *self, fft_node *node)
+{
+    while (node->parent != NULL)
+    {
+        node = node->parent;
+        // acquire/release, so the results of the other child are visible
+        if (__atomic_sub_fetch(&node->pending, 1, __ATOMIC_ACQ_REL) != 0)
+        {
+            return;
+        }
+        combine(node->results, node->n);
+    }
+    thread_pool_finish(self);
+}
+
+/**
+ * @brief
+ * The task which calculates an FFT node.
+ * 
+ * @details
+ * Split nodes submit child 2 to the pool (where an idle worker can steal it) and continue with child 1.
+ * 
+ * @param self The worker which runs the task.
+ * @param arg The fft_node.
+**/
+void fft_task(worker *self, void *arg)
+{
+    fft_node *node = arg;
+    if (node->children == NULL)
+    {
+        fft_sequential(node->input, node->stride, node->n, node->results);
+        finish_node(self, node);
+        return;
+    }
+
+    if (thread_pool_submit(self, fft_task, &node->children[1]) == -1)
+    {
+        // no memory for the deque: calculate child 2 in this thread
+        fft_task(self, &node->children[1]);
+    }
+    fft_task(self, &node->children[0]);
+}
+
+/**
+ * @brief
+ * Outputs one line of the tree the process tree would output.
+ * 
+ * @details
+ * Line 0 of a subtree lists its inputs, line 1 are the branches and line i >= 2 is line i - 2 of
+ * child 1 and of child 2 next to each other. Every line of a subtree has the same width,
+ * the sum of the widths of its leaves ("FFT({%f %f})") plus 2 per split.
+ * 
+ * @param input The first input of the subtree.
+ * @param lengths The length of "{%f %f}" of every input.
+ * @param stride The distance between two inputs of the subtree.
+ * @param n The number of inputs of the subtree.
+ * @param line The line which is outputted (without the newline).
+**/
+void output_tree_line(const float complex *input, const size_t *lengths, size_t stride, size_t n, size_t line)
+{
+    if (n == 1)
+    {
+        fprintf(stdout, "FFT({%f %f})", creal(input[0]), cimag(input[0]));
+        return;
+    }
+
+    if (line >= 2)
+    {
+        output_tree_line(input, lengths, stride * 2, n / 2, line - 2);
+        fprintf(stdout, "  ");
+        output_tree_line(input + stride, lengths + stride, stride * 2, n / 2, line - 2);
+        return;
+    }
+
+    size_t inputs_length = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        inputs_length += lengths[i * stride];
+    }
+    size_t width = inputs_length + 7 * n - 2;
+
+    if (line == 1)
+    {
+        output_branch(width);
+        return;
+    }
+
+    size_t tree_line_length = strlen("FFT(") + inputs_length + strlen(")");
+    size_t padding_left = (width - tree_line_length) / 2;
+    output_padding(padding_left);
+    fprintf(stdout, "FFT(");
+    for (size_t i = 0; i < n; i++)
+    {
+        fprintf(stdout, "{%f %f}", creal(input[i * stride]), cimag(input[i * stride]));
+    }
+    fprintf(stdout, ")");
+    output_padding(width - tree_line_length - padding_left);
+}
+
+/**
+ * @brief
+ * Reads all inputs from stdin as text lines.
+ * 
+ * @param n The pointer where the number of inputs is written to.
+ * @return Returns the inputs (which have to be freed).
+**/
+float complex *read_text_inputs(size_t *n)
+{
+    size_t inputs_cap = 2;
+    float complex *inputs = malloc(inputs_cap * sizeof(float complex));
+    char *line = NULL;
+    size_t line_cap = 0;
+    if (inputs == NULL)
+    {
+        fprintf(stderr, "[%s] Error malloc failed: %s\n", prog_name, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    *n = 0;
+    while (getline(&line, &line_cap, stdin) != -1)
+    {
+        if (*n == inputs_cap)
+        {
+            inputs_cap *= 2;
+            float complex *inputs_temp = realloc(inputs, inputs_cap * sizeof(float complex));
+            if (inputs_temp == NULL)
+            {
+                fprintf(stderr, "[%s] Error realloc failed\n", prog_name);
+                free(inputs);
+                free(line);
+                exit(EXIT_FAILURE);
+            }
+            inputs = inputs_temp;
+        }
+        if (parse_input(line, &inputs[*n]) == -1)
+        {
+            free(inputs);
+            free(line);
+            usage();
+        }
+        (*n)++;
+    }
+    free(line);
+    return inputs;
+}
+
+/**
+ * @brief
+ * Reads all inputs from stdin as binary numbers.
+ * 
+ * @details
+ * If stdin is a file it is mapped instead of read (see binary_io.h).
+ * 
+ * @param input The binary input. Its format is used for the output.
+ * @param precision 4 or 8, the size of a part of raw binary numbers.
+ * @param n The pointer where the number of inputs is written to.
+ * @return Returns the inputs (which have to be freed).
+**/
+float complex *read_binary_inputs(binary_input *input, int precision, size_t *n)
+{
+    if (binary_input_open(STDIN_FILENO, precision, input) == -1)
+    {
+        fprintf(stderr, "[%s] Error reading binary input failed: %s\n", prog_name, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    *n = input->count;
+    float complex *inputs = malloc((*n > 0 ? *n : 1) * sizeof(float complex));
+    if (inputs == NULL)
+    {
+        fprintf(stderr, "[%s] Error malloc failed: %s\n", prog_name, strerror(errno));
+        binary_input_close(input);
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < *n; i++)
+    {
+        double real;
+        double imaginary;
+        binary_input_get(input, i, &real, &imaginary);
+        inputs[i] = real + imaginary * I;
+    }
+    binary_input_close(input);
+    return inputs;
+}
+
+/**
+ * @brief
+ * Calculates the FFT with a thread pool instead of child processes.
+ * 
+ * @details
+ * Reads all inputs from stdin, splits the top levels of the recursion into tasks for the
+ * work-stealing thread pool (enough for every thread to get one subtree) and calculates the
+ * levels below sequentially. In text mode it outputs exactly what the process tree outputs,
+ * in binary mode only the results in the format of the input. Exits afterwards.
+ * 
+ * @param threads The number of threads.
+ * @param binary True to read and write binary numbers instead of text lines.
+ * @param precision 4 or 8, the size of a part of raw binary numbers.
+**/
+void run_thread_pool(size_t threads, bool binary, int precision)
+{
+    size_t n;
+    binary_input input;
+    float complex *inputs = binary ? read_binary_inputs(&input, precision, &n) : read_text_inputs(&n);
+    emulate_pipes = !binary;
+
+    if (n == 0)
+    {
+        fprintf(stderr, "[%s] Error no input provided\n", prog_name);
+        free(inputs);
+        exit(EXIT_FAILURE);
+    }
+    // the process tree fails in the first process which gets an odd number of inputs
+    if ((n & (n - 1)) != 0)
+    {
+        fprintf(stderr, "[%s] Error input is not even. (in root or any child process)\n", prog_name);
+        free(inputs);
+        exit(EXIT_FAILURE);
+    }
+
+    // split the top levels until there is a subtree for every thread (or the subtrees have one input)
+    size_t levels = 0;
+    while (((size_t)1 << levels) < threads && ((size_t)1 << levels) < n)
+    {
+        levels++;
+    }
+
+    float complex *results = malloc(n * sizeof(float complex));
+    size_t *lengths = malloc(n * sizeof(size_t));
+    fft_node *nodes = malloc((((size_t)2 << levels) - 1) * sizeof(fft_node));
+    if (results == NULL || lengths == NULL || nodes == NULL)
+    {
+        fprintf(stderr, "[%s] Error malloc failed: %s\n", prog_name, strerror(errno));
+        free(inputs);
+        free(results);
+        free(lengths);
+        free(nodes);
+        exit(EXIT_FAILURE);
+    }
+
+    nodes[0].input = inputs;
+    nodes[0].stride = 1;
+    nodes[0].n = n;
+    nodes[0].results = results;
+    create_nodes(nodes, 0, levels, NULL);
+
+    if (thread_pool_run(threads, fft_task, &nodes[0]) == -1)
+    {
+        fprintf(stderr, "[%s] Error thread pool failed: %s\n", prog_name, strerror(errno));
+        free(inputs);
+        free(results);
+        free(lengths);
+        free(nodes);
+        exit(EXIT_FAILURE);
+    }
+
+    if (binary)
+    {
+        bool failed = binary_output_header(stdout, input.precision, input.npy, n) == -1;
+        for (size_t i = 0; i < n && !failed; i++)
+        {
+            failed = binary_output_write(stdout, input.precision, creal(results[i]), cimag(results[i])) == -1;
+        }
+        failed = fflush(stdout) == EOF || failed;
+        if (failed)
+        {
+            fprintf(stderr, "[%s] Error writing binary output failed: %s\n", prog_name, strerror(errno));
+        }
+        free(inputs);
+        free(results);
+        free(lengths);
+        free(nodes);
+        exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        fprintf(stdout, "%f %f\n", creal(results[i]), cimag(results[i]));
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        lengths[i] = snprintf(NULL, 0, "{%f %f}", creal(inputs[i]), cimag(inputs[i]));
+    }
+
+    // the tree of n inputs has 1 + 2 * log2(n) lines
+    size_t depth = 0;
+    while (((size_t)1 << depth) < n)
+    {
+        depth++;
+    }
+    fprintf(stdout, "\n");
+    for (size_t tree_line = 0; tree_line <= 2 * depth; tree_line++)
+    {
+        output_tree_line(inputs, lengths, 1, n, tree_line);
+        fprintf(stdout, "\n");
+    }
+    fflush(stdout);
+
+    free(inputs);
+    free(results);
+    free(lengths);
+    free(nodes);
+    exit(EXIT_SUCCESS);
+}
+
 /**
  * Program entry point.
- * @brief The program recursively calls itself to calculate the FFT by using the Cooley-Tukey algorithm.
+ * @brief The program recursively calls itself to calculate the FFT by using the Cooley-Tukey algorithm
+ * (or uses a thread pool with -p, see run_thread_pool).
  *  
  * @details The program first reads the inputs an forks if more than one input is provided. 
  * Each child repeats this process until only one input is provided. That result is returned
@@ -284,11 +771,49 @@ int main(int argc, char **argv)
 {
     //Exit if arguments were provided
     prog_name = argv[0];
-    if (argc != 1)
+    bool use_thread_pool = false;
+    bool binary = false;
+    int precision = 4;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int option;
+    while ((option = getopt(argc, argv, "pt:bd")) != -1)
+    {
+        char *endpointer = NULL;
+        switch (option)
+        {
+        case 'p':
+            use_thread_pool = true;
+            break;
+        case 't':
+            use_thread_pool = true;
+            threads = strtol(optarg, &endpointer, 10);
+            if (*endpointer != '\0' || threads <= 0)
+            {
+                usage();
+            }
+            break;
+        case 'b':
+            // the process tree exchanges text lines, binary numbers are calculated by the thread pool
+            use_thread_pool = true;
+            binary = true;
+            break;
+        case 'd':
+            precision = 8;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc || (precision == 8 && !binary))
     {
         usage();
     }
 
+    if (use_thread_pool)
+    {
+        run_thread_pool(threads > 0 ? threads : 1, binary, precision);
+    }
+
     //create char* line1 and line2 which are filled by the getline calls.
     char *line1 = NULL;
     size_t line1_cap = 0;
@@ -772,10 +1297,8 @@ int main(int argc, char **argv)
         }
 
         //calcualte result from children
-        float complex result1 = re + (cos((-(2 * PI) / n) * k) + I * sin((-(2 * PI) / n) * k)) * ro;
-        float complex result2 = re - (cos((-(2 * PI) / n) * k) + I * sin((-(2 * PI) / n) * k)) * ro;
-
-        second_half[k] = result2;
+        float complex result1;
+        butterfly(re, ro, k, n, &result1, &second_half[k]);
 
         //write the result R[k] to stdout
         fprintf(stdout, "%f %f\n", creal(result1), cimag(result1));
@@ -0,0 +1,246 @@
+/**
+ * @file thread_pool.c
+ * @author Jonny X (12345678) <e12345678@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief A small work-stealing thread pool for recursive (divide and conquer) work.
+ *
+ **/
+
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <errno.h>
+
+/** task struct
+ * @brief A function and its argument.
+ */
+typedef struct task
+{
+    task_function function;
+    void *arg;
+} task;
+
+/** Worker struct
+ * @brief A worker thread and its deque.
+ *
+ * @details Consists of
+ * tasks - the deque, tasks[top] is the oldest and tasks[bottom - 1] the newest task.
+ * top - the index of the oldest task (where other workers steal).
+ * bottom - the index after the newest task (where the owner pushes and pops).
+ * capacity - the size of tasks.
+ * lock - protects the deque.
+ * thread - the thread running the worker (unused for worker 0, which is the calling thread).
+ * pool - the pool the worker belongs to.
+ * index - the index of the worker in the pool.
+ */
+struct worker
+{
+    task *tasks;
+    size_t top;
+    size_t bottom;
+    size_t capacity;
+    pthread_mutex_t lock;
+    pthread_t thread;
+    struct thread_pool *pool;
+    size_t index;
+};
+
+/** Thread pool struct
+ * @brief All workers of the pool.
+ *
+ * @details Consists of
+ * workers - the array of workers.
+ * count - the number of workers.
+ * finished - set by thread_pool_finish, read with the __atomic builtins.
+ */
+typedef struct thread_pool
+{
+    worker *workers;
+    size_t count;
+    bool finished;
+} thread_pool;
+
+
+
+
+/** pop_bottom function
+ * @brief Takes the newest task from the deque of the worker.
+ *
+ * @return Returns true if a task was taken.
+ */
+static bool pop_bottom(worker *self, task *result)
+{
+    bool found = false;
+    pthread_mutex_lock(&self->lock);
+    if (self->bottom > self->top)
+    {
+        self->bottom--;
+        *result = self->tasks[self->bottom];
+        found = true;
+    }
+    pthread_mutex_unlock(&self->lock);
+    return found;
+}
+
+
+
+
+/** steal_top function
+ * @brief Takes the oldest task from the deque of another worker.
+ *
+ * @return Returns true if a task was taken.
+ */
+static bool steal_top(worker *victim, task *result)
+{
+    bool found = false;
+    pthread_mutex_lock(&victim->lock);
+    if (victim->bottom > victim->top)
+    {
+        *result = victim->tasks[victim->top];
+        victim->top++;
+        found = true;
+    }
+    pthread_mutex_unlock(&victim->lock);
+    return found;
+}
+
+
+
+
+/** work function
+ * @brief The loop of every worker.
+ *
+ * @details Runs its own tasks first and steals from the other workers when the own deque is empty,
+ * until the pool is finished.
+ *
+ * @param arg The worker.
+ * @return Always returns NULL.
+ */
+static void *work(void *arg)
+{
+    worker *self = arg;
+    thread_pool *pool = self->pool;
+
+    while (!__atomic_load_n(&pool->finished, __ATOMIC_ACQUIRE))
+    {
+        task next;
+        bool found = pop_bottom(self, &next);
+
+        // start with the next worker so not every idle worker tries to steal from worker 0
+        for (size_t i = 1; !found && i < pool->count; i++)
+        {
+            found = steal_top(&pool->workers[(self->index + i) % pool->count], &next);
+        }
+
+        if (found)
+        {
+            next.function(self, next.arg);
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+int thread_pool_submit(worker *self, task_function function, void *arg)
+{
+    pthread_mutex_lock(&self->lock);
+
+    // the deque is empty: start again at the beginning of the array
+    if (self->top == self->bottom)
+    {
+        self->top = 0;
+        self->bottom = 0;
+    }
+
+    if (self->bottom == self->capacity)
+    {
+        size_t capacity = self->capacity == 0 ? 16 : self->capacity * 2;
+        task *tasks = realloc(self->tasks, capacity * sizeof(task));
+        if (tasks == NULL)
+        {
+            pthread_mutex_unlock(&self->lock);
+            return -1;
+        }
+        self->tasks = tasks;
+        self->capacity = capacity;
+    }
+
+    self->tasks[self->bottom].function = function;
+    self->tasks[self->bottom].arg = arg;
+    self->bottom++;
+
+    pthread_mutex_unlock(&self->lock);
+    return 0;
+}
+
+void thread_pool_finish(worker *self)
+{
+    __atomic_store_n(&self->pool->finished, true, __ATOMIC_RELEASE);
+}
+
+int thread_pool_run(size_t threads, task_function function, void *arg)
+{
+    if (threads == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    thread_pool pool = {.count = threads, .finished = false};
+    pool.workers = calloc(threads, sizeof(worker));
+    if (pool.workers == NULL)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < threads; i++)
+    {
+        pool.workers[i].pool = &pool;
+        pool.workers[i].index = i;
+        pthread_mutex_init(&pool.workers[i].lock, NULL);
+    }
+
+    int result = thread_pool_submit(&pool.workers[0], function, arg);
+    if (result == 0)
+    {
+        // the calling thread is worker 0, so only the others need a thread
+        size_t started = 1;
+        while (started < threads &&
+               pthread_create(&pool.workers[started].thread, NULL, work, &pool.workers[started]) == 0)
+        {
+            started++;
+        }
+        /*
+        If not all threads could be created the pool just runs with fewer workers. The deques of
+        the missing ones stay empty, only running workers submit tasks.
+        */
+
+        work(&pool.workers[0]);
+
+        for (size_t i = 1; i < started; i++)
+        {
+            pthread_join(pool.workers[i].thread, NULL);
+        }
+    }
+    else
+    {
+        errno = ENOMEM;
+    }
+
+    for (size_t i = 0; i < threads; i++)
+    {
+        pthread_mutex_destroy(&pool.workers[i].lock);
+        free(pool.workers[i].tasks);
+    }
+    free(pool.workers);
+    return result;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file thread_pool.h
+ * @author Jonny X (12345678) <e12345678@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief A small work-stealing thread pool for recursive (divide and conquer) work.
+ *
+ * @details Every worker owns a deque of tasks. New tasks are pushed to the bottom of the deque of the
+ * worker which submits them and the owner also takes its tasks from the bottom (so it continues with
+ * the newest and smallest piece of work). Idle workers steal from the top of the other deques, which
+ * are the oldest and biggest tasks.
+ **/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+typedef struct worker worker;
+
+/** task_function type
+ * @brief The function of a task.
+ *
+ * @param self The worker which runs the task. It is needed to submit new tasks or to finish the pool.
+ * @param arg The argument which was given to thread_pool_submit or thread_pool_run.
+ */
+typedef void (*task_function)(worker *self, void *arg);
+
+
+
+
+/** thread_pool_run function
+ * @brief Runs a task and all tasks it submits on a pool of threads.
+ *
+ * @details The calling thread is used as the first worker and threads - 1 additional threads are created.
+ * The function returns after a task called thread_pool_finish and all threads were joined.
+ *
+ * @param threads The number of workers (at least 1).
+ * @param function The function of the first task.
+ * @param arg The argument of the first task.
+ *
+ * @return Returns 0 if successful. Otherwise -1 is returned and errno is set.
+ */
+int thread_pool_run(size_t threads, task_function function, void *arg);
+
+
+
+
+/** thread_pool_submit function
+ * @brief Adds a task to the deque of the worker.
+ *
+ * @param self The worker which submits the task.
+ * @param function The function of the task.
+ * @param arg The argument of the task.
+ *
+ * @return Returns 0 if successful. Otherwise -1 is returned (no memory left).
+ */
+int thread_pool_submit(worker *self, task_function function, void *arg);
+
+
+
+
+/** thread_pool_finish function
+ * @brief Stops all workers, thread_pool_run returns once they are done with their current task.
+ *
+ * @param self The worker which finishes the pool.
+ */
+void thread_pool_finish(worker *self);
+
+#endif
@@ -0,0 +1,81 @@
+import argparse
+import os
+import random
+import subprocess
+import tempfile
+import time
+
+
+# Compare the process tree (./forkFFT) with the in-process engine
+# (./forkFFT -e) for 2^min to 2^max points. The process tree needs about 2N
+# processes, so it only runs up to 2^tree-max points.
+def main():
+    parser = argparse.ArgumentParser(
+        description="Benchmark ./forkFFT against ./forkFFT -e"
+    )
+    parser.add_argument("--min", type=int, default=10, help="smallest 2^k")
+    parser.add_argument("--max", type=int, default=24, help="largest 2^k")
+    parser.add_argument(
+        "--tree-max",
+        type=int,
+        default=12,
+        help="largest 2^k the process tree is run for (default: 12)",
+    )
+    args = parser.parse_args()
+
+    print(f"{'points':>10} {'tree [s]':>10} {'engine [s]':>11} {'speedup':>8} {'max diff':>10}")
+    for k in range(args.min, args.max + 1):
+        n = 1 << k
+        with tempfile.NamedTemporaryFile("w", suffix=".txt") as f:
+            f.write(random_input(n))
+            f.flush()
+
+            engine_time, engine_out = run(["./forkFFT", "-e"], f.name)
+            if k <= args.tree_max:
+                tree_time, tree_out = run(["./forkFFT"], f.name)
+                speedup = f"{tree_time / engine_time:8.1f}"
+                diff = f"{max_difference(tree_out, engine_out):10.6f}"
+                tree = f"{tree_time:10.3f}"
+            else:
+                tree, speedup, diff = f"{'-':>10}", f"{'-':>8}", f"{'-':>10}"
+
+        print(f"{n:>10} {tree} {engine_time:11.3f} {speedup} {diff}")
+
+
+# Return n random complex numbers in the input format of forkFFT
+def random_input(n: int) -> str:
+    lines = [
+        f"{random.uniform(-1, 1):f} {random.uniform(-1, 1):f}*i"
+        for _ in range(n)
+    ]
+    return "\n".join(lines) + "\n"
+
+
+# Run the command with the file as stdin and return the wall time and output
+def run(command, path: str):
+    with open(path, "rb") as stdin:
+        start = time.perf_counter()
+        cp = subprocess.run(command, stdin=stdin, stdout=subprocess.PIPE)
+        elapsed = time.perf_counter() - start
+    if cp.returncode != 0:
+        raise RuntimeError(f"{' '.join(command)} exited with {cp.returncode}")
+    return elapsed, cp.stdout.decode()
+
+
+# Parse two outputs of forkFFT and return the largest difference of a real or
+# imaginary part
+def max_difference(a: str, b: str) -> float:
+    def parse(output: str):
+        for line in output.splitlines():
+            real, imaginary = line.split(" ")
+            yield float(real), float(imaginary[: -len("*i")])
+
+    diff = 0.0
+    for (ar, ai), (br, bi) in zip(parse(a), parse(b)):
+        diff = max(diff, abs(ar - br), abs(ai - bi))
+    return diff
+
+
+if __name__ == "__main__":
+    os.chdir(os.path.dirname(os.path.abspath(__file__)))
+    main()
@@ -0,0 +1,79 @@
+/**
+ * @file binary_io.h
+ * @date 17.12.2020
+ *
+ * @brief Binary input and output of complex numbers.
+ *
+ * The numbers are raw little-endian pairs of float32 or float64 (real part, imaginary part),
+ * which is the layout of numpy's complex64/complex128. Input that starts with the .npy magic
+ * string is read as a numpy array of shape (n,) and dtype '<c8' or '<c16'. Real input is
+ * a sequence of single little-endian float32 or float64 values ('<f4' or '<f8' in .npy files).
+ */
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief binary input, mapped or read into memory.
+ * @param data the first number.
+ * @param count number of complex numbers.
+ * @param precision size of one part in bytes, 4 (float32) or 8 (float64).
+ * @param real 1 if the numbers have no imaginary part.
+ * @param npy 1 if the input was a .npy file.
+ * @param memory the mapping or buffer that has to be released.
+ * @param memory_size size of memory in bytes.
+ * @param mapped 1 if memory is a mapping, 0 if it was allocated.
+*/
+typedef struct BinaryInput {
+    const unsigned char * data;
+    size_t count;
+    int precision;
+    int real;
+    int npy;
+    void * memory;
+    size_t memory_size;
+    int mapped;
+} binary_input_t;
+
+/**
+ * @brief reads all numbers from fd, regular files are mapped instead of read.
+ * @param fd file descriptor to read from.
+ * @param precision 4 or 8, the size of a part of raw input (.npy input brings its own).
+ * @param real 1 if raw input consists of real numbers only (.npy input brings its own).
+ * @param input where the input is stored.
+ * @return 0 on success, -1 if reading failed or the input is malformed (errno = EINVAL).
+ */
+int binary_input_open(int fd, int precision, int real, binary_input_t * input);
+
+/**
+ * @brief returns the i-th number of input, the imaginary part of real input is 0.
+ */
+void binary_input_get(const binary_input_t * input, size_t i, double * real, double * imaginary);
+
+/**
+ * @brief reads up to count real little-endian float32 or float64 values from a stream.
+ * @details a value that is cut off at the end of the stream is dropped.
+ * @return the number of values read, less than count at the end of the stream or on error (see ferror).
+ */
+size_t binary_read_real(FILE * in, int precision, float * samples, size_t count);
+
+/**
+ * @brief releases the memory of input.
+ */
+void binary_input_close(binary_input_t * input);
+
+/**
+ * @brief writes the .npy header for count numbers, does nothing if npy is 0.
+ * @return 0 on success, -1 on error.
+ */
+int binary_output_header(FILE * out, int precision, int npy, size_t count);
+
+/**
+ * @brief writes one number as a little-endian pair of precision bytes each.
+ * @return 0 on success, -1 on error.
+ */
+int binary_output_write(FILE * out, int precision, double real, double imaginary);
+
+#endif
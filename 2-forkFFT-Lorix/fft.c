@@ -0,0 +1,543 @@
+/**
+ * @file fft.c
+ * @date 17.12.2020
+ *
+ * @brief In-process FFT engine.
+ *
+ * Instead of a process per recursion level the whole transform runs in one process:
+ * the input is reordered with a bit-reversal permutation and then combined bottom up
+ * with butterflies, using twiddle factors from a table that is computed only once.
+ *
+ * The points are split into a real and an imaginary buffer while they are permuted, every
+ * stage then reads its twiddle factors contiguously, which lets the SIMD kernels load them
+ * with plain vector loads.
+ *
+ * Sizes that aren't a power of two go through a Stockham FFT, which needs no permutation:
+ * every stage reads one buffer and writes the other in sorted order. Bluestein's algorithm
+ * handles sizes with prime factors above 5 with two Stockham transforms of power-of-two size.
+ *
+ * The tables of a plan (everything but the scratch buffers) can be exported as one block of
+ * bytes. If the loaded wisdom (see fft_cache.h) has such a block for a size, the plan points
+ * into it instead of computing the tables again.
+ */
+
+#include "fft.h"
+#include "fft_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <complex.h>
+
+int fft_is_power_of_two(size_t n){
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+/**
+ * @brief splits n into radix 4, 2, 3 and 5 stages (4 first, it needs the fewest operations).
+ * @return 0 on success, -1 if n has a prime factor above 5.
+ */
+static int factor(size_t n, fft_stages_t * stages){
+    static const size_t radices[] = {4, 2, 3, 5};
+    stages -> n = n;
+    stages -> count = 0;
+    for(size_t i = 0; i < sizeof(radices) / sizeof(radices[0]); i++) {
+        while(n % radices[i] == 0 && n > 1) {
+            stages -> radices[stages -> count++] = radices[i];
+            n /= radices[i];
+        }
+    }
+    return n == 1 ? 0 : -1;
+}
+
+/**
+ * @brief returns the number of twiddle factors of all stages.
+ */
+static size_t stage_twiddle_count(const fft_stages_t * stages){
+    size_t count = 0;
+    size_t length = stages -> n;
+    for(size_t i = 0; i < stages -> count; i++) {
+        count += length - length / stages -> radices[i];
+        length /= stages -> radices[i];
+    }
+    return count;
+}
+
+/**
+ * @brief computes the twiddle factors of the factored stages.
+ * @param tables the twiddle factors from the wisdom, NULL to compute them.
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int create_stages(fft_stages_t * stages, const double * tables){
+    if(tables != NULL) {
+        stages -> twiddles = (double *) tables;
+        return 0;
+    }
+    stages -> twiddles = malloc((stage_twiddle_count(stages) + 1) * 2 * sizeof(double));
+    if(stages -> twiddles == NULL) {
+        return -1;
+    }
+    double complex * twiddles = (double complex *) stages -> twiddles;
+    size_t length = stages -> n;
+    for(size_t i = 0; i < stages -> count; i++) {
+        size_t r = stages -> radices[i];
+        size_t m = length / r;
+        for(size_t p = 0; p < m; p++) {
+            for(size_t k = 1; k < r; k++) {
+                double angle = -2.0 * M_PI * (double) (p * k) / (double) length;
+                *twiddles++ = cos(angle) + I * sin(angle);
+            }
+        }
+        length = m;
+    }
+    return 0;
+}
+
+/**
+ * @brief transforms stages -> n points of x with the Stockham algorithm.
+ * @param x the points, replaced by the result.
+ * @param y scratch buffer of the same size.
+ */
+static void stockham(const fft_stages_t * stages, double complex * x, double complex * y){
+    const double complex * twiddles = (const double complex *) stages -> twiddles;
+    double complex * in = x;
+    double complex * out = y;
+    size_t length = stages -> n;
+    size_t stride = 1;
+
+    for(size_t i = 0; i < stages -> count; i++) {
+        size_t r = stages -> radices[i];
+        size_t m = length / r;
+        double complex roots[5];
+        for(size_t k = 0; k < r; k++) {
+            roots[k] = cos(-2.0 * M_PI * k / r) + I * sin(-2.0 * M_PI * k / r);
+        }
+
+        for(size_t p = 0; p < m; p++) {
+            const double complex * w = twiddles + p * (r - 1);
+            for(size_t q = 0; q < stride; q++) {
+                double complex a[5], b[5];
+                for(size_t j = 0; j < r; j++) {
+                    a[j] = in[q + stride * (p + j * m)];
+                }
+                if(r == 2) {
+                    b[0] = a[0] + a[1];
+                    b[1] = a[0] - a[1];
+                } else if(r == 4) {
+                    double complex s0 = a[0] + a[2], d0 = a[0] - a[2];
+                    double complex s1 = a[1] + a[3], d1 = (a[1] - a[3]) * -I;
+                    b[0] = s0 + s1;
+                    b[1] = d0 + d1;
+                    b[2] = s0 - s1;
+                    b[3] = d0 - d1;
+                } else {
+                    // radix 3 and 5: a direct DFT of r points
+                    for(size_t k = 0; k < r; k++) {
+                        b[k] = a[0];
+                        for(size_t j = 1; j < r; j++) {
+                            b[k] += a[j] * roots[(j * k) % r];
+                        }
+                    }
+                }
+                out[q + stride * r * p] = b[0];
+                for(size_t k = 1; k < r; k++) {
+                    out[q + stride * (r * p + k)] = b[k] * w[k - 1];
+                }
+            }
+        }
+
+        twiddles += m * (r - 1);
+        length = m;
+        stride *= r;
+        double complex * tmp = in;
+        in = out;
+        out = tmp;
+    }
+
+    if(in != x) {
+        memcpy(x, in, stages -> n * sizeof(double complex));
+    }
+}
+
+/**
+ * @brief returns the size of the convolution of Bluestein's algorithm for n points.
+ */
+static size_t bluestein_size(size_t n){
+    size_t m = 1;
+    while(m < 2 * n - 1) {
+        m <<= 1;
+    }
+    return m;
+}
+
+/**
+ * @brief prepares Bluestein's algorithm: chirp, convolution size and transformed kernel.
+ * @param tables chirp, transformed kernel and stage twiddles from the wisdom, NULL to compute them.
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int create_bluestein(fft_plan_t * plan, const double * tables){
+    size_t n = plan -> n;
+    size_t m = bluestein_size(n);
+    factor(m, &plan -> stages);
+
+    plan -> work = malloc(4 * m * sizeof(double));
+    if(plan -> work == NULL) {
+        return -1;
+    }
+    if(tables != NULL) {
+        plan -> chirp = (double *) tables;
+        plan -> chirp_fft = (double *) tables + 2 * n;
+        return create_stages(&plan -> stages, tables + 2 * n + 2 * m);
+    }
+
+    plan -> chirp = malloc(2 * n * sizeof(double));
+    plan -> chirp_fft = malloc(2 * m * sizeof(double));
+    if(plan -> chirp == NULL || plan -> chirp_fft == NULL || create_stages(&plan -> stages, NULL) == -1) {
+        return -1;
+    }
+
+    double complex * chirp = (double complex *) plan -> chirp;
+    double complex * kernel = (double complex *) plan -> chirp_fft;
+    for(size_t k = 0; k < n; k++) {
+        // k^2 mod 2n keeps the angle small, so it stays exact for large k
+        unsigned long long square = (unsigned long long) k * k % (2 * (unsigned long long) n);
+        double angle = -M_PI * (double) square / (double) n;
+        chirp[k] = cos(angle) + I * sin(angle);
+    }
+    memset(kernel, 0, m * sizeof(double complex));
+    kernel[0] = conj(chirp[0]);
+    for(size_t k = 1; k < n; k++) {
+        kernel[k] = conj(chirp[k]);
+        kernel[m - k] = conj(chirp[k]);
+    }
+    stockham(&plan -> stages, kernel, (double complex *) plan -> work);
+    return 0;
+}
+
+/**
+ * @brief creates the tables of the radix-2 path.
+ * @param tables bit-reversal table and twiddle factors from the wisdom, NULL to compute them.
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int create_power_of_two(fft_plan_t * plan, const unsigned char * tables){
+    size_t n = plan -> n;
+    // the kernel is always chosen again, the wisdom may come from another CPU
+    plan -> kernel = fft_kernel_select();
+    plan -> re = malloc(n * sizeof(float));
+    plan -> im = malloc(n * sizeof(float));
+    if(plan -> re == NULL || plan -> im == NULL) {
+        return -1;
+    }
+    if(tables != NULL) {
+        plan -> bitrev = (uint32_t *) tables;
+        plan -> twiddle_re = (float *) (tables + n * sizeof(uint32_t));
+        plan -> twiddle_im = plan -> twiddle_re + n;
+        return 0;
+    }
+
+    plan -> bitrev = malloc(n * sizeof(uint32_t));
+    plan -> twiddle_re = malloc(n * sizeof(float));
+    plan -> twiddle_im = malloc(n * sizeof(float));
+    if(plan -> bitrev == NULL || plan -> twiddle_re == NULL || plan -> twiddle_im == NULL) {
+        return -1;
+    }
+
+    int bits = 0;
+    while(((size_t) 1 << bits) < n) {
+        bits++;
+    }
+    for(size_t i = 0; i < n; i++) {
+        uint32_t r = 0;
+        for(int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        plan -> bitrev[i] = r;
+    }
+
+    // computed in double precision, the error of the table doesn't add up this way
+    for(size_t half = 1; half < n; half <<= 1) {
+        for(size_t k = 0; k < half; k++) {
+            double angle = -M_PI * (double) k / (double) half;
+            plan -> twiddle_re[half - 1 + k] = cos(angle);
+            plan -> twiddle_im[half - 1 + k] = sin(angle);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief checks if n takes the radix-2 path.
+ */
+static int uses_power_of_two(size_t n){
+    return fft_is_power_of_two(n) && n <= UINT32_MAX;
+}
+
+/**
+ * @brief returns the size in bytes of the tables of a plan for n points.
+ */
+static size_t tables_size(size_t n){
+    fft_stages_t stages;
+    if(uses_power_of_two(n)) {
+        return n * (sizeof(uint32_t) + 2 * sizeof(float));
+    }
+    if(factor(n, &stages) == 0) {
+        return stage_twiddle_count(&stages) * 2 * sizeof(double);
+    }
+    size_t m = bluestein_size(n);
+    factor(m, &stages);
+    return (n + m + stage_twiddle_count(&stages)) * 2 * sizeof(double);
+}
+
+fft_plan_t * fft_plan_create(size_t n){
+    if(n == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    fft_plan_t * plan = calloc(1, sizeof(fft_plan_t));
+    if(plan == NULL) {
+        return NULL;
+    }
+    plan -> n = n;
+
+    // wisdom of a different layout (e.g. from an older version) is ignored
+    size_t size;
+    const void * tables = fft_wisdom_find(n, &size);
+    if(tables != NULL && size != tables_size(n)) {
+        tables = NULL;
+    }
+    plan -> imported = tables != NULL;
+
+    int result;
+    if(uses_power_of_two(n)) {
+        result = create_power_of_two(plan, tables);
+    } else if(factor(n, &plan -> stages) == 0) {
+        plan -> work = malloc(4 * n * sizeof(double));
+        result = plan -> work == NULL ? -1 : create_stages(&plan -> stages, tables);
+    } else {
+        result = create_bluestein(plan, tables);
+    }
+    if(result == -1) {
+        fft_plan_destroy(plan);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return plan;
+}
+
+void fft_plan_destroy(fft_plan_t * plan){
+    if(plan == NULL) {
+        return;
+    }
+    if(!plan -> imported) {
+        free(plan -> bitrev);
+        free(plan -> twiddle_re);
+        free(plan -> twiddle_im);
+        free(plan -> stages.twiddles);
+        free(plan -> chirp);
+        free(plan -> chirp_fft);
+    }
+    free(plan -> re);
+    free(plan -> im);
+    free(plan -> work);
+    free(plan);
+}
+
+size_t fft_plan_export(const fft_plan_t * plan, void * buffer){
+    size_t size = tables_size(plan -> n);
+    if(buffer == NULL) {
+        return size;
+    }
+
+    unsigned char * out = buffer;
+    size_t n = plan -> n;
+    if(plan -> bitrev != NULL) {
+        memcpy(out, plan -> bitrev, n * sizeof(uint32_t));
+        memcpy(out + n * sizeof(uint32_t), plan -> twiddle_re, n * sizeof(float));
+        memcpy(out + n * (sizeof(uint32_t) + sizeof(float)), plan -> twiddle_im, n * sizeof(float));
+        return size;
+    }
+    if(plan -> chirp != NULL) {
+        size_t m = plan -> stages.n;
+        memcpy(out, plan -> chirp, 2 * n * sizeof(double));
+        memcpy(out + 2 * n * sizeof(double), plan -> chirp_fft, 2 * m * sizeof(double));
+        out += 2 * (n + m) * sizeof(double);
+    }
+    memcpy(out, plan -> stages.twiddles, stage_twiddle_count(&plan -> stages) * 2 * sizeof(double));
+    return size;
+}
+
+/**
+ * @brief the radix-2 path for powers of two.
+ */
+static void execute_power_of_two(const fft_plan_t * plan, complex_t * data){
+    size_t n = plan -> n;
+    float * re = plan -> re;
+    float * im = plan -> im;
+
+    for(size_t i = 0; i < n; i++) {
+        const complex_t * x = &data[plan -> bitrev[i]];
+        re[i] = x -> real;
+        im[i] = x -> imaginary;
+    }
+
+    // half is the size of the transforms that are combined in this stage
+    for(size_t half = 1; half < n; half <<= 1) {
+        fft_kernel_stage(plan -> kernel, re, im, plan -> twiddle_re + half - 1,
+            plan -> twiddle_im + half - 1, n, half);
+    }
+
+    for(size_t i = 0; i < n; i++) {
+        data[i].real = re[i];
+        data[i].imaginary = im[i];
+    }
+}
+
+/**
+ * @brief Bluestein's algorithm: X[k] = chirp[k] * sum x[j] chirp[j] conj(chirp[k - j]),
+ * the convolution is done with two transforms of size stages.n.
+ */
+static void execute_bluestein(const fft_plan_t * plan, complex_t * data){
+    size_t n = plan -> n;
+    size_t m = plan -> stages.n;
+    const double complex * chirp = (const double complex *) plan -> chirp;
+    const double complex * kernel = (const double complex *) plan -> chirp_fft;
+    double complex * a = (double complex *) plan -> work;
+
+    for(size_t k = 0; k < n; k++) {
+        a[k] = (data[k].real + I * data[k].imaginary) * chirp[k];
+    }
+    memset(a + n, 0, (m - n) * sizeof(double complex));
+    stockham(&plan -> stages, a, a + m);
+
+    // the inverse transform is a forward transform of the conjugate
+    for(size_t k = 0; k < m; k++) {
+        a[k] = conj(a[k] * kernel[k]);
+    }
+    stockham(&plan -> stages, a, a + m);
+
+    for(size_t k = 0; k < n; k++) {
+        double complex x = conj(a[k]) / (double) m * chirp[k];
+        data[k].real = creal(x);
+        data[k].imaginary = cimag(x);
+    }
+}
+
+void fft_execute(const fft_plan_t * plan, complex_t * data){
+    if(plan -> bitrev != NULL) {
+        execute_power_of_two(plan, data);
+        return;
+    }
+    if(plan -> chirp != NULL) {
+        execute_bluestein(plan, data);
+        return;
+    }
+
+    size_t n = plan -> n;
+    double complex * x = (double complex *) plan -> work;
+    for(size_t i = 0; i < n; i++) {
+        x[i] = data[i].real + I * data[i].imaginary;
+    }
+    stockham(&plan -> stages, x, x + n);
+    for(size_t i = 0; i < n; i++) {
+        data[i].real = creal(x[i]);
+        data[i].imaginary = cimag(x[i]);
+    }
+}
+
+void fft_execute_batch(const fft_plan_t * plan, complex_t * data, size_t count){
+    for(size_t i = 0; i < count; i++) {
+        fft_execute(plan, data + i * plan -> n);
+    }
+}
+
+fft_real_plan_t * fft_real_plan_create(size_t n){
+    if(n == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    fft_real_plan_t * plan = calloc(1, sizeof(fft_real_plan_t));
+    if(plan == NULL) {
+        return NULL;
+    }
+    plan -> n = n;
+
+    if(n % 2 == 1) {
+        plan -> full = fft_plan_create(n);
+        plan -> buffer = malloc(n * sizeof(complex_t));
+    } else {
+        plan -> half = fft_plan_create(n / 2);
+        plan -> buffer = malloc(n / 2 * sizeof(complex_t));
+        plan -> twiddles = malloc((n / 2 + 1) * 2 * sizeof(double));
+    }
+    if((plan -> full == NULL && plan -> half == NULL) || plan -> buffer == NULL ||
+        (plan -> half != NULL && plan -> twiddles == NULL)) {
+        fft_real_plan_destroy(plan);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if(plan -> half != NULL) {
+        double complex * twiddles = (double complex *) plan -> twiddles;
+        for(size_t k = 0; k <= n / 2; k++) {
+            double angle = -2.0 * M_PI * (double) k / (double) n;
+            twiddles[k] = cos(angle) + I * sin(angle);
+        }
+    }
+    return plan;
+}
+
+void fft_real_plan_destroy(fft_real_plan_t * plan){
+    if(plan == NULL) {
+        return;
+    }
+    fft_plan_destroy(plan -> half);
+    fft_plan_destroy(plan -> full);
+    free(plan -> twiddles);
+    free(plan -> buffer);
+    free(plan);
+}
+
+void fft_execute_real(const fft_real_plan_t * plan, const float * input, complex_t * output){
+    complex_t * z = plan -> buffer;
+
+    if(plan -> full != NULL) {
+        for(size_t i = 0; i < plan -> n; i++) {
+            z[i].real = input[i];
+            z[i].imaginary = 0;
+        }
+        fft_execute(plan -> full, z);
+        memcpy(output, z, (plan -> n / 2 + 1) * sizeof(complex_t));
+        return;
+    }
+
+    size_t h = plan -> n / 2;
+    for(size_t i = 0; i < h; i++) {
+        z[i].real = input[2 * i];
+        z[i].imaginary = input[2 * i + 1];
+    }
+    fft_execute(plan -> half, z);
+
+    /*
+    Z = E + i*O where E and O are the transforms of the even and odd samples, both have
+    conjugate symmetric spectra: E[k] = (Z[k] + conj(Z[h-k])) / 2, O[k] = (Z[k] - conj(Z[h-k])) / 2i
+    and X[k] = E[k] + e^(-2*pi*i*k/n) * O[k].
+    */
+    const double complex * twiddles = (const double complex *) plan -> twiddles;
+    for(size_t k = 0; k <= h; k++) {
+        double complex a = z[k % h].real + I * z[k % h].imaginary;
+        double complex b = z[(h - k) % h].real - I * z[(h - k) % h].imaginary;
+        double complex even = (a + b) / 2;
+        double complex odd = (a - b) / (2 * I);
+        double complex x = even + twiddles[k] * odd;
+        output[k].real = creal(x);
+        output[k].imaginary = cimag(x);
+    }
+}
+
+void fft_execute_real_batch(const fft_real_plan_t * plan, const float * input, complex_t * output, size_t count){
+    for(size_t i = 0; i < count; i++) {
+        fft_execute_real(plan, input + i * plan -> n, output + i * (plan -> n / 2 + 1));
+    }
+}
@@ -0,0 +1,156 @@
+/**
+ * @file fft.h
+ * @date 17.12.2020
+ *
+ * @brief In-process FFT engine.
+ *
+ * Powers of two use an iterative in-place radix-2 FFT. The bit-reversal permutation and the
+ * twiddle factors are computed once per size and stored in a plan, which can be executed any
+ * number of times. The butterflies run on split real/imaginary buffers with the SIMD kernel
+ * chosen in fft_kernels.c.
+ *
+ * Other sizes are factored into radix 4, 2, 3 and 5 stages of a Stockham FFT in double
+ * precision. Sizes with a larger prime factor use Bluestein's algorithm, which turns the
+ * transform into a convolution of power-of-two size, so every size takes O(n log n).
+ *
+ * Real input of even size n is packed into n/2 complex points (even samples as real parts, odd
+ * samples as imaginary parts), transformed with a plan of half the size and then split into
+ * the n/2+1 bins that aren't redundant. A plan can be executed on a batch of equal-length
+ * signals, so the setup is paid once.
+ */
+#ifndef FFT_H
+#define FFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "forkFFT.h"
+#include "fft_kernels.h"
+
+// more stages than bits in size_t are impossible
+#define FFT_MAX_STAGES (64)
+
+/**
+ * @brief the stages of a mixed-radix (Stockham) transform.
+ * @param n number of points.
+ * @param count number of stages.
+ * @param radices radix of every stage in the order they are applied (4, 2, 3 or 5).
+ * @param twiddles interleaved real/imaginary twiddle factors of all stages, a stage of length l
+ * and radix r has (l/r)*(r-1) of them.
+*/
+typedef struct FFTStages {
+    size_t n;
+    size_t count;
+    size_t radices[FFT_MAX_STAGES];
+    double * twiddles;
+} fft_stages_t;
+
+/**
+ * @brief precomputed tables for transforms of one size.
+ * @details The power-of-two tables are NULL for other sizes.
+ * @param n number of points.
+ * @param bitrev bitrev[i] is the index i with its log2(n) bits reversed.
+ * @param twiddle_re real parts of the twiddle factors of all stages, the half factors
+ * e^(-pi*i*k/half) of the stage combining transforms of size half start at index half-1.
+ * @param twiddle_im imaginary parts, laid out like twiddle_re.
+ * @param re scratch buffer for the real parts of the n points.
+ * @param im scratch buffer for the imaginary parts of the n points.
+ * @param kernel the butterfly kernel.
+ * @param stages the mixed-radix stages of n, or of the convolution size if Bluestein is used.
+ * @param work two buffers of stages.n interleaved double complex numbers.
+ * @param chirp the n factors e^(-pi*i*k^2/n) (interleaved), NULL unless Bluestein is used.
+ * @param chirp_fft transform of the conjugated chirp, stages.n numbers.
+ * @param imported 1 if the tables point into the loaded wisdom and must not be freed.
+*/
+typedef struct FFTPlan {
+    size_t n;
+    uint32_t * bitrev;
+    float * twiddle_re;
+    float * twiddle_im;
+    float * re;
+    float * im;
+    const fft_kernel_t * kernel;
+    fft_stages_t stages;
+    double * work;
+    double * chirp;
+    double * chirp_fft;
+    int imported;
+} fft_plan_t;
+
+/**
+ * @brief precomputed tables for real transforms of one size.
+ * @param n number of real samples.
+ * @param half plan of the n/2 packed points, NULL if n is odd.
+ * @param full plan of n points for odd n, the samples are transformed as complex numbers then.
+ * @param twiddles the n/2+1 factors e^(-2*pi*i*k/n) (interleaved) that split the packed result.
+ * @param buffer scratch buffer for the packed (or complex) points.
+*/
+typedef struct FFTRealPlan {
+    size_t n;
+    fft_plan_t * half;
+    fft_plan_t * full;
+    double * twiddles;
+    complex_t * buffer;
+} fft_real_plan_t;
+
+/**
+ * @brief checks if n is a power of two (and not 0).
+ */
+int fft_is_power_of_two(size_t n);
+
+/**
+ * @brief creates a plan for transforms of n points.
+ * @details uses the tables of the loaded wisdom if it has them for n, the plan must be destroyed
+ * before the wisdom is unloaded then.
+ * @return the plan or NULL if n is 0 (errno = EINVAL) or memory ran out.
+ */
+fft_plan_t * fft_plan_create(size_t n);
+
+/**
+ * @brief copies the tables of plan (everything but the scratch buffers) to buffer.
+ * @param buffer where the tables are written, NULL to only get their size.
+ * @return the size of the tables in bytes.
+ */
+size_t fft_plan_export(const fft_plan_t * plan, void * buffer);
+
+/**
+ * @brief frees a plan created by fft_plan_create.
+ */
+void fft_plan_destroy(fft_plan_t * plan);
+
+/**
+ * @brief transforms plan->n points in data in place.
+ * @details uses the scratch buffers of plan, so a plan can only be executed by one thread at a time.
+ */
+void fft_execute(const fft_plan_t * plan, complex_t * data);
+
+/**
+ * @brief transforms count signals of plan->n points, stored one after another in data, in place.
+ */
+void fft_execute_batch(const fft_plan_t * plan, complex_t * data, size_t count);
+
+/**
+ * @brief creates a plan for transforms of n real samples.
+ * @return the plan or NULL if n is 0 (errno = EINVAL) or memory ran out.
+ */
+fft_real_plan_t * fft_real_plan_create(size_t n);
+
+/**
+ * @brief frees a plan created by fft_real_plan_create.
+ */
+void fft_real_plan_destroy(fft_real_plan_t * plan);
+
+/**
+ * @brief transforms plan->n real samples.
+ * @details the other bins are the complex conjugates, X[n-k] = conj(X[k]).
+ * @param input the samples.
+ * @param output the bins 0 to n/2 (n/2+1 numbers).
+ */
+void fft_execute_real(const fft_real_plan_t * plan, const float * input, complex_t * output);
+
+/**
+ * @brief transforms count signals of plan->n real samples stored one after another,
+ * the n/2+1 bins of each signal are written one after another to output.
+ */
+void fft_execute_real_batch(const fft_real_plan_t * plan, const float * input, complex_t * output, size_t count);
+
+#endif
@@ -0,0 +1,370 @@
+/**
+ * @file fft_cache.c
+ * @date 17.12.2020
+ *
+ * @brief Plan cache and wisdom file of the FFT engine.
+ *
+ * A wisdom file starts with a header (magic, version, a byte order mark and the number of
+ * entries), followed by a directory of (size, offset, length) entries and the tables of the
+ * plans, each starting at a multiple of 64 bytes so the mapped tables are aligned.
+ */
+
+#include "fft_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WISDOM_MAGIC "FFTWISDM"
+#define WISDOM_VERSION (1)
+#define WISDOM_BYTE_ORDER (0x01020304)
+#define WISDOM_ALIGNMENT (64)
+
+/**
+ * @brief the header of a wisdom file.
+*/
+typedef struct WisdomHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t count;
+} wisdom_header_t;
+
+/**
+ * @brief an entry of the directory of a wisdom file.
+ * @param n number of points of the plan.
+ * @param offset position of the tables from the start of the file.
+ * @param size size of the tables in bytes.
+*/
+typedef struct WisdomEntry {
+    uint64_t n;
+    uint64_t offset;
+    uint64_t size;
+} wisdom_entry_t;
+
+/**
+ * @brief a cached plan, exactly one of plan and real_plan is set.
+*/
+typedef struct CacheEntry {
+    size_t n;
+    fft_plan_t * plan;
+    fft_real_plan_t * real_plan;
+} cache_entry_t;
+
+static cache_entry_t * cache = NULL;
+static size_t cache_count = 0;
+static size_t cache_capacity = 0;
+
+static unsigned char * wisdom = NULL;
+static size_t wisdom_size = 0;
+
+/**
+ * @brief returns the directory of the loaded wisdom.
+ */
+static const wisdom_entry_t * wisdom_entries(size_t * count){
+    if(wisdom == NULL) {
+        *count = 0;
+        return NULL;
+    }
+    *count = ((const wisdom_header_t *) wisdom) -> count;
+    return (const wisdom_entry_t *) (wisdom + sizeof(wisdom_header_t));
+}
+
+/**
+ * @brief adds an entry to the cache.
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int cache_add(size_t n, fft_plan_t * plan, fft_real_plan_t * real_plan){
+    if(cache_count == cache_capacity) {
+        size_t capacity = cache_capacity == 0 ? 16 : 2 * cache_capacity;
+        cache_entry_t * bigger = realloc(cache, capacity * sizeof(cache_entry_t));
+        if(bigger == NULL) {
+            return -1;
+        }
+        cache = bigger;
+        cache_capacity = capacity;
+    }
+    cache[cache_count].n = n;
+    cache[cache_count].plan = plan;
+    cache[cache_count].real_plan = real_plan;
+    cache_count++;
+    return 0;
+}
+
+fft_plan_t * fft_cache_plan(size_t n){
+    for(size_t i = 0; i < cache_count; i++) {
+        if(cache[i].plan != NULL && cache[i].n == n) {
+            return cache[i].plan;
+        }
+    }
+    fft_plan_t * plan = fft_plan_create(n);
+    if(plan != NULL && cache_add(n, plan, NULL) == -1) {
+        fft_plan_destroy(plan);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return plan;
+}
+
+fft_real_plan_t * fft_cache_real_plan(size_t n){
+    for(size_t i = 0; i < cache_count; i++) {
+        if(cache[i].real_plan != NULL && cache[i].n == n) {
+            return cache[i].real_plan;
+        }
+    }
+    fft_real_plan_t * plan = fft_real_plan_create(n);
+    if(plan != NULL && cache_add(n, NULL, plan) == -1) {
+        fft_real_plan_destroy(plan);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return plan;
+}
+
+void fft_cache_clear(void){
+    for(size_t i = 0; i < cache_count; i++) {
+        fft_plan_destroy(cache[i].plan);
+        fft_real_plan_destroy(cache[i].real_plan);
+    }
+    free(cache);
+    cache = NULL;
+    cache_count = 0;
+    cache_capacity = 0;
+
+    if(wisdom != NULL) {
+        munmap(wisdom, wisdom_size);
+        wisdom = NULL;
+        wisdom_size = 0;
+    }
+}
+
+/**
+ * @brief checks the header, the directory and the alignment of a mapped wisdom file.
+ * @return 0 if the file is valid, -1 otherwise.
+ */
+static int check_wisdom(const unsigned char * memory, size_t size){
+    const wisdom_header_t * header = (const wisdom_header_t *) memory;
+    if(size < sizeof(wisdom_header_t) || memcmp(header -> magic, WISDOM_MAGIC, sizeof(header -> magic)) != 0 ||
+        header -> version != WISDOM_VERSION || header -> byte_order != WISDOM_BYTE_ORDER) {
+        return -1;
+    }
+    if(header -> count > (size - sizeof(wisdom_header_t)) / sizeof(wisdom_entry_t)) {
+        return -1;
+    }
+    const wisdom_entry_t * entries = (const wisdom_entry_t *) (memory + sizeof(wisdom_header_t));
+    for(uint64_t i = 0; i < header -> count; i++) {
+        if(entries[i].n == 0 || entries[i].offset % WISDOM_ALIGNMENT != 0 ||
+            entries[i].offset > size || entries[i].size > size - entries[i].offset) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int fft_wisdom_load(const char * path){
+    if(wisdom != NULL) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if(fd == -1) {
+        return -1;
+    }
+    struct stat info;
+    if(fstat(fd, &info) == -1) {
+        close(fd);
+        return -1;
+    }
+    if(info.st_size < (off_t) sizeof(wisdom_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    void * map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        return -1;
+    }
+    if(check_wisdom(map, info.st_size) == -1) {
+        munmap(map, info.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+    wisdom = map;
+    wisdom_size = info.st_size;
+    return 0;
+}
+
+const void * fft_wisdom_find(size_t n, size_t * size){
+    size_t count;
+    const wisdom_entry_t * entries = wisdom_entries(&count);
+    for(size_t i = 0; i < count; i++) {
+        if(entries[i].n == n) {
+            *size = entries[i].size;
+            return wisdom + entries[i].offset;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief adds plan to the plans that are saved, unless its size is already there.
+ * @param dirty set to 1 if the plan didn't come from the wisdom.
+ */
+static void collect(const fft_plan_t ** plans, size_t * count, const fft_plan_t * plan, int * dirty){
+    if(plan == NULL) {
+        return;
+    }
+    for(size_t i = 0; i < *count; i++) {
+        if(plans[i] -> n == plan -> n) {
+            return;
+        }
+    }
+    plans[(*count)++] = plan;
+    if(!plan -> imported) {
+        *dirty = 1;
+    }
+}
+
+/**
+ * @brief writes padding zeros until position is a multiple of WISDOM_ALIGNMENT.
+ * @return 0 on success, -1 on error.
+ */
+static int write_padding(FILE * out, uint64_t * position){
+    while(*position % WISDOM_ALIGNMENT != 0) {
+        if(fputc(0, out) == EOF) {
+            return -1;
+        }
+        (*position)++;
+    }
+    return 0;
+}
+
+/**
+ * @brief writes the wisdom file with the tables of plans and of the wisdom entries whose size
+ * isn't in plans.
+ * @return 0 on success, -1 on error.
+ */
+static int write_wisdom(FILE * out, const fft_plan_t ** plans, size_t plan_count){
+    size_t old_count;
+    const wisdom_entry_t * old = wisdom_entries(&old_count);
+
+    wisdom_entry_t * entries = malloc((plan_count + old_count + 1) * sizeof(wisdom_entry_t));
+    if(entries == NULL) {
+        return -1;
+    }
+    size_t count = 0;
+    for(size_t i = 0; i < plan_count; i++) {
+        entries[count].n = plans[i] -> n;
+        entries[count++].size = fft_plan_export(plans[i], NULL);
+    }
+    for(size_t i = 0; i < old_count; i++) {
+        size_t j = 0;
+        while(j < plan_count && plans[j] -> n != old[i].n) {
+            j++;
+        }
+        if(j == plan_count) {
+            entries[count++] = old[i];
+        }
+    }
+
+    uint64_t position = sizeof(wisdom_header_t) + count * sizeof(wisdom_entry_t);
+    for(size_t i = 0; i < count; i++) {
+        position += (WISDOM_ALIGNMENT - position % WISDOM_ALIGNMENT) % WISDOM_ALIGNMENT;
+        entries[i].offset = position;
+        position += entries[i].size;
+    }
+
+    wisdom_header_t header;
+    memcpy(header.magic, WISDOM_MAGIC, sizeof(header.magic));
+    header.version = WISDOM_VERSION;
+    header.byte_order = WISDOM_BYTE_ORDER;
+    header.count = count;
+
+    int result = 0;
+    if(fwrite(&header, sizeof(header), 1, out) != 1 || fwrite(entries, sizeof(wisdom_entry_t), count, out) != count) {
+        result = -1;
+    }
+    position = sizeof(header) + count * sizeof(wisdom_entry_t);
+
+    for(size_t i = 0; i < count && result == 0; i++) {
+        if(write_padding(out, &position) == -1) {
+            result = -1;
+            break;
+        }
+        const void * tables;
+        void * buffer = NULL;
+        if(i < plan_count) {
+            buffer = malloc(entries[i].size + 1);
+            if(buffer == NULL) {
+                result = -1;
+                break;
+            }
+            fft_plan_export(plans[i], buffer);
+            tables = buffer;
+        } else {
+            // entries of the old wisdom are copied from the mapping
+            size_t size;
+            tables = fft_wisdom_find(entries[i].n, &size);
+        }
+        if(fwrite(tables, 1, entries[i].size, out) != entries[i].size) {
+            result = -1;
+        }
+        free(buffer);
+        position += entries[i].size;
+    }
+    free(entries);
+    return result;
+}
+
+int fft_wisdom_save(const char * path){
+    // a real plan contributes the complex plan it uses
+    const fft_plan_t ** plans = malloc((2 * cache_count + 1) * sizeof(fft_plan_t *));
+    if(plans == NULL) {
+        return -1;
+    }
+    size_t count = 0;
+    int dirty = 0;
+    for(size_t i = 0; i < cache_count; i++) {
+        collect(plans, &count, cache[i].plan, &dirty);
+        if(cache[i].real_plan != NULL) {
+            collect(plans, &count, cache[i].real_plan -> half, &dirty);
+            collect(plans, &count, cache[i].real_plan -> full, &dirty);
+        }
+    }
+    if(!dirty) {
+        free(plans);
+        return 0;
+    }
+
+    char * temporary = malloc(strlen(path) + sizeof(".tmp"));
+    if(temporary == NULL) {
+        free(plans);
+        return -1;
+    }
+    sprintf(temporary, "%s.tmp", path);
+
+    int result = -1;
+    FILE * out = fopen(temporary, "w");
+    if(out != NULL) {
+        result = write_wisdom(out, plans, count);
+        if(fclose(out) == EOF) {
+            result = -1;
+        }
+        if(result == 0 && rename(temporary, path) == -1) {
+            result = -1;
+        }
+        if(result == -1) {
+            unlink(temporary);
+        }
+    }
+    free(temporary);
+    free(plans);
+    return result;
+}
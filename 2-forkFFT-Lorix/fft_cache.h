@@ -0,0 +1,63 @@
+/**
+ * @file fft_cache.h
+ * @date 17.12.2020
+ *
+ * @brief Plan cache and wisdom file of the FFT engine.
+ *
+ * The cache keeps one plan per size (and one real plan per size) for the lifetime of the
+ * process, so transforms of a size that was seen before skip the setup. The tables of the
+ * cached plans can be saved to a wisdom file. A later run maps the file and fft_plan_create
+ * points its tables into the mapping instead of computing them.
+ *
+ * The wisdom is stored in the byte order of the host. A file with another byte order or an
+ * unknown version is rejected.
+ */
+#ifndef FFT_CACHE_H
+#define FFT_CACHE_H
+
+#include <stddef.h>
+#include "fft.h"
+
+/**
+ * @brief returns the cached plan for n points, it is created on the first request.
+ * @details the plan belongs to the cache and must not be destroyed.
+ * @return the plan or NULL if it couldn't be created (see fft_plan_create).
+ */
+fft_plan_t * fft_cache_plan(size_t n);
+
+/**
+ * @brief returns the cached real plan for n samples, it is created on the first request.
+ * @details the plan belongs to the cache and must not be destroyed.
+ * @return the plan or NULL if it couldn't be created (see fft_real_plan_create).
+ */
+fft_real_plan_t * fft_cache_real_plan(size_t n);
+
+/**
+ * @brief destroys all cached plans and unloads the wisdom.
+ */
+void fft_cache_clear(void);
+
+/**
+ * @brief maps the wisdom file at path.
+ * @details wisdom can only be loaded once, fft_cache_clear unloads it.
+ * @return 0 on success, -1 if the file couldn't be mapped, is malformed (errno = EINVAL) or
+ * wisdom is already loaded (errno = EBUSY).
+ */
+int fft_wisdom_load(const char * path);
+
+/**
+ * @brief writes the tables of all cached plans and the loaded wisdom to path.
+ * @details the file is written next to path and then renamed, so a mapping of the old file stays
+ * valid. Nothing is written if the loaded wisdom already has all cached sizes.
+ * @return 0 on success, -1 on error.
+ */
+int fft_wisdom_save(const char * path);
+
+/**
+ * @brief returns the tables for n points from the loaded wisdom.
+ * @param size the size of the tables in bytes.
+ * @return the tables or NULL if there are none for n.
+ */
+const void * fft_wisdom_find(size_t n, size_t * size);
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * @file fft_kernels.c
+ * @date 17.12.2020
+ *
+ * @brief Butterfly kernels working on split real/imaginary (structure of arrays) buffers.
+ *
+ * With the real and imaginary parts in separate arrays, a vector register holds the same
+ * part of consecutive points, so one complex multiplication of a whole register takes
+ * four multiplications and two additions without any shuffling.
+ */
+
+#include "fft_kernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FFT_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief scalar butterflies, works for every stage.
+ */
+static void stage_scalar(float * re, float * im, const float * wre, const float * wim, size_t n, size_t half){
+    for(size_t start = 0; start < n; start += 2 * half) {
+        float * ere = re + start, * eim = im + start;
+        float * ore = ere + half, * oim = eim + half;
+        for(size_t k = 0; k < half; k++) {
+            float cre = wre[k] * ore[k] - wim[k] * oim[k];
+            float cim = wre[k] * oim[k] + wim[k] * ore[k];
+            ore[k] = ere[k] - cre;
+            oim[k] = eim[k] - cim;
+            ere[k] = ere[k] + cre;
+            eim[k] = eim[k] + cim;
+        }
+    }
+}
+
+#ifdef FFT_X86
+/**
+ * @brief SSE2 butterflies, 4 points at once (half has to be a multiple of 4).
+ */
+__attribute__((target("sse2")))
+static void stage_sse2(float * re, float * im, const float * wre, const float * wim, size_t n, size_t half){
+    for(size_t start = 0; start < n; start += 2 * half) {
+        float * ere = re + start, * eim = im + start;
+        float * ore = ere + half, * oim = eim + half;
+        for(size_t k = 0; k < half; k += 4) {
+            __m128 wr = _mm_loadu_ps(wre + k), wi = _mm_loadu_ps(wim + k);
+            __m128 orr = _mm_loadu_ps(ore + k), oi = _mm_loadu_ps(oim + k);
+            __m128 er = _mm_loadu_ps(ere + k), ei = _mm_loadu_ps(eim + k);
+            __m128 cr = _mm_sub_ps(_mm_mul_ps(wr, orr), _mm_mul_ps(wi, oi));
+            __m128 ci = _mm_add_ps(_mm_mul_ps(wr, oi), _mm_mul_ps(wi, orr));
+            _mm_storeu_ps(ore + k, _mm_sub_ps(er, cr));
+            _mm_storeu_ps(oim + k, _mm_sub_ps(ei, ci));
+            _mm_storeu_ps(ere + k, _mm_add_ps(er, cr));
+            _mm_storeu_ps(eim + k, _mm_add_ps(ei, ci));
+        }
+    }
+}
+
+/**
+ * @brief AVX2 butterflies with fused multiply-add, 8 points at once (half has to be a multiple of 8).
+ */
+__attribute__((target("avx2,fma")))
+static void stage_avx2(float * re, float * im, const float * wre, const float * wim, size_t n, size_t half){
+    for(size_t start = 0; start < n; start += 2 * half) {
+        float * ere = re + start, * eim = im + start;
+        float * ore = ere + half, * oim = eim + half;
+        for(size_t k = 0; k < half; k += 8) {
+            __m256 wr = _mm256_loadu_ps(wre + k), wi = _mm256_loadu_ps(wim + k);
+            __m256 orr = _mm256_loadu_ps(ore + k), oi = _mm256_loadu_ps(oim + k);
+            __m256 er = _mm256_loadu_ps(ere + k), ei = _mm256_loadu_ps(eim + k);
+            __m256 cr = _mm256_fmsub_ps(wr, orr, _mm256_mul_ps(wi, oi));
+            __m256 ci = _mm256_fmadd_ps(wr, oi, _mm256_mul_ps(wi, orr));
+            _mm256_storeu_ps(ore + k, _mm256_sub_ps(er, cr));
+            _mm256_storeu_ps(oim + k, _mm256_sub_ps(ei, ci));
+            _mm256_storeu_ps(ere + k, _mm256_add_ps(er, cr));
+            _mm256_storeu_ps(eim + k, _mm256_add_ps(ei, ci));
+        }
+    }
+}
+
+/**
+ * @brief AVX-512 butterflies, 16 points at once (half has to be a multiple of 16).
+ */
+__attribute__((target("avx512f")))
+static void stage_avx512(float * re, float * im, const float * wre, const float * wim, size_t n, size_t half){
+    for(size_t start = 0; start < n; start += 2 * half) {
+        float * ere = re + start, * eim = im + start;
+        float * ore = ere + half, * oim = eim + half;
+        for(size_t k = 0; k < half; k += 16) {
+            __m512 wr = _mm512_loadu_ps(wre + k), wi = _mm512_loadu_ps(wim + k);
+            __m512 orr = _mm512_loadu_ps(ore + k), oi = _mm512_loadu_ps(oim + k);
+            __m512 er = _mm512_loadu_ps(ere + k), ei = _mm512_loadu_ps(eim + k);
+            __m512 cr = _mm512_fmsub_ps(wr, orr, _mm512_mul_ps(wi, oi));
+            __m512 ci = _mm512_fmadd_ps(wr, oi, _mm512_mul_ps(wi, orr));
+            _mm512_storeu_ps(ore + k, _mm512_sub_ps(er, cr));
+            _mm512_storeu_ps(oim + k, _mm512_sub_ps(ei, ci));
+            _mm512_storeu_ps(ere + k, _mm512_add_ps(er, cr));
+            _mm512_storeu_ps(eim + k, _mm512_add_ps(ei, ci));
+        }
+    }
+}
+#endif
+
+// ordered from the narrowest to the widest kernel
+static const fft_kernel_t kernels[] = {
+    {.name = "scalar", .width = 1, .stage = stage_scalar},
+#ifdef FFT_X86
+    {.name = "sse2", .width = 4, .stage = stage_sse2},
+    {.name = "avx2", .width = 8, .stage = stage_avx2},
+    {.name = "avx512", .width = 16, .stage = stage_avx512},
+#endif
+};
+static const size_t kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+/**
+ * @brief checks if the CPU can run kernel.
+ */
+static int is_supported(const fft_kernel_t * kernel){
+#ifdef FFT_X86
+    __builtin_cpu_init();
+    if(strcmp(kernel -> name, "sse2") == 0) {
+        return __builtin_cpu_supports("sse2");
+    }
+    if(strcmp(kernel -> name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+    if(strcmp(kernel -> name, "avx512") == 0) {
+        return __builtin_cpu_supports("avx512f");
+    }
+#endif
+    return strcmp(kernel -> name, "scalar") == 0;
+}
+
+const fft_kernel_t * fft_kernel_select(void){
+    const char * wanted = getenv("FFT_KERNEL");
+    if(wanted != NULL) {
+        for(size_t i = 0; i < kernel_count; i++) {
+            if(strcmp(kernels[i].name, wanted) == 0 && is_supported(&kernels[i])) {
+                return &kernels[i];
+            }
+        }
+    }
+
+    for(size_t i = kernel_count; i > 0; i--) {
+        if(is_supported(&kernels[i - 1])) {
+            return &kernels[i - 1];
+        }
+    }
+    return &kernels[0];
+}
+
+void fft_kernel_stage(const fft_kernel_t * kernel, float * re, float * im, const float * wre, const float * wim, size_t n, size_t half){
+    // the widths are powers of two, so a kernel fits if its width is at most half
+    while(kernel > kernels && kernel -> width > half) {
+        kernel--;
+    }
+    kernel -> stage(re, im, wre, wim, n, half);
+}
@@ -0,0 +1,51 @@
+/**
+ * @file fft_kernels.h
+ * @date 17.12.2020
+ *
+ * @brief Butterfly kernels working on split real/imaginary (structure of arrays) buffers.
+ *
+ * There is a scalar kernel and SSE2, AVX2 and AVX-512 kernels, the best one the CPU
+ * supports is chosen at runtime.
+ */
+#ifndef FFT_KERNELS_H
+#define FFT_KERNELS_H
+
+#include <stddef.h>
+
+/**
+ * @brief combines all pairs of transforms of size half in re/im into transforms of size 2*half.
+ * @param re real parts of the n points.
+ * @param im imaginary parts of the n points.
+ * @param wre real parts of the half twiddle factors of this stage.
+ * @param wim imaginary parts of the half twiddle factors of this stage.
+ * @param n total number of points.
+ * @param half size of the transforms that are combined.
+ */
+typedef void (*fft_stage_t)(float * re, float * im, const float * wre, const float * wim, size_t n, size_t half);
+
+/**
+ * @brief a butterfly kernel.
+ * @param name name of the kernel, like "avx2".
+ * @param width number of floats the kernel processes at once, stages with a smaller half
+ * are done by the next narrower kernel.
+ * @param stage the stage function.
+*/
+typedef struct FFTKernel {
+    const char * name;
+    size_t width;
+    fft_stage_t stage;
+} fft_kernel_t;
+
+/**
+ * @brief returns the fastest kernel the CPU supports.
+ * @details The environment variable FFT_KERNEL (scalar, sse2, avx2 or avx512) can be used
+ * to choose a kernel, if the CPU supports it.
+ */
+const fft_kernel_t * fft_kernel_select(void);
+
+/**
+ * @brief runs one stage with kernel, falling back to narrower kernels for small stages.
+ */
+void fft_kernel_stage(const fft_kernel_t * kernel, float * re, float * im, const float * wre, const float * wim, size_t n, size_t half);
+
+#endif
@@ -6,9 +6,20 @@
  * @brief Fast Fourrier Transformation using forks.
  * 
  * This program computes the fast fourrier transformation using forks.
+ * With -e the whole transform is computed in this process by the FFT engine instead.
+ * With -b the engine reads and writes binary complex numbers (see binary_io.h).
+ * With -r the input is real and only the bins 0 to n/2 are written, with -n length the input
+ * is a batch of signals of that length which are transformed one after another.
+ * With -w the plan tables are loaded from and saved to a wisdom file (see fft_cache.h).
+ * With -s size the input is an unbounded stream of real samples, which is transformed frame
+ * by frame (short-time Fourier transform, see stft.h).
  */
 
 #include "forkFFT.h"
+#include "fft.h"
+#include "fft_cache.h"
+#include "stft.h"
+#include "binary_io.h"
 #include <stdio.h> 
 #include <stdlib.h> 
 #include <unistd.h> 
@@ -28,7 +39,7 @@ static char * program = "<not yet encountered>";
  * @details global variables: program
  */
 void usage(char * message) {
-    fprintf(stderr, "USAGE: %s \n", program);
+    fprintf(stderr, "USAGE: %s [-e] [-b [-d]] [-r] [-n length] [-w wisdom]\n       %s [-b [-d]] -s size [-H hop] [-W rectangular|hann|hamming] [-w wisdom]\n", program, program);
     exit(EXIT_FAILURE);
 }
 
@@ -205,12 +216,325 @@ static void calculate_result(int q, int t, int n){
         write_data(buffer,stdout);
     }
 }
+/**
+ * @brief Reads all text lines from stdin.
+ * @param size number of numbers read.
+ * @return the numbers, to be freed by the caller.
+ */
+static complex_t * read_text(size_t * size){
+    char buffer[MAX_LINE_LENGTH];
+    size_t capacity = 1024;
+    complex_t * data = malloc(capacity * sizeof(complex_t));
+    if(data == NULL) {
+        error_exit("Failed to allocate memory!");
+    }
+
+    *size = 0;
+    while(read_data(buffer, stdin) != -1){
+        if(*size == capacity) {
+            capacity *= 2;
+            complex_t * bigger = realloc(data, capacity * sizeof(complex_t));
+            if(bigger == NULL) {
+                free(data);
+                error_exit("Failed to allocate memory!");
+            }
+            data = bigger;
+        }
+        string_to_imaginary(buffer, &data[(*size)++]);
+    }
+    return data;
+}
+
+/**
+ * @brief Reads binary numbers from stdin (mapped if stdin is a file).
+ * @param input the binary input, it tells how the output has to be written.
+ * @param real 1 if raw input consists of real numbers only.
+ * @param size number of numbers read.
+ * @return the numbers, to be freed by the caller.
+ */
+static complex_t * read_binary(binary_input_t * input, int precision, int real, size_t * size){
+    if(binary_input_open(STDIN_FILENO, precision, real, input) == -1) {
+        error_exit("Failed to read binary input!");
+    }
+    *size = input -> count;
+    complex_t * data = malloc((*size > 0 ? *size : 1) * sizeof(complex_t));
+    if(data == NULL) {
+        binary_input_close(input);
+        error_exit("Failed to allocate memory!");
+    }
+    for(size_t i = 0; i < *size; i++) {
+        double real, imaginary;
+        binary_input_get(input, i, &real, &imaginary);
+        data[i].real = real;
+        data[i].imaginary = imaginary;
+    }
+    binary_input_close(input);
+    return data;
+}
+
+/**
+ * @brief Reads all numbers from stdin, transforms them with the FFT engine and writes
+ * the result to stdout.
+ * @details Any number of inputs works, sizes that aren't a power of two use the mixed-radix
+ * or Bluestein path of the engine. The signals of a batch share one plan.
+ * @param binary 1 to read and write binary numbers instead of text lines.
+ * @param precision 4 or 8, size of a part of raw binary numbers.
+ * @param real 1 to transform the real parts only and write the bins 0 to length/2 of each signal.
+ * @param length length of one signal, 0 if the whole input is one signal.
+ * @param wisdom path of the wisdom file, NULL to use none.
+ */
+static void run_engine(int binary, int precision, int real, size_t length, const char * wisdom){
+    char buffer[MAX_LINE_LENGTH];
+    size_t size;
+    binary_input_t input;
+    complex_t * data = binary ? read_binary(&input, precision, real, &size) : read_text(&size);
+
+    if(size == 0) {
+        free(data);
+        error_exit("Failed to read!");
+    }
+    if(length == 0) {
+        length = size;
+    }
+    if(size % length != 0) {
+        free(data);
+        error_exit("Number of inputs has to be a multiple of the signal length!");
+    }
+    size_t count = size / length;
+
+    // a missing wisdom file is created at the end
+    if(wisdom != NULL && fft_wisdom_load(wisdom) == -1 && errno != ENOENT) {
+        free(data);
+        error_exit("Failed to load wisdom!");
+    }
+    errno = 0;
+
+    complex_t * result = data;
+    size_t result_size = size;
+    if(real) {
+        // the samples are packed into the front of data, the bins go to a new buffer
+        float * samples = (float *) data;
+        for(size_t i = 0; i < size; i++) {
+            samples[i] = data[i].real;
+        }
+        result_size = count * (length / 2 + 1);
+        result = malloc(result_size * sizeof(complex_t));
+        fft_real_plan_t * plan = fft_cache_real_plan(length);
+        if(result == NULL || plan == NULL) {
+            free(result);
+            free(data);
+            error_exit("Failed to create FFT plan!");
+        }
+        fft_execute_real_batch(plan, samples, result, count);
+        free(data);
+    } else {
+        fft_plan_t * plan = fft_cache_plan(length);
+        if(plan == NULL) {
+            free(data);
+            error_exit("Failed to create FFT plan!");
+        }
+        fft_execute_batch(plan, data, count);
+    }
+    if(wisdom != NULL && fft_wisdom_save(wisdom) == -1) {
+        free(result);
+        error_exit("Failed to save wisdom!");
+    }
+    fft_cache_clear();
+
+    // binary output has the format of the input, real input gives complex output of the same precision
+    if(binary && binary_output_header(stdout, input.precision, input.npy, result_size) == -1) {
+        free(result);
+        error_exit("Failed to write!");
+    }
+    for(size_t i = 0; i < result_size; i++){
+        int status;
+        if(binary) {
+            status = binary_output_write(stdout, input.precision, result[i].real, result[i].imaginary);
+        } else {
+            snprintf(buffer, MAX_LINE_LENGTH, "%f %f*i\n", result[i].real, result[i].imaginary);
+            status = write_data(buffer, stdout);
+        }
+        if(status == -1) {
+            free(result);
+            error_exit("Failed to write!");
+        }
+    }
+    free(result);
+}
+
+/**
+ * @brief the format of the stream of the short-time Fourier transform.
+ * @param binary 1 for raw little-endian values, 0 for text lines.
+ * @param precision 4 or 8, size of a raw input value, the output has the same precision.
+*/
+typedef struct StreamFormat {
+    int binary;
+    int precision;
+} stream_format_t;
+
+/**
+ * @brief reads up to count real samples from stdin, see stft_read_t.
+ */
+static ssize_t read_stream(void * context, float * samples, size_t count){
+    stream_format_t * format = context;
+    char buffer[MAX_LINE_LENGTH];
+    size_t done = 0;
+
+    if(format -> binary) {
+        done = binary_read_real(stdin, format -> precision, samples, count);
+    } else {
+        complex_t number;
+        while(done < count && read_data(buffer, stdin) != -1) {
+            string_to_imaginary(buffer, &number);
+            samples[done++] = number.real;
+        }
+    }
+    return ferror(stdin) ? -1 : (ssize_t) done;
+}
+
+/**
+ * @brief writes the bins of one frame to stdout, see stft_write_t.
+ */
+static int write_stream(void * context, const complex_t * bins, size_t count, int last){
+    stream_format_t * format = context;
+    char buffer[MAX_LINE_LENGTH];
+
+    for(size_t i = 0; i < count; i++) {
+        int status;
+        if(format -> binary) {
+            status = binary_output_write(stdout, format -> precision, bins[i].real, bins[i].imaginary);
+        } else {
+            snprintf(buffer, MAX_LINE_LENGTH, "%f %f*i\n", bins[i].real, bins[i].imaginary);
+            status = write_data(buffer, stdout);
+        }
+        if(status == -1) {
+            return -1;
+        }
+    }
+    // frames leave as soon as they are ready, unless more are waiting
+    if(last && fflush(stdout) == EOF) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs the short-time Fourier transform from stdin to stdout.
+ * @param binary 1 to read and write raw binary numbers instead of text lines.
+ * @param precision 4 or 8, size of a raw value.
+ * @param config size, hop and window.
+ * @param wisdom path of the wisdom file, NULL to use none.
+ */
+static void run_stft(int binary, int precision, const stft_config_t * config, const char * wisdom){
+    stream_format_t format = {.binary = binary, .precision = precision};
+
+    if(wisdom != NULL && fft_wisdom_load(wisdom) == -1 && errno != ENOENT) {
+        error_exit("Failed to load wisdom!");
+    }
+    errno = 0;
+    if(stft_run(config, read_stream, write_stream, &format) == -1) {
+        error_exit("Short-time Fourier transform failed!");
+    }
+    if(wisdom != NULL && fft_wisdom_save(wisdom) == -1) {
+        error_exit("Failed to save wisdom!");
+    }
+    fft_cache_clear();
+}
+
+/**
+ * @brief parses a positive number of an option.
+ */
+static size_t parse_size(const char * text){
+    char * endptr;
+    errno = 0;
+    size_t value = strtoul(text, &endptr, 10);
+    if(errno != 0 || *endptr != '\0' || value == 0 || text[0] == '-') {
+        usage("Invalid number!");
+    }
+    return value;
+}
+
 /**
  * Main
 */
 int main(int argc, char * argv[]){
     program = argv[0];
 
+    int opt;
+    int engine = 0;
+    int binary = 0;
+    int precision = 4;
+    int real = 0;
+    size_t length = 0;
+    char * wisdom = NULL;
+    stft_config_t stft = {.size = 0, .hop = 0, .window = STFT_HANN};
+    while((opt = getopt(argc, argv, "ebdrn:w:s:H:W:")) != -1){
+        switch(opt) {
+            case 'e':
+                engine = 1;
+                break;
+            case 'b':
+                // the process tree exchanges text lines, binary numbers go to the engine
+                binary = 1;
+                engine = 1;
+                break;
+            case 'd':
+                precision = 8;
+                break;
+            case 'r':
+                real = 1;
+                engine = 1;
+                break;
+            case 'n':
+                length = parse_size(optarg);
+                engine = 1;
+                break;
+            case 's':
+                stft.size = parse_size(optarg);
+                break;
+            case 'H':
+                stft.hop = parse_size(optarg);
+                break;
+            case 'W':
+                if(stft_window_parse(optarg, &stft.window) == -1) {
+                    usage("Invalid window!");
+                }
+                break;
+            case 'w':
+                wisdom = optarg;
+                engine = 1;
+                break;
+            default:
+                usage("Invalid option!");
+        }
+    }
+    if(optind != argc) {
+        usage("Too many arguments!");
+    }
+    if(precision == 8 && !binary) {
+        usage("-d only works with -b!");
+    }
+    if(stft.size != 0) {
+        if(real || length != 0) {
+            usage("-s doesn't work with -r or -n!");
+        }
+        if(stft.hop == 0) {
+            stft.hop = stft.size / 2 > 0 ? stft.size / 2 : 1;
+        }
+        if(stft.hop > stft.size) {
+            usage("The hop can't be larger than the size!");
+        }
+        run_stft(binary, precision, &stft, wisdom);
+        exit(EXIT_SUCCESS);
+    }
+    if(stft.hop != 0) {
+        usage("-H only works with -s!");
+    }
+    if(engine) {
+        run_engine(binary, precision, real, length, wisdom);
+        exit(EXIT_SUCCESS);
+    }
+
     int size;
     char bufferA[MAX_LINE_LENGTH];
     char bufferB[MAX_LINE_LENGTH];
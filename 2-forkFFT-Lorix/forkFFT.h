@@ -5,7 +5,11 @@
  * 
  * @brief Header file containing structs used in forkFFT.c
  */
+#ifndef FORKFFT_H
+#define FORKFFT_H
+
 #include <stdlib.h> 
+#include <sys/types.h>
 #define MAX_LINE_LENGTH (128)
 #define PI (3.141592654)
 
@@ -30,3 +34,5 @@ typedef struct Info {
     int write;
     pid_t pid;
 } info_t;
+
+#endif
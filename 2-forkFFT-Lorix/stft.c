@@ -0,0 +1,336 @@
+/**
+ * @file stft.c
+ * @date 17.12.2020
+ *
+ * @brief Streaming short-time Fourier transform.
+ *
+ * The transform thread keeps the last size samples in a history buffer. Each input slot holds
+ * hop samples, which are appended to the history; whenever it is full a frame is transformed
+ * and the history moves on by hop samples.
+ */
+
+#include "stft.h"
+#include "fft.h"
+#include "fft_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+
+// two slots: one is filled while the other one is used
+#define RING_SLOTS (2)
+
+/**
+ * @brief a ring of slots between a producer and a consumer thread.
+ * @param slots the memory of the slots.
+ * @param slot_size size of a slot in bytes.
+ * @param counts number of elements in each filled slot.
+ * @param head number of slots taken by the consumer so far.
+ * @param tail number of slots filled by the producer so far.
+ * @param closed set by the producer after the last slot.
+ * @param failed set by the consumer if it stopped, the producer gives up then.
+ * @param lock protects the counters and flags.
+ * @param changed signaled whenever a counter or flag changes.
+*/
+typedef struct StftRing {
+    unsigned char * slots;
+    size_t slot_size;
+    size_t counts[RING_SLOTS];
+    size_t head;
+    size_t tail;
+    int closed;
+    int failed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} stft_ring_t;
+
+/**
+ * @brief everything the three threads share.
+*/
+typedef struct StftPipeline {
+    const stft_config_t * config;
+    stft_read_t read;
+    stft_write_t write;
+    void * context;
+    stft_ring_t input;
+    stft_ring_t output;
+    int read_error;
+    int write_error;
+} stft_pipeline_t;
+
+int stft_window_parse(const char * name, stft_window_t * window){
+    if(strcmp(name, "rectangular") == 0) {
+        *window = STFT_RECTANGULAR;
+    } else if(strcmp(name, "hann") == 0) {
+        *window = STFT_HANN;
+    } else if(strcmp(name, "hamming") == 0) {
+        *window = STFT_HAMMING;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief allocates the slots of ring.
+ * @return 0 on success, -1 if memory ran out.
+ */
+static int ring_init(stft_ring_t * ring, size_t slot_size){
+    memset(ring, 0, sizeof(stft_ring_t));
+    ring -> slot_size = slot_size;
+    ring -> slots = malloc(RING_SLOTS * slot_size);
+    if(ring -> slots == NULL) {
+        return -1;
+    }
+    pthread_mutex_init(&ring -> lock, NULL);
+    pthread_cond_init(&ring -> changed, NULL);
+    return 0;
+}
+
+static void ring_destroy(stft_ring_t * ring){
+    pthread_mutex_destroy(&ring -> lock);
+    pthread_cond_destroy(&ring -> changed);
+    free(ring -> slots);
+}
+
+/**
+ * @brief waits for a free slot.
+ * @return the slot or NULL if the consumer failed.
+ */
+static void * ring_acquire_free(stft_ring_t * ring){
+    pthread_mutex_lock(&ring -> lock);
+    while(ring -> tail - ring -> head == RING_SLOTS && !ring -> failed) {
+        pthread_cond_wait(&ring -> changed, &ring -> lock);
+    }
+    void * slot = ring -> failed ? NULL : ring -> slots + (ring -> tail % RING_SLOTS) * ring -> slot_size;
+    pthread_mutex_unlock(&ring -> lock);
+    return slot;
+}
+
+/**
+ * @brief hands the slot returned by ring_acquire_free with count elements to the consumer.
+ */
+static void ring_push(stft_ring_t * ring, size_t count){
+    pthread_mutex_lock(&ring -> lock);
+    ring -> counts[ring -> tail % RING_SLOTS] = count;
+    ring -> tail++;
+    pthread_cond_signal(&ring -> changed);
+    pthread_mutex_unlock(&ring -> lock);
+}
+
+/**
+ * @brief waits for a filled slot.
+ * @param count number of elements in the slot.
+ * @param pending number of filled slots after this one.
+ * @return the slot or NULL if the producer closed the ring and all slots were taken.
+ */
+static const void * ring_acquire_filled(stft_ring_t * ring, size_t * count, size_t * pending){
+    pthread_mutex_lock(&ring -> lock);
+    while(ring -> tail == ring -> head && !ring -> closed) {
+        pthread_cond_wait(&ring -> changed, &ring -> lock);
+    }
+    const void * slot = NULL;
+    if(ring -> tail != ring -> head) {
+        slot = ring -> slots + (ring -> head % RING_SLOTS) * ring -> slot_size;
+        *count = ring -> counts[ring -> head % RING_SLOTS];
+        *pending = ring -> tail - ring -> head - 1;
+    }
+    pthread_mutex_unlock(&ring -> lock);
+    return slot;
+}
+
+/**
+ * @brief gives the slot returned by ring_acquire_filled back to the producer.
+ */
+static void ring_pop(stft_ring_t * ring){
+    pthread_mutex_lock(&ring -> lock);
+    ring -> head++;
+    pthread_cond_signal(&ring -> changed);
+    pthread_mutex_unlock(&ring -> lock);
+}
+
+/**
+ * @brief sets a flag of ring and wakes up the other side.
+ */
+static void ring_set(stft_ring_t * ring, int * flag){
+    pthread_mutex_lock(&ring -> lock);
+    *flag = 1;
+    pthread_cond_broadcast(&ring -> changed);
+    pthread_mutex_unlock(&ring -> lock);
+}
+
+/**
+ * @brief the reader thread, fills the input ring with blocks of hop samples.
+ */
+static void * reader(void * arg){
+    stft_pipeline_t * pipeline = arg;
+    size_t hop = pipeline -> config -> hop;
+    int state;
+
+    // only the read may be cancelled, never while the ring is locked
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    while(1) {
+        float * samples = ring_acquire_free(&pipeline -> input);
+        if(samples == NULL) {
+            break;
+        }
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &state);
+        ssize_t count = pipeline -> read(pipeline -> context, samples, hop);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+        if(count == -1) {
+            pipeline -> read_error = errno != 0 ? errno : EIO;
+            break;
+        }
+        if(count > 0) {
+            ring_push(&pipeline -> input, count);
+        }
+        if((size_t) count < hop) {
+            break;
+        }
+    }
+    ring_set(&pipeline -> input, &pipeline -> input.closed);
+    return NULL;
+}
+
+/**
+ * @brief the writer thread, writes the frames of the output ring.
+ */
+static void * writer(void * arg){
+    stft_pipeline_t * pipeline = arg;
+    size_t count, pending;
+    const complex_t * bins;
+
+    while((bins = ring_acquire_filled(&pipeline -> output, &count, &pending)) != NULL) {
+        if(pipeline -> write(pipeline -> context, bins, count, pending == 0) == -1) {
+            pipeline -> write_error = errno != 0 ? errno : EIO;
+            ring_set(&pipeline -> output, &pipeline -> output.failed);
+            break;
+        }
+        ring_pop(&pipeline -> output);
+    }
+    return NULL;
+}
+
+/**
+ * @brief computes the window function for size samples (periodic, as usual for spectra).
+ */
+static void create_window(float * window, size_t size, stft_window_t type){
+    for(size_t i = 0; i < size; i++) {
+        double phase = 2.0 * M_PI * (double) i / (double) size;
+        switch(type) {
+            case STFT_HANN:
+                window[i] = 0.5 - 0.5 * cos(phase);
+                break;
+            case STFT_HAMMING:
+                window[i] = 0.54 - 0.46 * cos(phase);
+                break;
+            default:
+                window[i] = 1;
+        }
+    }
+}
+
+/**
+ * @brief the transform loop, runs until the input ends or the writer failed.
+ */
+static void transform(stft_pipeline_t * pipeline, const fft_real_plan_t * plan, float * history,
+    float * frame, const float * window){
+    size_t size = pipeline -> config -> size;
+    size_t hop = pipeline -> config -> hop;
+    size_t filled = 0;
+    size_t count, pending;
+    const float * samples;
+
+    while((samples = ring_acquire_filled(&pipeline -> input, &count, &pending)) != NULL) {
+        size_t used = 0;
+        // unless hop divides size a block can end in the middle of a frame
+        while(used < count) {
+            size_t take = count - used < size - filled ? count - used : size - filled;
+            memcpy(history + filled, samples + used, take * sizeof(float));
+            filled += take;
+            used += take;
+            if(filled < size) {
+                break;
+            }
+
+            for(size_t i = 0; i < size; i++) {
+                frame[i] = history[i] * window[i];
+            }
+            complex_t * bins = ring_acquire_free(&pipeline -> output);
+            if(bins == NULL) {
+                ring_pop(&pipeline -> input);
+                return;
+            }
+            fft_execute_real(plan, frame, bins);
+            ring_push(&pipeline -> output, size / 2 + 1);
+
+            memmove(history, history + hop, (size - hop) * sizeof(float));
+            filled = size - hop;
+        }
+        ring_pop(&pipeline -> input);
+    }
+}
+
+int stft_run(const stft_config_t * config, stft_read_t read, stft_write_t write, void * context){
+    if(config -> size == 0 || config -> hop == 0 || config -> hop > config -> size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    stft_pipeline_t pipeline = {.config = config, .read = read, .write = write, .context = context};
+    size_t size = config -> size;
+    fft_real_plan_t * plan = fft_cache_real_plan(size);
+    float * history = malloc(3 * size * sizeof(float));
+    if(plan == NULL || history == NULL) {
+        free(history);
+        errno = ENOMEM;
+        return -1;
+    }
+    float * frame = history + size;
+    float * window = history + 2 * size;
+    create_window(window, size, config -> window);
+
+    if(ring_init(&pipeline.input, config -> hop * sizeof(float)) == -1) {
+        free(history);
+        errno = ENOMEM;
+        return -1;
+    }
+    if(ring_init(&pipeline.output, (size / 2 + 1) * sizeof(complex_t)) == -1) {
+        ring_destroy(&pipeline.input);
+        free(history);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    pthread_t reader_thread, writer_thread;
+    int result = pthread_create(&reader_thread, NULL, reader, &pipeline);
+    if(result == 0) {
+        result = pthread_create(&writer_thread, NULL, writer, &pipeline);
+        if(result == 0) {
+            transform(&pipeline, plan, history, frame, window);
+            ring_set(&pipeline.output, &pipeline.output.closed);
+            pthread_join(writer_thread, NULL);
+        }
+        // after a failed write the reader may still wait for input that never comes
+        ring_set(&pipeline.input, &pipeline.input.failed);
+        if(result != 0 || pipeline.write_error != 0) {
+            pthread_cancel(reader_thread);
+        }
+        pthread_join(reader_thread, NULL);
+    }
+
+    ring_destroy(&pipeline.input);
+    ring_destroy(&pipeline.output);
+    free(history);
+
+    if(result != 0) {
+        errno = result;
+        return -1;
+    }
+    if(pipeline.read_error != 0 || pipeline.write_error != 0) {
+        errno = pipeline.read_error != 0 ? pipeline.read_error : pipeline.write_error;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file stft.h
+ * @date 17.12.2020
+ *
+ * @brief Streaming short-time Fourier transform.
+ *
+ * The input is an unbounded stream of real samples. Every hop samples a frame of the last size
+ * samples is multiplied with the window and transformed with a real plan of the engine, so
+ * consecutive frames overlap by size - hop samples. Only complete frames are transformed.
+ *
+ * Reading, transforming and writing run on three threads, connected by two rings of two slots
+ * each (double buffering): the reader fills one slot while the transform works on the other,
+ * and the same between the transform and the writer.
+ */
+#ifndef STFT_H
+#define STFT_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "forkFFT.h"
+
+/**
+ * @brief the window functions.
+*/
+typedef enum StftWindow {
+    STFT_RECTANGULAR,
+    STFT_HANN,
+    STFT_HAMMING
+} stft_window_t;
+
+/**
+ * @brief reads up to count samples.
+ * @param context the context given to stft_run.
+ * @return the number of samples read, less than count only at the end of the input, -1 on error.
+ */
+typedef ssize_t (*stft_read_t)(void * context, float * samples, size_t count);
+
+/**
+ * @brief writes the bins of one frame.
+ * @param context the context given to stft_run.
+ * @param bins the bins 0 to size/2 of the frame.
+ * @param count size/2+1.
+ * @param last 1 if no other frame is ready to be written right now, so buffered output should be flushed.
+ * @return 0 on success, -1 on error.
+ */
+typedef int (*stft_write_t)(void * context, const complex_t * bins, size_t count, int last);
+
+/**
+ * @brief the parameters of the transform.
+ * @param size number of samples of a frame.
+ * @param hop number of samples between the starts of two frames, 1 to size.
+ * @param window the window function.
+*/
+typedef struct StftConfig {
+    size_t size;
+    size_t hop;
+    stft_window_t window;
+} stft_config_t;
+
+/**
+ * @brief parses the name of a window function (rectangular, hann or hamming).
+ * @return 0 on success, -1 if the name is unknown.
+ */
+int stft_window_parse(const char * name, stft_window_t * window);
+
+/**
+ * @brief transforms the stream until the input ends.
+ * @details read is called on a reader thread and write on a writer thread, the frames are
+ * transformed on the calling thread.
+ * @return 0 on success, -1 if reading or writing failed or the setup failed (errno is set).
+ */
+int stft_run(const stft_config_t * config, stft_read_t read, stft_write_t write, void * context);
+
+#endif
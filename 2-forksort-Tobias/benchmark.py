@@ -0,0 +1,78 @@
+import argparse
+import os
+import random
+import subprocess
+import tempfile
+import time
+
+
+# Compare the merge sort (./forksort -a merge) with the multikey quicksort
+# (./forksort -a radix) of the engine on log-style lines: every line starts with
+# a timestamp, a host and a service, so neighbouring lines share long prefixes
+# and a comparison of whole lines touches many bytes before they differ.
+def main():
+    parser = argparse.ArgumentParser(
+        description="Benchmark ./forksort -a merge against ./forksort -a radix"
+    )
+    parser.add_argument("--min", type=int, default=14, help="smallest 2^k lines")
+    parser.add_argument("--max", type=int, default=22, help="largest 2^k lines")
+    parser.add_argument(
+        "--threads",
+        type=int,
+        default=0,
+        help="worker threads (default: one per online CPU)",
+    )
+    parser.add_argument("--seed", type=int, default=1, help="random seed")
+    args = parser.parse_args()
+    random.seed(args.seed)
+
+    threads = ["-j", str(args.threads)] if args.threads > 0 else []
+    print(f"{'lines':>10} {'MiB':>7} {'merge [s]':>10} {'radix [s]':>10} {'speedup':>8}")
+    for k in range(args.min, args.max + 1):
+        n = 1 << k
+        with tempfile.NamedTemporaryFile("wb", suffix=".log") as f:
+            f.write(log_input(n))
+            f.flush()
+            size = os.path.getsize(f.name) / (1 << 20)
+
+            merge_time, merge_out = run(["./forksort", "-a", "merge"] + threads, f.name)
+            radix_time, radix_out = run(["./forksort", "-a", "radix"] + threads, f.name)
+            if merge_out != radix_out:
+                raise RuntimeError(f"outputs differ for {n} lines")
+
+        print(f"{n:>10} {size:7.1f} {merge_time:10.3f} {radix_time:10.3f} {merge_time / radix_time:8.2f}")
+
+
+# Return n log lines like
+# "2020-12-20T13:45:07.123Z host-03 api-gateway INFO GET /api/v1/items/4711 200 12ms"
+# in random order
+def log_input(n: int) -> bytes:
+    hosts = [f"host-{i:02d}" for i in range(8)]
+    services = ["api-gateway", "auth-service", "billing-service", "search-service"]
+    levels = ["INFO", "INFO", "INFO", "WARN", "ERROR"]
+    paths = ["/api/v1/items", "/api/v1/users", "/api/v1/orders"]
+    lines = []
+    for _ in range(n):
+        seconds = random.randrange(3600)
+        lines.append(
+            f"2020-12-20T13:{seconds // 60:02d}:{seconds % 60:02d}.{random.randrange(1000):03d}Z "
+            f"{random.choice(hosts)} {random.choice(services)} {random.choice(levels)} "
+            f"GET {random.choice(paths)}/{random.randrange(100000)} 200 {random.randrange(500)}ms"
+        )
+    return "\n".join(lines).encode() + b"\n"
+
+
+# Run the command with the file as stdin and return the wall time and output
+def run(command, path: str):
+    with open(path, "rb") as stdin:
+        start = time.perf_counter()
+        cp = subprocess.run(command, stdin=stdin, stdout=subprocess.PIPE)
+        elapsed = time.perf_counter() - start
+    if cp.returncode != 0:
+        raise RuntimeError(f"{' '.join(command)} exited with {cp.returncode}")
+    return elapsed, cp.stdout
+
+
+if __name__ == "__main__":
+    os.chdir(os.path.dirname(os.path.abspath(__file__)))
+    main()
@@ -0,0 +1,439 @@
+/**
+ * @file   engine.c
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The in-memory sort engine of forksort (-e).
+ **/
+
+#include "engine.h"
+#include "radix.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/** Ranges of at most this many lines are sorted with insertion sort. */
+#define INSERTION_SORT_MAX 16
+
+/** Merges with fewer lines per worker are not split further. */
+#define MIN_MERGE_PART 4096
+
+/** The number of bytes of the line number behind every key. */
+#define KEY_INDEX_SIZE 8
+
+//region TYPES
+/** Sorts lines[0, count) using tmp (same size) as scratch space. */
+typedef struct {
+    line_t *lines;
+    line_t *tmp;
+    size_t count;
+    const char *data;
+} sortTask_t;
+
+/** Merges the outputs [outBegin, outEnd) of the sorted runs a and b into out. */
+typedef struct {
+    const line_t *a;
+    size_t aCount;
+    const line_t *b;
+    size_t bCount;
+    size_t outBegin;
+    size_t outEnd;
+    line_t *out;
+    const char *data;
+} mergeTask_t;
+//endregion
+
+//region ARENA
+/**
+ * @brief Reads everything from fd into a growing buffer.
+ *
+ * @return 0 upon success, -1 upon failure.
+ */
+static int readAll(int fd, arena_t *arena)
+{
+    size_t capacity = 1 << 16;
+    size_t size = 0;
+    char *data = malloc(capacity);
+    if (data == NULL)
+        return -1;
+
+    while (1)
+    {
+        if (size == capacity)
+        {
+            capacity *= 2;
+            char *bigger = realloc(data, capacity);
+            if (bigger == NULL)
+            {
+                free(data);
+                return -1;
+            }
+            data = bigger;
+        }
+
+        ssize_t n = read(fd, data + size, capacity - size);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            free(data);
+            return -1;
+        }
+        if (n == 0)
+            break;
+        size += n;
+    }
+
+    arena->data = data;
+    arena->size = size;
+    arena->mapped = 0;
+    return 0;
+}
+
+int arenaLoad(int fd, arena_t *arena)
+{
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            arena->data = map;
+            arena->size = info.st_size;
+            arena->mapped = 1;
+            return 0;
+        }
+    }
+
+    return readAll(fd, arena);
+}
+
+void arenaFree(arena_t *arena)
+{
+    if (arena->mapped)
+        munmap(arena->data, arena->size);
+    else
+        free(arena->data);
+    arena->data = NULL;
+}
+
+line_t *indexLines(const arena_t *arena, size_t *count_out)
+{
+    size_t count = 1;
+    const char *end = arena->data + arena->size;
+    for (const char *p = arena->data; (p = memchr(p, '\n', end - p)) != NULL; p++)
+        count++;
+
+    line_t *lines = malloc(count * sizeof(line_t));
+    if (lines == NULL)
+        return NULL;
+
+    size_t start = 0;
+    for (size_t i = 0; i < count - 1; i++)
+    {
+        const char *newline = memchr(arena->data + start, '\n', arena->size - start);
+        lines[i].offset = start;
+        lines[i].length = newline - (arena->data + start);
+        start += lines[i].length + 1;
+    }
+    lines[count - 1].offset = start;
+    lines[count - 1].length = arena->size - start;
+
+    *count_out = count;
+    return lines;
+}
+//endregion
+
+//region SORTING
+/** Compares two lines of data, see compareRecords. */
+static inline int compareLines(const char *data, const line_t *a, const line_t *b)
+{
+    return compareRecords(data + a->offset, a->length, data + b->offset, b->length);
+}
+
+/**
+ * @brief Merges the sorted runs a and b into out, on ties lines of a come first (stable).
+ */
+static void merge(const line_t *a, size_t aCount, const line_t *b, size_t bCount, line_t *out, const char *data)
+{
+    size_t i = 0, j = 0, k = 0;
+    while (i < aCount && j < bCount)
+    {
+        if (compareLines(data, &b[j], &a[i]) < 0)
+            out[k++] = b[j++];
+        else
+            out[k++] = a[i++];
+    }
+
+    memcpy(out + k, a + i, (aCount - i) * sizeof(line_t));
+    k += aCount - i;
+    memcpy(out + k, b + j, (bCount - j) * sizeof(line_t));
+}
+
+/**
+ * @brief Sorts lines[0, count) with a stable top-down merge sort.
+ *
+ * @param tmp Scratch space of count lines.
+ */
+static void mergeSort(line_t *lines, line_t *tmp, size_t count, const char *data)
+{
+    if (count <= INSERTION_SORT_MAX)
+    {
+        for (size_t i = 1; i < count; i++)
+        {
+            line_t current = lines[i];
+            size_t j = i;
+            for (; j > 0 && compareLines(data, &current, &lines[j - 1]) < 0; j--)
+                lines[j] = lines[j - 1];
+            lines[j] = current;
+        }
+        return;
+    }
+
+    size_t half = count / 2;
+    mergeSort(lines, tmp, half, data);
+    mergeSort(lines + half, tmp + half, count - half, data);
+
+    // already in order, e.g. for presorted input
+    if (compareLines(data, &lines[half - 1], &lines[half]) <= 0)
+        return;
+
+    memcpy(tmp, lines, count * sizeof(line_t));
+    merge(tmp, half, tmp + half, count - half, lines, data);
+}
+
+/**
+ * @brief Returns how many lines of a are among the first k lines of the stable merge of a and b.
+ * @details Binary search for the smallest i where a[i] (if any) doesn't belong before b[k - i - 1].
+ */
+static size_t coRank(size_t k, const line_t *a, size_t aCount, const line_t *b, size_t bCount, const char *data)
+{
+    size_t low = k > bCount ? k - bCount : 0;
+    size_t high = k < aCount ? k : aCount;
+
+    while (low < high)
+    {
+        size_t i = low + (high - low) / 2;
+        size_t j = k - i;
+        if (j > 0 && compareLines(data, &a[i], &b[j - 1]) <= 0)
+            low = i + 1;
+        else
+            high = i;
+    }
+
+    return low;
+}
+
+/** Task: sorts one chunk, see sortTask_t. */
+static void runSortTask(void *arg)
+{
+    sortTask_t *task = arg;
+    mergeSort(task->lines, task->tmp, task->count, task->data);
+}
+
+/** Task: merges one part of two runs, see mergeTask_t. */
+static void runMergeTask(void *arg)
+{
+    mergeTask_t *task = arg;
+    size_t i = coRank(task->outBegin, task->a, task->aCount, task->b, task->bCount, task->data);
+    size_t iEnd = coRank(task->outEnd, task->a, task->aCount, task->b, task->bCount, task->data);
+    size_t j = task->outBegin - i;
+    size_t jEnd = task->outEnd - iEnd;
+
+    merge(task->a + i, iEnd - i, task->b + j, jEnd - j, task->out + task->outBegin, task->data);
+}
+
+int parallelMergeSort(line_t *lines, size_t count, const char *data, threadPool_t *pool)
+{
+    size_t threads = threadPoolSize(pool);
+    size_t runs = threads < count ? threads : (count > 0 ? count : 1);
+
+    line_t *tmp = malloc((count > 0 ? count : 1) * sizeof(line_t));
+    size_t *bounds = malloc((runs + 1) * sizeof(size_t));
+    // a round has at most one merge part per worker and pair of runs
+    sortTask_t *sortTasks = malloc(runs * sizeof(sortTask_t));
+    mergeTask_t *mergeTasks = malloc((runs + threads) * sizeof(mergeTask_t));
+    if (tmp == NULL || bounds == NULL || sortTasks == NULL || mergeTasks == NULL)
+    {
+        free(tmp);
+        free(bounds);
+        free(sortTasks);
+        free(mergeTasks);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    int result = 0;
+    for (size_t r = 0; r <= runs; r++)
+        bounds[r] = count / runs * r + (r < count % runs ? r : count % runs);
+
+    for (size_t r = 0; r < runs && result == 0; r++)
+    {
+        sortTasks[r] = (sortTask_t) {lines + bounds[r], tmp + bounds[r], bounds[r + 1] - bounds[r], data};
+        result = threadPoolSubmit(pool, runSortTask, &sortTasks[r]);
+    }
+    threadPoolWait(pool);
+
+    line_t *src = lines;
+    line_t *dst = tmp;
+    while (runs > 1 && result == 0)
+    {
+        size_t pairs = runs / 2;
+        size_t tasks = 0;
+
+        for (size_t p = 0; p < pairs; p++)
+        {
+            const line_t *a = src + bounds[2 * p];
+            size_t aCount = bounds[2 * p + 1] - bounds[2 * p];
+            const line_t *b = src + bounds[2 * p + 1];
+            size_t bCount = bounds[2 * p + 2] - bounds[2 * p + 1];
+            size_t total = aCount + bCount;
+
+            // few pairs left: split every merge so all workers have something to do
+            size_t parts = (threads + pairs - 1) / pairs;
+            if (parts > total / MIN_MERGE_PART)
+                parts = total / MIN_MERGE_PART > 0 ? total / MIN_MERGE_PART : 1;
+
+            for (size_t part = 0; part < parts && result == 0; part++)
+            {
+                mergeTasks[tasks] = (mergeTask_t) {a, aCount, b, bCount, total * part / parts,
+                                                   total * (part + 1) / parts, dst + bounds[2 * p], data};
+                result = threadPoolSubmit(pool, runMergeTask, &mergeTasks[tasks++]);
+            }
+        }
+
+        // an odd run is carried over to the next round
+        if (runs % 2 == 1)
+            memcpy(dst + bounds[runs - 1], src + bounds[runs - 1], (bounds[runs] - bounds[runs - 1]) * sizeof(line_t));
+
+        threadPoolWait(pool);
+
+        for (size_t r = 0; 2 * r < runs; r++)
+            bounds[r + 1] = bounds[2 * r + 2 < runs ? 2 * r + 2 : runs];
+        runs = (runs + 1) / 2;
+
+        line_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != lines)
+        memcpy(lines, src, count * sizeof(line_t));
+
+    free(tmp);
+    free(bounds);
+    free(sortTasks);
+    free(mergeTasks);
+    return result;
+}
+
+int sortLines(line_t *lines, size_t count, const char *data, sortAlgorithm_e algorithm, threadPool_t *pool)
+{
+    if (algorithm == SORT_RADIX)
+        return parallelRadixSort(lines, count, data, pool);
+
+    return parallelMergeSort(lines, count, data, pool);
+}
+
+int sortKeyed(line_t *lines, size_t *count_in_out, const char *data, const keySpec_t *spec,
+              sortAlgorithm_e algorithm, threadPool_t *pool)
+{
+    size_t count = *count_in_out;
+    size_t capacity = 1 << 16;
+    size_t used = 0;
+    char *keys = malloc(capacity);
+    line_t *keyLines = malloc((count > 0 ? count : 1) * sizeof(line_t));
+    if (keys == NULL || keyLines == NULL)
+    {
+        free(keys);
+        free(keyLines);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t needed = keyBound(spec, lines[i].length) + KEY_INDEX_SIZE;
+        if (used + needed > capacity)
+        {
+            while (used + needed > capacity)
+                capacity *= 2;
+            char *bigger = realloc(keys, capacity);
+            if (bigger == NULL)
+            {
+                free(keys);
+                free(keyLines);
+                errno = ENOMEM;
+                return -1;
+            }
+            keys = bigger;
+        }
+
+        size_t length = buildKey(spec, data + lines[i].offset, lines[i].length, keys + used);
+        // the line number (big-endian) makes the keys unique: equal keys keep the order of the input
+        for (int b = 0; b < KEY_INDEX_SIZE; b++)
+            keys[used + length + b] = (char) ((uint64_t) i >> (8 * (KEY_INDEX_SIZE - 1 - b)));
+
+        keyLines[i] = (line_t) {used, length + KEY_INDEX_SIZE};
+        used += length + KEY_INDEX_SIZE;
+    }
+
+    if (sortLines(keyLines, count, keys, algorithm, pool) == -1)
+    {
+        free(keys);
+        free(keyLines);
+        return -1;
+    }
+
+    // the key index is overwritten with the lines in sorted order
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const line_t *key = &keyLines[i];
+        if (spec->unique && kept > 0 &&
+            compareRecords(keys + key->offset, key->length - KEY_INDEX_SIZE,
+                           keys + keyLines[kept - 1].offset, keyLines[kept - 1].length - KEY_INDEX_SIZE) == 0)
+            continue;
+        keyLines[kept++] = *key;
+    }
+
+    for (size_t i = 0; i < kept; i++)
+    {
+        const unsigned char *index = (const unsigned char *) keys + keyLines[i].offset + keyLines[i].length
+                                     - KEY_INDEX_SIZE;
+        uint64_t line = 0;
+        for (int b = 0; b < KEY_INDEX_SIZE; b++)
+            line = line << 8 | index[b];
+        keyLines[i] = lines[line];
+    }
+    memcpy(lines, keyLines, kept * sizeof(line_t));
+
+    *count_in_out = kept;
+    free(keys);
+    free(keyLines);
+    return 0;
+}
+//endregion
+
+//region OUTPUT
+int writeLines(FILE *out, const char *data, const line_t *lines, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (fwrite(data + lines[i].offset, 1, lines[i].length, out) != lines[i].length)
+            return -1;
+
+        if (count == 1)
+            break;
+        if (putc(i + 1 < count ? '\n' : '\0', out) == EOF)
+            return -1;
+    }
+
+    return fflush(out);
+}
+//endregion
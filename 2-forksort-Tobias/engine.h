@@ -0,0 +1,124 @@
+/**
+ * @file   engine.h
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The in-memory sort engine of forksort (-e).
+ *
+ * @details Instead of a process tree the whole input is loaded into one contiguous arena (mapped if
+ * stdin is a regular file) and an index of (offset, length) pairs is built for its lines. Only the
+ * index is sorted, with a parallel merge sort on a thread pool: every worker sorts one chunk, then the
+ * chunks are merged pairwise, each merge split into independent parts so all workers stay busy.
+ * The lines are written with one buffered stream.
+ *
+ * The lines are ordered byte by byte like strcmp, a line comes before every longer line it is a
+ * prefix of. The sort is stable.
+ **/
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "keys.h"
+#include "threadpool.h"
+
+/**
+ * The whole input.
+ * data is the first byte, size the number of bytes.
+ * mapped is 1 if data is a mapping of the input file, 0 if it was read into allocated memory.
+ */
+typedef struct {
+    char *data;
+    size_t size;
+    int mapped;
+} arena_t;
+
+/** The algorithms sorting the index: the merge sort of this file or the multikey quicksort of radix.h. */
+typedef enum {
+    SORT_MERGE,
+    SORT_RADIX
+} sortAlgorithm_e;
+
+/** A line of the arena: the offset of its first byte and its length without the newline. */
+typedef struct {
+    size_t offset;
+    size_t length;
+} line_t;
+
+/**
+ * @brief Compares two lines byte by byte, a prefix comes before the longer line.
+ *
+ * @return A negative value, 0 or a positive value like strcmp.
+ */
+static inline int compareRecords(const char *a, size_t aLength, const char *b, size_t bLength)
+{
+    int result = memcmp(a, b, aLength < bLength ? aLength : bLength);
+    if (result != 0)
+        return result;
+
+    return (aLength > bLength) - (aLength < bLength);
+}
+
+/**
+ * @brief Loads everything readable from fd into an arena, regular files are mapped instead of read.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int arenaLoad(int fd, arena_t *arena);
+
+/**
+ * @brief Releases the memory of the arena.
+ */
+void arenaFree(arena_t *arena);
+
+/**
+ * @brief Builds the index of the lines of the arena.
+ * @details The input is split at every newline, like the process tree does it the part after the last
+ * newline is a line too (it is empty if the input ends with a newline).
+ *
+ * @param count_out Will contain the number of lines.
+ *
+ * @return The index (to be freed by the caller) or NULL if no memory was left.
+ */
+line_t *indexLines(const arena_t *arena, size_t *count_out);
+
+/**
+ * @brief Sorts the index of the lines of data with a parallel merge sort on the workers of the pool.
+ *
+ * @return 0 upon success, -1 if no memory was left.
+ */
+int parallelMergeSort(line_t *lines, size_t count, const char *data, threadPool_t *pool);
+
+/**
+ * @brief Sorts the index of the lines of data with the given algorithm on the workers of the pool.
+ *
+ * @return 0 upon success, -1 if no memory was left.
+ */
+int sortLines(line_t *lines, size_t count, const char *data, sortAlgorithm_e algorithm, threadPool_t *pool);
+
+/**
+ * @brief Sorts the index of the lines of data by their keys (see keys.h) with the given algorithm.
+ * @details The key of every line is computed once and followed by the number of the line, so keys are unique
+ * and lines with equal keys keep their order with either algorithm. With unique only the first of the lines
+ * with equal keys is kept.
+ *
+ * @param count_in_out The number of lines, will contain the number of lines kept.
+ *
+ * @return 0 upon success, -1 if no memory was left.
+ */
+int sortKeyed(line_t *lines, size_t *count_in_out, const char *data, const keySpec_t *spec,
+              sortAlgorithm_e algorithm, threadPool_t *pool);
+
+/**
+ * @brief Writes the lines in the format of the process tree.
+ * @details The lines are separated by newlines and the last one is followed by a \0 byte, except if there
+ * is only one line, which is written as it is.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int writeLines(FILE *out, const char *data, const line_t *lines, size_t count);
+
+#endif
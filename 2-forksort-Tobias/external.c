@@ -0,0 +1,610 @@
+/**
+ * @file   external.c
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The external sort of forksort (-m), for inputs that don't fit into memory.
+ **/
+
+#include "external.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/** Merge passes are added if a run would be read through a smaller buffer than this. */
+#define MIN_READ_BUFFER ((size_t) 1 << 20)
+
+/** At most this many runs are merged at once (every run is an open file). */
+#define MAX_FAN_IN 256
+
+//region TYPES
+/** A spilled run: an unlinked temporary file with one line per newline. */
+typedef struct {
+    int fd;
+} run_t;
+
+/** The runs spilled so far. */
+typedef struct {
+    run_t *runs;
+    size_t count;
+    size_t capacity;
+} runList_t;
+
+/** Buffered sequential writing to a file descriptor. */
+typedef struct {
+    int fd;
+    char *buffer;
+    size_t capacity;
+    size_t used;
+} writer_t;
+
+/**
+ * Buffered sequential reading of the lines of a run.
+ * record and length are the current line, key and keyLength its sort key (the line itself if spec is NULL),
+ * both valid until the next call to readerAdvance. exhausted is 1 once all lines were read.
+ */
+typedef struct {
+    int fd;
+    char *buffer;
+    size_t capacity;
+    size_t start;
+    size_t end;
+    int eof;
+    int exhausted;
+    const char *record;
+    size_t length;
+    const keySpec_t *spec;
+    char *keyBuffer;
+    size_t keyCapacity;
+    const char *key;
+    size_t keyLength;
+} reader_t;
+//endregion
+
+//region FILES
+/**
+ * @brief Creates an unlinked temporary file in $TMPDIR (default /tmp).
+ *
+ * @return The file descriptor or -1 upon failure.
+ */
+static int createTemporaryFile(void)
+{
+    const char *directory = getenv("TMPDIR");
+    if (directory == NULL || *directory == '\0')
+        directory = "/tmp";
+
+    size_t length = strlen(directory) + sizeof("/forksort-XXXXXX");
+    char *path = malloc(length);
+    if (path == NULL)
+        return -1;
+    snprintf(path, length, "%s/forksort-XXXXXX", directory);
+
+    int fd = mkstemp(path);
+    if (fd != -1)
+        unlink(path);
+
+    free(path);
+    return fd;
+}
+
+/**
+ * @brief Writes all bytes to fd.
+ *
+ * @return 0 upon success, -1 upon failure.
+ */
+static int writeAll(int fd, const char *bytes, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = write(fd, bytes, size);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        bytes += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Reads into bytes until size bytes were read or the end of the file was reached.
+ *
+ * @return The number of bytes read or -1 upon failure.
+ */
+static ssize_t readFull(int fd, char *bytes, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = read(fd, bytes + done, size - done);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0)
+            break;
+        done += n;
+    }
+
+    return done;
+}
+
+static int runListAdd(runList_t *list, int fd)
+{
+    if (list->count == list->capacity)
+    {
+        size_t capacity = list->capacity == 0 ? 16 : 2 * list->capacity;
+        run_t *runs = realloc(list->runs, capacity * sizeof(run_t));
+        if (runs == NULL)
+            return -1;
+        list->runs = runs;
+        list->capacity = capacity;
+    }
+
+    list->runs[list->count++] = (run_t) {fd};
+    return 0;
+}
+//endregion
+
+//region WRITER
+static int writerFlush(writer_t *writer)
+{
+    int result = writeAll(writer->fd, writer->buffer, writer->used);
+    writer->used = 0;
+    return result;
+}
+
+/**
+ * @brief Writes a line and its newline through the buffer of the writer.
+ *
+ * @return 0 upon success, -1 upon failure.
+ */
+static int writerLine(writer_t *writer, const char *record, size_t length)
+{
+    if (writer->used + length + 1 > writer->capacity)
+    {
+        if (writerFlush(writer) == -1)
+            return -1;
+        // longer than the whole buffer: written directly
+        if (length + 1 > writer->capacity)
+        {
+            if (writeAll(writer->fd, record, length) == -1)
+                return -1;
+            return writeAll(writer->fd, "\n", 1);
+        }
+    }
+
+    memcpy(writer->buffer + writer->used, record, length);
+    writer->buffer[writer->used + length] = '\n';
+    writer->used += length + 1;
+    return 0;
+}
+//endregion
+
+//region READER
+/**
+ * @brief Computes the key of the current line of the reader.
+ *
+ * @return 0 upon success, -1 if no memory was left.
+ */
+static int readerBuildKey(reader_t *reader)
+{
+    if (reader->spec == NULL)
+    {
+        reader->key = reader->record;
+        reader->keyLength = reader->length;
+        return 0;
+    }
+
+    size_t bound = keyBound(reader->spec, reader->length);
+    if (bound > reader->keyCapacity)
+    {
+        char *bigger = realloc(reader->keyBuffer, bound);
+        if (bigger == NULL)
+            return -1;
+        reader->keyBuffer = bigger;
+        reader->keyCapacity = bound;
+    }
+
+    reader->key = reader->keyBuffer;
+    reader->keyLength = buildKey(reader->spec, reader->record, reader->length, reader->keyBuffer);
+    return 0;
+}
+
+/**
+ * @brief Makes the next line of the run the current line of the reader or sets exhausted.
+ * @details The buffer grows if a line doesn't fit into it.
+ *
+ * @return 0 upon success, -1 upon failure.
+ */
+static int readerAdvance(reader_t *reader)
+{
+    while (1)
+    {
+        char *newline = memchr(reader->buffer + reader->start, '\n', reader->end - reader->start);
+        if (newline != NULL)
+        {
+            reader->record = reader->buffer + reader->start;
+            reader->length = newline - reader->record;
+            reader->start += reader->length + 1;
+            return readerBuildKey(reader);
+        }
+
+        // every line of a run ends with a newline, nothing is left at the end
+        if (reader->eof)
+        {
+            reader->exhausted = 1;
+            return 0;
+        }
+
+        size_t remaining = reader->end - reader->start;
+        memmove(reader->buffer, reader->buffer + reader->start, remaining);
+        reader->start = 0;
+        reader->end = remaining;
+
+        if (remaining == reader->capacity)
+        {
+            char *bigger = realloc(reader->buffer, 2 * reader->capacity);
+            if (bigger == NULL)
+                return -1;
+            reader->buffer = bigger;
+            reader->capacity *= 2;
+        }
+
+        ssize_t n = readFull(reader->fd, reader->buffer + reader->end, reader->capacity - reader->end);
+        if (n == -1)
+            return -1;
+        reader->end += n;
+        reader->eof = reader->end < reader->capacity;
+    }
+}
+
+static int readerOpen(reader_t *reader, int fd, size_t capacity, const keySpec_t *spec)
+{
+    *reader = (reader_t) {fd, malloc(capacity), capacity, 0, 0, 0, 0, NULL, 0, spec, NULL, 0, NULL, 0};
+    if (reader->buffer == NULL)
+        return -1;
+
+    if (lseek(fd, 0, SEEK_SET) == -1)
+        return -1;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    return readerAdvance(reader);
+}
+//endregion
+
+//region MERGE
+/** Whether the current line of reader a comes before the one of reader b, exhausted readers come last. */
+static inline int beats(const reader_t *readers, size_t a, size_t b)
+{
+    if (readers[a].exhausted || readers[b].exhausted)
+        return readers[b].exhausted && (!readers[a].exhausted || a < b);
+
+    int result = compareRecords(readers[a].key, readers[a].keyLength, readers[b].key, readers[b].keyLength);
+    // on ties the earlier run wins, the runs are in input order so the merge is stable
+    return result < 0 || (result == 0 && a < b);
+}
+
+/**
+ * @brief Merges the runs with a loser tree.
+ * @details The k runs are the leaves k to 2k - 1 of an implicit binary tree, every inner node stores the loser
+ * of the match of its subtrees and node 0 the overall winner. After the winner advanced, only the matches on the
+ * path from its leaf to the root are replayed (log k comparisons).
+ * Every line is passed to emit together with context, with a unique spec only the first of the lines with
+ * equal keys.
+ *
+ * @param bufferSize The size of the read buffer of every run.
+ * @param spec       The sort keys or NULL if the lines are compared as they are.
+ *
+ * @return 0 upon success, -1 upon failure.
+ */
+static int mergeRuns(const run_t *runs, size_t k, size_t bufferSize, const keySpec_t *spec,
+                     int (*emit)(void *context, const char *record, size_t length), void *context)
+{
+    reader_t *readers = calloc(k, sizeof(reader_t));
+    size_t *tree = malloc(2 * k * sizeof(size_t));
+    size_t *winners = malloc(2 * k * sizeof(size_t));
+    int result = readers != NULL && tree != NULL && winners != NULL ? 0 : -1;
+
+    // the key of the line emitted last, for unique
+    char *lastKey = NULL;
+    size_t lastKeyLength = 0;
+    size_t lastKeyCapacity = 0;
+    int emitted = 0;
+
+    for (size_t i = 0; i < k && result == 0; i++)
+        result = readerOpen(&readers[i], runs[i].fd, bufferSize, spec);
+
+    if (result == 0)
+    {
+        for (size_t i = 0; i < k; i++)
+            winners[k + i] = i;
+        for (size_t node = k - 1; node >= 1; node--)
+        {
+            size_t a = winners[2 * node];
+            size_t b = winners[2 * node + 1];
+            winners[node] = beats(readers, a, b) ? a : b;
+            tree[node] = beats(readers, a, b) ? b : a;
+        }
+        tree[0] = k == 1 ? 0 : winners[1];
+    }
+
+    while (result == 0 && !readers[tree[0]].exhausted)
+    {
+        size_t winner = tree[0];
+        const reader_t *reader = &readers[winner];
+        if (spec == NULL || !spec->unique || !emitted ||
+            compareRecords(reader->key, reader->keyLength, lastKey, lastKeyLength) != 0)
+        {
+            result = emit(context, reader->record, reader->length);
+            emitted = 1;
+
+            if (result == 0 && spec != NULL && spec->unique)
+            {
+                if (reader->keyLength > lastKeyCapacity)
+                {
+                    char *bigger = realloc(lastKey, reader->keyLength);
+                    if (bigger == NULL)
+                        result = -1;
+                    else
+                    {
+                        lastKey = bigger;
+                        lastKeyCapacity = reader->keyLength;
+                    }
+                }
+                if (result == 0)
+                {
+                    memcpy(lastKey, reader->key, reader->keyLength);
+                    lastKeyLength = reader->keyLength;
+                }
+            }
+        }
+        if (result == 0)
+            result = readerAdvance(&readers[winner]);
+
+        for (size_t node = (winner + k) / 2; node >= 1; node /= 2)
+        {
+            if (beats(readers, tree[node], winner))
+            {
+                size_t swap = tree[node];
+                tree[node] = winner;
+                winner = swap;
+            }
+        }
+        tree[0] = winner;
+    }
+
+    if (readers != NULL)
+        for (size_t i = 0; i < k; i++)
+        {
+            free(readers[i].buffer);
+            free(readers[i].keyBuffer);
+        }
+    free(lastKey);
+    free(readers);
+    free(tree);
+    free(winners);
+    return result;
+}
+
+/** emit of mergeRuns writing into a run. */
+static int emitToRun(void *context, const char *record, size_t length)
+{
+    return writerLine(context, record, length);
+}
+
+/** The final output and how many lines were written to it so far. */
+typedef struct {
+    FILE *out;
+    size_t written;
+} output_t;
+
+/**
+ * @brief emit of mergeRuns writing the result in the format of the process tree.
+ * @details Every line but the first is preceded by a newline, the \0 behind the last one is written at the end
+ * (the number of lines isn't known in advance with unique).
+ */
+static int emitToOutput(void *context, const char *record, size_t length)
+{
+    output_t *output = context;
+    if (output->written++ > 0 && putc('\n', output->out) == EOF)
+        return -1;
+
+    return fwrite(record, 1, length, output->out) == length ? 0 : -1;
+}
+
+/**
+ * @brief Merges groups of runs into longer runs until at most fanIn runs are left.
+ *
+ * @return 0 upon success, -1 upon failure.
+ */
+static int reduceRuns(runList_t *list, size_t fanIn, size_t budget, const keySpec_t *spec)
+{
+    while (list->count > fanIn)
+    {
+        size_t merged = 0;
+        for (size_t first = 0; first < list->count; first += fanIn)
+        {
+            size_t k = list->count - first < fanIn ? list->count - first : fanIn;
+            run_t run = list->runs[first];
+
+            if (k > 1)
+            {
+                // one buffer per run and one for the output
+                size_t bufferSize = budget / (k + 1);
+                writer_t writer = {createTemporaryFile(), malloc(bufferSize), bufferSize, 0};
+                if (writer.fd == -1 || writer.buffer == NULL)
+                {
+                    free(writer.buffer);
+                    return -1;
+                }
+
+                run = (run_t) {writer.fd};
+                int result = mergeRuns(list->runs + first, k, bufferSize, spec, emitToRun, &writer);
+                if (result == 0)
+                    result = writerFlush(&writer);
+                free(writer.buffer);
+                if (result == -1)
+                    return -1;
+
+                for (size_t i = first; i < first + k; i++)
+                    close(list->runs[i].fd);
+            }
+
+            list->runs[merged++] = run;
+        }
+        list->count = merged;
+    }
+
+    return 0;
+}
+//endregion
+
+//region RUNS
+/**
+ * @brief Sorts the lines and writes them into a new run.
+ *
+ * @return 0 upon success, -1 upon failure.
+ */
+static int spillRun(runList_t *list, line_t *lines, size_t count, const char *data, const keySpec_t *spec,
+                    sortAlgorithm_e algorithm, threadPool_t *pool, char *buffer, size_t bufferSize)
+{
+    if (spec != NULL ? sortKeyed(lines, &count, data, spec, algorithm, pool) == -1
+                     : sortLines(lines, count, data, algorithm, pool) == -1)
+        return -1;
+
+    writer_t writer = {createTemporaryFile(), buffer, bufferSize, 0};
+    if (writer.fd == -1)
+        return -1;
+
+    for (size_t i = 0; i < count; i++)
+        if (writerLine(&writer, data + lines[i].offset, lines[i].length) == -1)
+            return -1;
+
+    if (writerFlush(&writer) == -1 || runListAdd(list, writer.fd) == -1)
+        return -1;
+    return 0;
+}
+
+int externalSort(int inFd, FILE *out, size_t budget, const keySpec_t *spec, sortAlgorithm_e algorithm,
+                 threadPool_t *pool)
+{
+    // half of the budget holds the bytes of a run, the rest its index, the scratch space of the sort
+    // and the buffer spilling it; with keys a quarter, the keys take about as much as the lines
+    size_t capacity = spec != NULL ? budget / 4 : budget / 2;
+    size_t writeBufferSize = budget / 16;
+    size_t maxLines = (budget - capacity - writeBufferSize) / (2 * sizeof(line_t));
+
+    char *data = malloc(capacity);
+    line_t *lines = malloc(maxLines * sizeof(line_t));
+    char *writeBuffer = malloc(writeBufferSize);
+    runList_t list = {NULL, 0, 0};
+    if (data == NULL || lines == NULL || writeBuffer == NULL)
+    {
+        free(data);
+        free(lines);
+        free(writeBuffer);
+        return -1;
+    }
+
+    int result = 0;
+    size_t used = 0;
+    int eof = 0;
+    int last = 0;
+    while (result == 0 && !last)
+    {
+        if (!eof && used < capacity)
+        {
+            ssize_t n = readFull(inFd, data + used, capacity - used);
+            if (n == -1)
+            {
+                result = -1;
+                break;
+            }
+            used += n;
+            eof = used < capacity;
+        }
+
+        size_t count = 0;
+        size_t consumed = 0;
+        char *newline;
+        while (count < maxLines && (newline = memchr(data + consumed, '\n', used - consumed)) != NULL)
+        {
+            lines[count].offset = consumed;
+            lines[count].length = newline - (data + consumed);
+            consumed += lines[count++].length + 1;
+        }
+
+        // the part after the last newline is a line too
+        if (eof && count < maxLines && memchr(data + consumed, '\n', used - consumed) == NULL)
+        {
+            lines[count++] = (line_t) {consumed, used - consumed};
+            consumed = used;
+            last = 1;
+        }
+
+        if (count == 0)
+        {
+            // a line longer than the buffer, it grows beyond the budget
+            char *bigger = realloc(data, 2 * capacity);
+            if (bigger == NULL)
+            {
+                result = -1;
+                break;
+            }
+            data = bigger;
+            capacity *= 2;
+            continue;
+        }
+
+        if (last && list.count == 0)
+        {
+            // everything fits into memory, nothing is spilled
+            result = spec != NULL ? sortKeyed(lines, &count, data, spec, algorithm, pool)
+                                  : sortLines(lines, count, data, algorithm, pool);
+            if (result == 0)
+                result = writeLines(out, data, lines, count);
+            break;
+        }
+
+        result = spillRun(&list, lines, count, data, spec, algorithm, pool, writeBuffer, writeBufferSize);
+        memmove(data, data + consumed, used - consumed);
+        used -= consumed;
+    }
+    free(lines);
+    free(data);
+    free(writeBuffer);
+
+    if (result == 0 && list.count > 0)
+    {
+        size_t fanIn = budget / MIN_READ_BUFFER - 1;
+        if (fanIn > MAX_FAN_IN)
+            fanIn = MAX_FAN_IN;
+        if (fanIn < 2)
+            fanIn = 2;
+
+        result = reduceRuns(&list, fanIn, budget, spec);
+        output_t output = {out, 0};
+        if (result == 0)
+            result = mergeRuns(list.runs, list.count, budget / list.count, spec, emitToOutput, &output);
+        if (result == 0 && output.written > 1 && putc('\0', out) == EOF)
+            result = -1;
+        if (result == 0)
+            result = fflush(out);
+    }
+
+    for (size_t i = 0; i < list.count; i++)
+        close(list.runs[i].fd);
+    free(list.runs);
+    return result;
+}
+//endregion
@@ -0,0 +1,44 @@
+/**
+ * @file   external.h
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The external sort of forksort (-m), for inputs that don't fit into memory.
+ *
+ * @details The input is read in runs that fit into the memory budget. Every run is sorted in memory by the
+ * engine (see engine.h) and spilled to an unlinked temporary file (in $TMPDIR or /tmp), one line per newline.
+ * The runs are merged with a loser tree, every run is read sequentially through a large buffer.
+ * If there are too many runs for buffers of useful size, groups of runs are merged into longer runs first.
+ * Input that fits into one run is never written to disk. With sort keys (see keys.h) the runs are sorted by
+ * their keys and the merge computes the key of the current line of every run.
+ *
+ * The result is the same as the one of the engine and the process tree, the sort is stable.
+ **/
+
+#ifndef EXTERNAL_H
+#define EXTERNAL_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "engine.h"
+#include "keys.h"
+#include "threadpool.h"
+
+/** The smallest accepted memory budget. */
+#define EXTERNAL_MIN_BUDGET ((size_t) 1 << 20)
+
+/**
+ * @brief Sorts all lines readable from inFd and writes them to out in the format of the process tree.
+ *
+ * @param budget    The number of bytes of memory to use for lines and buffers (at least EXTERNAL_MIN_BUDGET).
+ * @param spec      The sort keys or NULL if the lines are compared as they are.
+ * @param algorithm The algorithm sorting the runs.
+ * @param pool      The workers sorting the runs.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int externalSort(int inFd, FILE *out, size_t budget, const keySpec_t *spec, sortAlgorithm_e algorithm,
+                 threadPool_t *pool);
+
+#endif
@@ -14,7 +14,16 @@
  * for comparison until all children terminated.
  * The process does not know if it outputs the result to the console or to a parent process,
  * as stdout is redirected for children.
- * The program takes no arguments. All lines are read from stdin.
+ * All lines are read from stdin.
+ * With -e the program doesn't fork at all: the lines are sorted in memory by the engine (see engine.h),
+ * -j sets the number of its worker threads (default: one per online CPU).
+ * -a selects the algorithm of the engine, the multikey quicksort (radix, default) or the merge sort (merge).
+ * With -m the engine sorts externally within the given memory budget (see external.h), for inputs larger than memory.
+ * -k, -t, -n, -r and -u sort by keys like sort(1) does (see keys.h).
+ * With -z the process tree hands the lines to its children and back through shared files in memory instead of
+ * pipes (see transport.h).
+ * If the environment variable FORKSORT_TRACE names a directory every process records its fork, exec, read, sort,
+ * merge, write and wait spans there (see trace.h), independent of LOGGING.
  **/
 /*        FDS
  *             outputPipe |
@@ -32,8 +41,14 @@
 #include <wait.h>
 #include <errno.h>
 #include <string.h>
+#include <stdint.h>
 #include <sys/stat.h>
 
+#include "engine.h"
+#include "external.h"
+#include "transport.h"
+#include "trace.h"
+
 
 //region ERROR
 #define TRY(result, message) try(result, message, __LINE__)
@@ -58,6 +73,12 @@
 # define ERROR_WRITE_PARENT   "Writing to parent failed"
 # define ERROR_CHILD_FAILURE  "Child terminated with error"
 # define ERROR_WAIT_FOR_CHILD "Waiting for child completion failed"
+
+# define ERROR_LOAD_INPUT    "Loading input failed"
+# define ERROR_INDEX_LINES   "Indexing lines failed"
+# define ERROR_CREATE_POOL   "Creating thread pool failed"
+# define ERROR_SORT          "Sorting failed"
+# define ERROR_SHARED_FILE   "Creating shared file failed"
 //endregion
 //endregion
 
@@ -110,12 +131,36 @@ typedef enum {
 
 /** Reuse pipe_end_e to also indicate the mode of a pipe. */
 typedef pipe_end_e pipe_mode_e;
+
+/**
+ * Represents a child process of the shared memory transport (-z).
+ * Holds its process id, the shared files that are its stdin and stdout and the number of its lines.
+ */
+typedef struct {
+    pid_t pid;
+    int inputFd;
+    int outputFd;
+    size_t count;
+} transport_child_t;
 //endregion
 
 //region GLOBAL VARIABLES
 /** The program name as specified in argv[0] */
 char *programName_g = "Not yet set";
 
+/** Whether the lines are sorted in memory by the engine (-e) instead of the process tree. */
+bool engineMode_g = false;
+/** Whether the process tree uses the shared memory transport (-z) instead of pipes. */
+bool transportMode_g = false;
+/** The number of worker threads of the engine (-j), 0 for one per online CPU. */
+size_t engineThreads_g = 0;
+/** The algorithm of the engine (-a). */
+sortAlgorithm_e sortAlgorithm_g = SORT_RADIX;
+/** The memory budget of the external sort in bytes (-m), 0 to sort everything in memory. */
+size_t memoryBudget_g = 0;
+/** The sort keys of the engine (-k, -t, -n, -r, -u). */
+keySpec_t keySpec_g = {NULL, 0, -1, 0, 0, 0};
+
 /** The first child of the process if any. */
 child_process_t child1_g;
 /** The second child of the process if any. */
@@ -128,6 +173,8 @@ FILE *g_process_log;
 //region FUNCTIONS DECLARATIONS
 static inline void tryOpenProcessLog(void);
 static inline void tryParseArguments(int argc, char **argv);
+static inline void tryRunEngine(void);
+static inline void tryRunTransportTree(void);
 
 static inline bool tryReadLineFrom(FILE* source, char **line_out, int *lineSize_out);
 static inline void tryReadLineAndExitOnEOF(char **line_out);
@@ -144,6 +191,7 @@ static inline int redirectPipe(pipe_t *pipePtr, pipe_end_e pipeEnd, int targetFd
 static inline int closePipeEnd(pipe_t *pipePtr, pipe_end_e pipeEnd);
 
 static inline void try(int operationResult, const char *message, int line);
+static inline void tryPtr(void *operationResult, const char *message, int line);
 //endregion
 
 
@@ -166,12 +214,20 @@ int main(int argc, char *argv[])
     if (LOGGING)
         tryOpenProcessLog();
     LOG("%s", "Program started.\n\n");
+    traceInit();
 
     tryParseArguments(argc, argv);
 
+    if (engineMode_g)
+        tryRunEngine();
+    if (transportMode_g)
+        tryRunTransportTree();
+
     LOG("%s", "Try reading first line...\n\n");
     char *line = malloc(sizeof(char));
+    uint64_t begin = traceNow();
     tryReadLineAndExitOnEOF(&line);
+    traceSpan(TRACE_READ, begin, 0, 1);
     LOG("%s", "Input seems to consist of multiple lines.\n\n");
 
     LOG("%s", "Try initializing children...\n\n");
@@ -181,14 +237,18 @@ int main(int argc, char *argv[])
 
     LOG("%s", "Try forwarding input to children...\n\n");
     tryOpenChildrenAccess(WRITE);
+    begin = traceNow();
     tryForwardInputToChildren(&line);
+    traceSpan(TRACE_READ, begin, 0, 0);
     tryCloseChildrenAccess(WRITE);
     LOG("%s", "Input successfully redirected and input pipes closed.\n\n");
 
     LOG("%s", "Try reading output of children and output result...\n\n");
     tryOpenChildrenAccess(READ);
     char* line2 = malloc(sizeof(char));
+    begin = traceNow();
     tryReadAndOutputChildrenResultsOrdered(&line, &line2);
+    traceSpan(TRACE_MERGE, begin, 0, 0);
     tryCloseChildrenAccess(READ);
     LOG("%s", "Result output succeeded.\n\n");
 
@@ -208,21 +268,307 @@ int main(int argc, char *argv[])
 
 
 /**
- * @brief Verifies there are no arguments except the program name and sets it.
- * @details Terminates the program with EXIT_FAILURE if one or more arguments were specified by the user.
+ * @brief Prints the usage message and terminates the program with EXIT_FAILURE.
  *
  * global variables used: programName_g - The program name as specified in argumentValues[0]
  */
-static inline void tryParseArguments(int argc, char **argv)
+static inline void printUsageAndTerminate(void)
 {
-    if (argc != 1)
+    fprintf(stderr, "Invalid parameters. USAGE: %s [-z | -e [-j threads] [-m size] [-a merge|radix] [-k key]... "
+            "[-t separator] [-n] [-r] [-u]]\n", programName_g);
+    LOG("Invalid parameters. USAGE: %s [-z | -e [-j threads] [-m size] [-a merge|radix] [-k key]... [-t separator] "
+        "[-n] [-r] [-u]]\n", programName_g);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Parses a memory size like 512M (suffixes K, M and G, powers of 1024).
+ *
+ * @return The number of bytes or 0 if size is invalid.
+ */
+static inline size_t parseSize(const char *size)
+{
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(size, &end, 10);
+    if (errno != 0 || end == size || *size == '-')
+        return 0;
+
+    int shift = 0;
+    switch (*end)
     {
-        fprintf(stderr, "Invalid parameters. USAGE: %s\n", programName_g);
-        LOG("Invalid parameters. USAGE: %s\n", programName_g);
-        exit(EXIT_FAILURE);
+        case 'G': shift += 10; // fallthrough
+        case 'M': shift += 10; // fallthrough
+        case 'K': shift += 10; end++; break;
+        default: break;
     }
+    if (*end != '\0' || value > (SIZE_MAX >> shift))
+        return 0;
 
+    return (size_t) value << shift;
+}
+
+/**
+ * @brief Parses the options and sets the program name.
+ * @details Terminates the program with EXIT_FAILURE if an option is invalid, -j, -m or -t is repeated or if any
+ * positional arguments were specified by the user or -z is combined with the engine. All other options imply -e.
+ * Children of the process tree are always executed without options.
+ *
+ * global variables used: programName_g    - The program name as specified in argumentValues[0]
+ *                        engineMode_g     - Whether the engine sorts the lines
+ *                        transportMode_g  - Whether the process tree uses the shared memory transport
+ *                        engineThreads_g  - The number of worker threads of the engine
+ *                        sortAlgorithm_g  - The algorithm of the engine
+ *                        memoryBudget_g   - The memory budget of the external sort
+ *                        keySpec_g        - The sort keys of the engine
+ */
+static inline void tryParseArguments(int argc, char **argv)
+{
     programName_g = argv[0];
+
+    bool threadsSet = false;
+    int option;
+    while ((option = getopt(argc, argv, "zej:m:a:k:t:nru")) != -1)
+    {
+        switch (option)
+        {
+            case 'z':
+                transportMode_g = true;
+                break;
+            case 'e':
+                engineMode_g = true;
+                break;
+            case 'j':
+            {
+                char *end;
+                errno = 0;
+                long threads = strtol(optarg, &end, 10);
+                if (threadsSet || errno != 0 || end == optarg || *end != '\0' || threads < 1 || threads > 1024)
+                    printUsageAndTerminate();
+                engineThreads_g = threads;
+                engineMode_g = true;
+                threadsSet = true;
+                break;
+            }
+            case 'a':
+                if (strcmp(optarg, "merge") == 0)
+                    sortAlgorithm_g = SORT_MERGE;
+                else if (strcmp(optarg, "radix") == 0)
+                    sortAlgorithm_g = SORT_RADIX;
+                else
+                    printUsageAndTerminate();
+                engineMode_g = true;
+                break;
+            case 'm':
+                if (memoryBudget_g != 0 || (memoryBudget_g = parseSize(optarg)) < EXTERNAL_MIN_BUDGET)
+                    printUsageAndTerminate();
+                engineMode_g = true;
+                break;
+            case 'k':
+                if (keySpecAdd(&keySpec_g, optarg) == -1)
+                    printUsageAndTerminate();
+                engineMode_g = true;
+                break;
+            case 't':
+                if (keySpec_g.separator != -1 || strlen(optarg) != 1)
+                    printUsageAndTerminate();
+                keySpec_g.separator = (unsigned char) optarg[0];
+                engineMode_g = true;
+                break;
+            case 'n':
+                keySpec_g.numeric = true;
+                engineMode_g = true;
+                break;
+            case 'r':
+                keySpec_g.reverse = true;
+                engineMode_g = true;
+                break;
+            case 'u':
+                keySpec_g.unique = true;
+                engineMode_g = true;
+                break;
+            default:
+                printUsageAndTerminate();
+        }
+    }
+
+    if (optind != argc || (transportMode_g && engineMode_g))
+        printUsageAndTerminate();
+}
+
+/**
+ * @brief Sorts all lines read from stdin with the engine, outputs them and terminates the program with EXIT_SUCCESS.
+ * @details The lines are sorted in memory or, if a memory budget was set, externally. The output is the same as
+ * the one of the process tree. Terminates the program with EXIT_FAILURE upon failure of any called function by
+ * calling printErrnoAndTerminate.
+ *
+ * global variables used: engineThreads_g - The number of worker threads of the engine
+ *                        sortAlgorithm_g - The algorithm of the engine
+ *                        memoryBudget_g  - The memory budget of the external sort
+ *                        keySpec_g       - The sort keys of the engine
+ */
+static inline void tryRunEngine(void)
+{
+    size_t threads = engineThreads_g;
+    if (threads == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? online : 1;
+    }
+
+    threadPool_t *pool;
+    TRY_PTR(pool = threadPoolCreate(threads), ERROR_CREATE_POOL);
+
+    // one big buffer, the lines are written with few system calls
+    setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+
+    const keySpec_t *spec = keySpecActive(&keySpec_g) ? &keySpec_g : NULL;
+    uint64_t begin = traceNow();
+    if (memoryBudget_g != 0)
+    {
+        TRY(externalSort(STDIN_FILENO, stdout, memoryBudget_g, spec, sortAlgorithm_g, pool), ERROR_SORT);
+        traceSpan(TRACE_SORT, begin, 0, 0);
+        LOG("Sorted externally with %zu threads.\n", threads);
+    }
+    else
+    {
+        arena_t arena;
+        TRY(arenaLoad(STDIN_FILENO, &arena), ERROR_LOAD_INPUT);
+        LOG("Loaded %zu bytes of input.\n", arena.size);
+        traceSpan(TRACE_READ, begin, 0, arena.size);
+
+        size_t count;
+        line_t *lines;
+        begin = traceNow();
+        TRY_PTR(lines = indexLines(&arena, &count), ERROR_INDEX_LINES);
+        if (spec != NULL)
+            TRY(sortKeyed(lines, &count, arena.data, spec, sortAlgorithm_g, pool), ERROR_SORT);
+        else
+            TRY(sortLines(lines, count, arena.data, sortAlgorithm_g, pool), ERROR_SORT);
+        traceSpan(TRACE_SORT, begin, 0, count);
+        LOG("Sorted %zu lines with %zu threads.\n", count, threads);
+
+        begin = traceNow();
+        TRY(writeLines(stdout, arena.data, lines, count), ERROR_WRITE_PARENT);
+        traceSpan(TRACE_WRITE, begin, 0, count);
+
+        free(lines);
+        arenaFree(&arena);
+    }
+
+    threadPoolDestroy(pool);
+    keySpecFree(&keySpec_g);
+
+    if (LOGGING)
+        fclose(g_process_log);
+
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * @brief Sorts all lines read from stdin with the process tree using the shared memory transport, outputs them and
+ * terminates the program with EXIT_SUCCESS.
+ * @details The input is loaded like by the engine. A single line is output as it is, otherwise the first half of
+ * the lines is written to the input of child 1 and the second half to the one of child 2 (each with one write,
+ * the halves are contiguous). The children execute forksort -z with these shared files as stdin and stdout.
+ * After both terminated their outputs are mapped and merged. The output is the same as the one of the pipes.
+ * Terminates the program with EXIT_FAILURE upon failure of any called function by calling printErrnoAndTerminate.
+ */
+static inline void tryRunTransportTree(void)
+{
+    uint64_t begin = traceNow();
+    arena_t arena;
+    TRY(arenaLoad(STDIN_FILENO, &arena), ERROR_LOAD_INPUT);
+
+    size_t count;
+    line_t *lines;
+    TRY_PTR(lines = indexLines(&arena, &count), ERROR_INDEX_LINES);
+    LOG("Loaded %zu lines (%zu bytes) of input.\n", count, arena.size);
+    traceSpan(TRACE_READ, begin, 0, count);
+
+    if (count == 1)
+    {
+        begin = traceNow();
+        TRY(fwrite(arena.data, 1, arena.size, stdout) == arena.size ? 0 : -1, ERROR_WRITE_PARENT);
+        TRY(fflush(stdout), ERROR_WRITE_PARENT);
+        traceSpan(TRACE_WRITE, begin, 0, arena.size);
+        LOG("%s", "Input was only a single line, process terminates.\n");
+        exit(EXIT_SUCCESS);
+    }
+
+    // child 1 gets the lines [0, half), child 2 the lines [half, count), without the newline between them
+    size_t half = count / 2;
+    size_t split = lines[half].offset;
+    const char *begins[2] = {arena.data, arena.data + split};
+    size_t sizes[2] = {split - 1, arena.size - split};
+    transport_child_t children[2] = {{0, -1, -1, half}, {0, -1, -1, count - half}};
+
+    for (int i = 0; i < 2; i++)
+    {
+        TRY(children[i].inputFd = sharedFileCreate("forksort-input"), ERROR_SHARED_FILE);
+        TRY(children[i].outputFd = sharedFileCreate("forksort-output"), ERROR_SHARED_FILE);
+        begin = traceNow();
+        TRY(sharedFileWrite(children[i].inputFd, begins[i], sizes[i]), ERROR_WRITE_CHILD);
+        traceSpan(TRACE_WRITE, begin, 0, sizes[i]);
+    }
+    free(lines);
+
+    // output in the buffer of stdio isn't inherited
+    fflush(stdout);
+    for (int i = 0; i < 2; i++)
+    {
+        begin = traceNow();
+        TRY(children[i].pid = fork(), ERROR_FORK);
+        if (children[i].pid == 0) // child continues here, the shared files are closed on exec
+        {
+            TRY(dup2(children[i].inputFd, STDIN_FILENO), ERROR_REDIRECT_PIPE);
+            TRY(dup2(children[i].outputFd, STDOUT_FILENO), ERROR_REDIRECT_PIPE);
+            traceBeforeExec();
+            TRY(execlp(programName_g, programName_g, "-z", NULL), ERROR_EXEC);
+        }
+        traceSpan(TRACE_FORK, begin, children[i].pid, children[i].count);
+        LOG("Started child %d with %zu lines.\n", children[i].pid, children[i].count);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        tryWaitForChildCompletion(children[i].pid);
+        TRY(close(children[i].inputFd), ERROR_CLOSE_PIPE);
+    }
+
+    arena_t outputs[2];
+    line_t *childLines[2];
+    size_t childCounts[2];
+    for (int i = 0; i < 2; i++)
+    {
+        TRY(arenaLoad(children[i].outputFd, &outputs[i]), ERROR_LOAD_INPUT);
+        TRY(close(children[i].outputFd), ERROR_CLOSE_PIPE);
+
+        // more than one line ends with \0, which isn't part of the last line
+        arena_t lastLineEnd = outputs[i];
+        if (children[i].count > 1 && lastLineEnd.size > 0)
+            lastLineEnd.size--;
+        TRY_PTR(childLines[i] = indexLines(&lastLineEnd, &childCounts[i]), ERROR_INDEX_LINES);
+    }
+
+    setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+    begin = traceNow();
+    TRY(writeMerged(stdout, outputs[0].data, childLines[0], childCounts[0],
+                    outputs[1].data, childLines[1], childCounts[1]), ERROR_WRITE_PARENT);
+    traceSpan(TRACE_MERGE, begin, 0, count);
+    LOG("%s", "Result output succeeded.\n");
+
+    for (int i = 0; i < 2; i++)
+    {
+        free(childLines[i]);
+        arenaFree(&outputs[i]);
+    }
+    arenaFree(&arena);
+
+    if (LOGGING)
+        fclose(g_process_log);
+
+    exit(EXIT_SUCCESS);
 }
 
 //region ERROR HANDLING
@@ -328,7 +674,10 @@ static inline void tryReadLineAndExitOnEOF(char **line_out)
 
     if(terminatedByEOF)
     {
+        uint64_t begin = traceNow();
         TRY(fprintf(stdout, "%s", *line_out), ERROR_WRITE_PARENT);
+        TRY(fflush(stdout), ERROR_WRITE_PARENT);
+        traceSpan(TRACE_WRITE, begin, 0, 1);
         LOG("%s", "Input was only a single line, process terminates.\n");
 
         free(*line_out);
@@ -613,6 +962,7 @@ static inline void tryStartAndRunChild(child_process_t* childPtr)
     TRY(initPipe(&(childPtr->outputPipe)), ERROR_INIT_PIPE);
     LOG("Initialized input & output pipe for child %d.\n", ++childNumber);
 
+    uint64_t begin = traceNow();
     TRY(childPtr->pid = fork(), ERROR_FORK);
     if (childPtr->pid == 0) // child continues here
     {
@@ -628,10 +978,13 @@ static inline void tryStartAndRunChild(child_process_t* childPtr)
             TRY(closePipeEnd(&child1_g.outputPipe, READ), ERROR_CLOSE_PIPE);
         }
 
+        traceBeforeExec();
         TRY(execlp(programName_g, programName_g, NULL), ERROR_EXEC);
         // shouldn't be reached
     }
 
+    traceSpan(TRACE_FORK, begin, childPtr->pid, 0);
+
     TRY(closePipeEnd(&(childPtr->inputPipe), READ), ERROR_CLOSE_PIPE);
     TRY(closePipeEnd(&(childPtr->outputPipe), WRITE), ERROR_CLOSE_PIPE);
     LOG("Closed unused pipe ends of child %d.\n", childPtr->pid);
@@ -645,6 +998,7 @@ static inline void tryStartAndRunChild(child_process_t* childPtr)
  */
 static inline void tryWaitForChildCompletion(pid_t pid_child)
 {
+    uint64_t begin = traceNow();
     int status;
     while (waitpid(pid_child, &status, 0) == -1) {
         if (errno == EINTR)
@@ -656,6 +1010,7 @@ static inline void tryWaitForChildCompletion(pid_t pid_child)
     if (WEXITSTATUS(status) != EXIT_SUCCESS) // NOLINT(hicpp-signed-bitwise)
         printErrnoAndTerminate(ERROR_CHILD_FAILURE, __LINE__);
 
+    traceSpan(TRACE_WAIT, begin, pid_child, 0);
     LOG("Child %d terminated successfully.\n", pid_child);
 }
 
@@ -0,0 +1,318 @@
+/**
+ * @file   keys.c
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief Sort keys like the ones of sort(1) (-k, -t, -n, -r, -u) for the engine.
+ **/
+
+#include "keys.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/** Encodes a \0 byte of a text field (followed by ESCAPE_NUL). */
+#define ESCAPE_BYTE ((unsigned char) 0x00)
+#define ESCAPE_NUL  ((unsigned char) 0xFF)
+
+/** The first byte of a numeric field: the class of the number. */
+#define NUMBER_NEGATIVE ((unsigned char) 0x40)
+#define NUMBER_ZERO     ((unsigned char) 0x80)
+#define NUMBER_POSITIVE ((unsigned char) 0xC0)
+
+/** The number of bytes encoding the number of integer digits. */
+#define DIGIT_COUNT_SIZE 4
+
+//region PARSING
+/**
+ * @brief Parses a position F[.C] followed by options (n, r, b) of a key definition.
+ * @details n and r are set for the whole field, b only for the position (skipBlanks_out).
+ *
+ * @param position_in_out The text to parse, will point behind the position.
+ *
+ * @return 0 upon success, -1 if the position is invalid.
+ */
+static int parsePosition(const char **position_in_out, size_t *field_out, size_t *char_out, int *skipBlanks_out,
+                         keyField_t *field)
+{
+    const char *position = *position_in_out;
+    char *end;
+
+    if (*position < '0' || *position > '9')
+        return -1;
+    errno = 0;
+    *field_out = strtoul(position, &end, 10);
+    if (errno != 0 || *field_out == 0)
+        return -1;
+
+    if (*end == '.')
+    {
+        position = end + 1;
+        if (*position < '0' || *position > '9')
+            return -1;
+        *char_out = strtoul(position, &end, 10);
+        if (errno != 0)
+            return -1;
+    }
+
+    for (; *end != '\0' && *end != ','; end++)
+    {
+        if (*end == 'n')
+            field->numeric = 1;
+        else if (*end == 'r')
+            field->reverse = 1;
+        else if (*end == 'b')
+            *skipBlanks_out = 1;
+        else
+            return -1;
+    }
+
+    *position_in_out = end;
+    return 0;
+}
+
+int keySpecAdd(keySpec_t *spec, const char *definition)
+{
+    keyField_t field = {0, 1, 0, 0, 0, 0, 0, 0};
+
+    if (parsePosition(&definition, &field.startField, &field.startChar, &field.skipBlanks, &field) == -1 ||
+        field.startChar == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (*definition == ',')
+    {
+        definition++;
+        if (parsePosition(&definition, &field.endField, &field.endChar, &field.skipEndBlanks, &field) == -1)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    keyField_t *fields = realloc(spec->fields, (spec->count + 1) * sizeof(keyField_t));
+    if (fields == NULL)
+        return -1;
+
+    spec->fields = fields;
+    spec->fields[spec->count++] = field;
+    return 0;
+}
+
+int keySpecActive(const keySpec_t *spec)
+{
+    return spec->count > 0 || spec->separator != -1 || spec->numeric || spec->reverse || spec->unique;
+}
+
+void keySpecFree(keySpec_t *spec)
+{
+    free(spec->fields);
+    spec->fields = NULL;
+    spec->count = 0;
+}
+//endregion
+
+//region FIELDS
+static inline int isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * @brief Returns the offset of the first byte of the field (counted from 1) or length if the line has fewer.
+ * @details Fields separated by blanks include the blanks in front of them, like in sort(1).
+ */
+static size_t fieldStart(const keySpec_t *spec, const char *line, size_t length, size_t field)
+{
+    size_t i = 0;
+    for (size_t f = 1; f < field && i < length; f++)
+    {
+        if (spec->separator == -1)
+        {
+            while (i < length && isBlank(line[i]))
+                i++;
+            while (i < length && !isBlank(line[i]))
+                i++;
+        }
+        else
+        {
+            const char *separator = memchr(line + i, spec->separator, length - i);
+            i = separator == NULL ? length : (size_t) (separator - line) + 1;
+        }
+    }
+
+    return i;
+}
+
+/**
+ * @brief Returns the offset behind the last byte of the field starting at start.
+ */
+static size_t fieldEnd(const keySpec_t *spec, const char *line, size_t length, size_t start)
+{
+    if (spec->separator != -1)
+    {
+        const char *separator = memchr(line + start, spec->separator, length - start);
+        return separator == NULL ? length : (size_t) (separator - line);
+    }
+
+    while (start < length && isBlank(line[start]))
+        start++;
+    while (start < length && !isBlank(line[start]))
+        start++;
+    return start;
+}
+
+/**
+ * @brief Finds the bytes [begin_out, end_out) of the line the key field covers.
+ * @details Like in sort(1) character positions may reach beyond their field (up to the end of the line).
+ */
+static void fieldRange(const keySpec_t *spec, const keyField_t *field, const char *line, size_t length,
+                       size_t *begin_out, size_t *end_out)
+{
+    size_t begin = fieldStart(spec, line, length, field->startField);
+    if (field->skipBlanks)
+        while (begin < length && isBlank(line[begin]))
+            begin++;
+    begin = field->startChar - 1 < length - begin ? begin + field->startChar - 1 : length;
+
+    size_t end = length;
+    if (field->endField != 0)
+    {
+        size_t last = fieldStart(spec, line, length, field->endField);
+        if (field->endChar == 0)
+            end = fieldEnd(spec, line, length, last);
+        else
+        {
+            if (field->skipEndBlanks)
+                while (last < length && isBlank(line[last]))
+                    last++;
+            end = field->endChar < length - last ? last + field->endChar : length;
+        }
+    }
+
+    *begin_out = begin;
+    *end_out = end > begin ? end : begin;
+}
+//endregion
+
+//region ENCODING
+/**
+ * @brief Encodes text so no encoded text is a prefix of another: \0 bytes are escaped, the end is \0\0.
+ *
+ * @return The number of bytes written.
+ */
+static size_t encodeText(const char *text, size_t length, unsigned char *out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        out[n++] = text[i];
+        if (text[i] == '\0')
+            out[n++] = ESCAPE_NUL;
+    }
+    out[n++] = ESCAPE_BYTE;
+    out[n++] = ESCAPE_BYTE;
+    return n;
+}
+
+/**
+ * @brief Encodes a number like sort -n reads it (blanks, an optional minus, digits and an optional
+ * decimal point followed by digits, anything else is 0).
+ * @details The encoding is the class (negative, zero, positive) followed by the number of integer digits
+ * without leading zeros, the digits without trailing fractional zeros and a 0 byte, all inverted for
+ * negative numbers.
+ *
+ * @return The number of bytes written.
+ */
+static size_t encodeNumber(const char *text, size_t length, unsigned char *out)
+{
+    size_t i = 0;
+    while (i < length && isBlank(text[i]))
+        i++;
+
+    int negative = i < length && text[i] == '-';
+    if (negative)
+        i++;
+
+    while (i < length && text[i] == '0')
+        i++;
+    size_t integerStart = i;
+    while (i < length && text[i] >= '0' && text[i] <= '9')
+        i++;
+    size_t integerDigits = i - integerStart;
+
+    size_t fractionStart = i, fractionEnd = i;
+    if (i < length && text[i] == '.')
+    {
+        fractionStart = ++i;
+        while (i < length && text[i] >= '0' && text[i] <= '9')
+            i++;
+        fractionEnd = i;
+        while (fractionEnd > fractionStart && text[fractionEnd - 1] == '0')
+            fractionEnd--;
+    }
+
+    if (integerDigits == 0 && fractionEnd == fractionStart)
+    {
+        out[0] = NUMBER_ZERO;
+        return 1;
+    }
+
+    size_t n = 0;
+    out[n++] = NUMBER_POSITIVE;
+    for (int shift = 8 * (DIGIT_COUNT_SIZE - 1); shift >= 0; shift -= 8)
+        out[n++] = integerDigits >> shift;
+    memcpy(out + n, text + integerStart, integerDigits);
+    n += integerDigits;
+    memcpy(out + n, text + fractionStart, fractionEnd - fractionStart);
+    n += fractionEnd - fractionStart;
+    out[n++] = 0;
+
+    if (negative)
+    {
+        out[0] = NUMBER_NEGATIVE;
+        for (size_t j = 1; j < n; j++)
+            out[j] = ~out[j];
+    }
+    return n;
+}
+
+size_t keyBound(const keySpec_t *spec, size_t length)
+{
+    // escaped text doubles at most and ends with two bytes, a number adds at most 2 + DIGIT_COUNT_SIZE bytes
+    size_t fields = spec->count > 0 ? spec->count : 1;
+    return fields * (2 * length + 2 + DIGIT_COUNT_SIZE);
+}
+
+size_t buildKey(const keySpec_t *spec, const char *line, size_t length, char *key)
+{
+    keyField_t whole = {1, 1, 0, 0, 0, 0, 0, 0};
+    const keyField_t *fields = spec->count > 0 ? spec->fields : &whole;
+    size_t count = spec->count > 0 ? spec->count : 1;
+
+    unsigned char *out = (unsigned char *) key;
+    size_t n = 0;
+    for (size_t f = 0; f < count; f++)
+    {
+        // like sort(1): the global options only apply to fields without options of their own
+        int ownOptions = fields[f].numeric || fields[f].reverse || fields[f].skipBlanks || fields[f].skipEndBlanks;
+        int numeric = ownOptions ? fields[f].numeric : spec->numeric;
+        int reverse = ownOptions ? fields[f].reverse : spec->reverse;
+
+        size_t begin, end;
+        fieldRange(spec, &fields[f], line, length, &begin, &end);
+
+        size_t written = numeric ? encodeNumber(line + begin, end - begin, out + n)
+                                 : encodeText(line + begin, end - begin, out + n);
+        if (reverse)
+            for (size_t i = n; i < n + written; i++)
+                out[i] = ~out[i];
+        n += written;
+    }
+
+    return n;
+}
+//endregion
@@ -0,0 +1,80 @@
+/**
+ * @file   keys.h
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief Sort keys like the ones of sort(1) (-k, -t, -n, -r, -u) for the engine.
+ *
+ * @details For every line one normalized binary key is computed in advance, so that comparing two keys
+ * byte by byte (like compareRecords) gives the order of the lines: the key fields are extracted, text is
+ * escaped so no field is a prefix of another, numbers are encoded as sign, number of integer digits and
+ * digits, and reversed fields have all their bytes inverted. The fields are concatenated.
+ * Lines with equal keys keep the order of the input (like sort -s).
+ **/
+
+#ifndef KEYS_H
+#define KEYS_H
+
+#include <stddef.h>
+
+/**
+ * A key field like -k 2.3,4n: from character startChar of field startField to character endChar
+ * (0: the end) of field endField (0: the end of the line). Fields and characters are counted from 1.
+ * skipBlanks and skipEndBlanks (option b) skip the blanks in front of the start and end field.
+ */
+typedef struct {
+    size_t startField;
+    size_t startChar;
+    size_t endField;
+    size_t endChar;
+    int numeric;
+    int reverse;
+    int skipBlanks;
+    int skipEndBlanks;
+} keyField_t;
+
+/**
+ * The keys of a sort.
+ * separator is the field separator (-t) or -1 if fields are separated by blanks, numeric and reverse apply
+ * to the fields without options of their own (and to the whole line if there are no fields). unique
+ * outputs only the first of the lines with equal keys.
+ */
+typedef struct {
+    keyField_t *fields;
+    size_t count;
+    int separator;
+    int numeric;
+    int reverse;
+    int unique;
+} keySpec_t;
+
+/**
+ * @brief Parses a key definition like the ones of sort -k (e.g. 2, 2,2, 1.3,1.5, 3nr) and adds it to spec.
+ *
+ * @return 0 upon success, -1 if the definition is invalid or no memory was left.
+ */
+int keySpecAdd(keySpec_t *spec, const char *definition);
+
+/**
+ * @brief Returns whether the lines are sorted by keys at all (otherwise they are compared as they are).
+ */
+int keySpecActive(const keySpec_t *spec);
+
+/**
+ * @brief Frees the fields of spec.
+ */
+void keySpecFree(keySpec_t *spec);
+
+/**
+ * @brief Returns the largest number of bytes the key of a line of the given length can have.
+ */
+size_t keyBound(const keySpec_t *spec, size_t length);
+
+/**
+ * @brief Writes the key of the line to key (at least keyBound bytes).
+ *
+ * @return The length of the key.
+ */
+size_t buildKey(const keySpec_t *spec, const char *line, size_t length, char *key);
+
+#endif
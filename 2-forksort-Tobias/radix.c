@@ -0,0 +1,238 @@
+/**
+ * @file   radix.c
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief Multikey quicksort of the lines of the engine (-a radix).
+ **/
+
+#include "radix.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/** Ranges of at most this many entries are sorted with insertion sort. */
+#define INSERTION_SORT_MAX 24
+
+/** The number of bytes of a prefix. */
+#define PREFIX_SIZE 8
+
+//region TYPES
+/**
+ * A line to sort.
+ * prefix holds the bytes depth to depth + 7 of the line (big-endian, missing bytes are 0) for the depth the
+ * entry is currently sorted at.
+ */
+typedef struct {
+    uint64_t prefix;
+    const char *line;
+    size_t length;
+} entry_t;
+
+/** The state shared by the tasks of one sort: partitions of at least taskMin entries are sorted by the pool. */
+typedef struct {
+    threadPool_t *pool;
+    size_t taskMin;
+} sortState_t;
+
+/** Sorts entries[0, count) at depth, see entry_t. */
+typedef struct {
+    entry_t *entries;
+    size_t count;
+    size_t depth;
+    sortState_t *state;
+} radixTask_t;
+//endregion
+
+//region KEYS
+/**
+ * @brief Returns the bytes depth to depth + 7 of the line as big-endian number, missing bytes are 0.
+ */
+static inline uint64_t loadPrefix(const char *line, size_t length, size_t depth)
+{
+    size_t available = length - depth;
+    uint64_t prefix = 0;
+
+    if (available >= PREFIX_SIZE)
+    {
+        memcpy(&prefix, line + depth, PREFIX_SIZE);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        prefix = __builtin_bswap64(prefix);
+#endif
+        return prefix;
+    }
+
+    for (size_t i = 0; i < available; i++)
+        prefix |= (uint64_t) (unsigned char) line[depth + i] << (8 * (PREFIX_SIZE - 1 - i));
+    return prefix;
+}
+
+/**
+ * @brief Returns how many bytes of the prefix of the entry belong to the line.
+ * @details Needed to tell "a" from "a\0": the prefixes are equal, but the shorter line comes first.
+ */
+static inline size_t prefixLength(const entry_t *entry, size_t depth)
+{
+    size_t available = entry->length - depth;
+    return available < PREFIX_SIZE ? available : PREFIX_SIZE;
+}
+
+/**
+ * @brief Compares the keys (prefix, prefix length) of two entries at depth.
+ *
+ * @return A negative value, 0 or a positive value like strcmp.
+ */
+static inline int compareKeys(const entry_t *a, const entry_t *b, size_t depth)
+{
+    if (a->prefix != b->prefix)
+        return a->prefix < b->prefix ? -1 : 1;
+
+    size_t aLength = prefixLength(a, depth);
+    size_t bLength = prefixLength(b, depth);
+    return (aLength > bLength) - (aLength < bLength);
+}
+
+/**
+ * @brief Compares two entries at depth, the rest of the lines is only compared if the keys are equal.
+ */
+static inline int compareEntries(const entry_t *a, const entry_t *b, size_t depth)
+{
+    int result = compareKeys(a, b, depth);
+    if (result != 0 || prefixLength(a, depth) < PREFIX_SIZE)
+        return result;
+
+    depth += PREFIX_SIZE;
+    return compareRecords(a->line + depth, a->length - depth, b->line + depth, b->length - depth);
+}
+//endregion
+
+//region SORTING
+static void radixSort(entry_t *entries, size_t count, size_t depth, sortState_t *state);
+
+/** Task: sorts one partition, see radixTask_t. */
+static void runRadixTask(void *arg)
+{
+    radixTask_t *task = arg;
+    radixSort(task->entries, task->count, task->depth, task->state);
+    free(task);
+}
+
+/**
+ * @brief Sorts a partition, large ones are handed to a worker if there is a pool.
+ */
+static void sortPartition(entry_t *entries, size_t count, size_t depth, sortState_t *state)
+{
+    if (state->pool != NULL && count >= state->taskMin)
+    {
+        radixTask_t *task = malloc(sizeof(radixTask_t));
+        if (task != NULL)
+        {
+            *task = (radixTask_t) {entries, count, depth, state};
+            if (threadPoolSubmit(state->pool, runRadixTask, task) == 0)
+                return;
+            free(task);
+        }
+        // no memory for another task, the partition is sorted right here
+    }
+
+    radixSort(entries, count, depth, state);
+}
+
+static inline void swapEntries(entry_t *a, entry_t *b)
+{
+    entry_t swap = *a;
+    *a = *b;
+    *b = swap;
+}
+
+/** Returns the entry with the median key of a, b and c. */
+static inline const entry_t *medianOfThree(const entry_t *a, const entry_t *b, const entry_t *c, size_t depth)
+{
+    if (compareKeys(a, b, depth) < 0)
+    {
+        if (compareKeys(b, c, depth) < 0)
+            return b;
+        return compareKeys(a, c, depth) < 0 ? c : a;
+    }
+    if (compareKeys(a, c, depth) < 0)
+        return a;
+    return compareKeys(b, c, depth) < 0 ? c : b;
+}
+
+/**
+ * @brief Sorts entries[0, count) whose lines are equal up to depth, the prefixes are the ones of depth.
+ */
+static void radixSort(entry_t *entries, size_t count, size_t depth, sortState_t *state)
+{
+    while (count > INSERTION_SORT_MAX)
+    {
+        const entry_t *median = medianOfThree(&entries[0], &entries[count / 2], &entries[count - 1], depth);
+        entry_t pivot = *median;
+
+        // three-way partition: [0, less) < pivot, [less, greater) == pivot, [greater, count) > pivot
+        size_t less = 0, i = 0, greater = count;
+        while (i < greater)
+        {
+            int result = compareKeys(&entries[i], &pivot, depth);
+            if (result < 0)
+                swapEntries(&entries[less++], &entries[i++]);
+            else if (result > 0)
+                swapEntries(&entries[i], &entries[--greater]);
+            else
+                i++;
+        }
+
+        sortPartition(entries, less, depth, state);
+        sortPartition(entries + greater, count - greater, depth, state);
+
+        // equal keys: the lines are equal if they ended within the prefix, otherwise the next 8 bytes decide
+        if (prefixLength(&pivot, depth) < PREFIX_SIZE)
+            return;
+
+        entries += less;
+        count = greater - less;
+        depth += PREFIX_SIZE;
+        for (size_t j = 0; j < count; j++)
+            entries[j].prefix = loadPrefix(entries[j].line, entries[j].length, depth);
+    }
+
+    for (size_t i = 1; i < count; i++)
+    {
+        entry_t current = entries[i];
+        size_t j = i;
+        for (; j > 0 && compareEntries(&current, &entries[j - 1], depth) < 0; j--)
+            entries[j] = entries[j - 1];
+        entries[j] = current;
+    }
+}
+
+int parallelRadixSort(line_t *lines, size_t count, const char *data, threadPool_t *pool)
+{
+    entry_t *entries = malloc((count > 0 ? count : 1) * sizeof(entry_t));
+    if (entries == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const char *line = data + lines[i].offset;
+        entries[i] = (entry_t) {loadPrefix(line, lines[i].length, 0), line, lines[i].length};
+    }
+
+    // a few partitions per worker balance the load, smaller ones are sorted by the worker that made them
+    size_t threads = threadPoolSize(pool);
+    sortState_t state = {threads > 1 ? pool : NULL, count / (4 * threads) + INSERTION_SORT_MAX};
+    radixSort(entries, count, 0, &state);
+    threadPoolWait(pool);
+
+    for (size_t i = 0; i < count; i++)
+        lines[i] = (line_t) {entries[i].line - data, entries[i].length};
+
+    free(entries);
+    return 0;
+}
+//endregion
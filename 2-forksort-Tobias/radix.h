@@ -0,0 +1,33 @@
+/**
+ * @file   radix.h
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief Multikey quicksort of the lines of the engine (-a radix).
+ *
+ * @details Every line is sorted as an entry holding a pointer to it, its length and the next 8 bytes of it
+ * as big-endian number (the prefix), so most comparisons are one integer comparison without touching the line.
+ * The entries are partitioned three ways by the prefix (multikey quicksort); lines with equal prefixes are
+ * sorted by the next 8 bytes, loaded only for them. Small ranges are sorted by insertion sort, which compares
+ * the rest of the lines only if their prefixes are equal.
+ * Large partitions are sorted by the workers of a pool.
+ *
+ * Only equal lines compare equal, so the order is the same as the one of the merge sort.
+ **/
+
+#ifndef RADIX_H
+#define RADIX_H
+
+#include <stddef.h>
+
+#include "engine.h"
+#include "threadpool.h"
+
+/**
+ * @brief Sorts the index of the lines of data with multikey quicksort on the workers of the pool.
+ *
+ * @return 0 upon success, -1 if no memory was left.
+ */
+int parallelRadixSort(line_t *lines, size_t count, const char *data, threadPool_t *pool);
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * @file   threadpool.c
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief A fixed size pool of worker threads executing submitted tasks.
+ **/
+
+#include "threadpool.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+//region TYPES
+/** A submitted task and its argument. */
+typedef struct {
+    task_t task;
+    void *arg;
+} queuedTask_t;
+
+/**
+ * The pool.
+ * queue is a ring buffer of capacity tasks, head is the index of the oldest one.
+ * pending counts the queued tasks plus the ones currently executed.
+ */
+struct threadPool {
+    pthread_t *threads;
+    size_t threadCount;
+
+    queuedTask_t *queue;
+    size_t capacity;
+    size_t head;
+    size_t queued;
+    size_t pending;
+    int stopping;
+
+    pthread_mutex_t lock;
+    pthread_cond_t taskAvailable;
+    pthread_cond_t allDone;
+};
+//endregion
+
+/**
+ * @brief The loop of every worker thread: takes tasks from the queue until the pool is stopped.
+ *
+ * @param arg The pool.
+ * @return Always NULL.
+ */
+static void *work(void *arg)
+{
+    threadPool_t *pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        while (pool->queued == 0 && !pool->stopping)
+            pthread_cond_wait(&pool->taskAvailable, &pool->lock);
+
+        if (pool->queued == 0) // stopping and nothing left to do
+            break;
+
+        queuedTask_t next = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+
+        next.task(next.arg);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            pthread_cond_broadcast(&pool->allDone);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+threadPool_t *threadPoolCreate(size_t threads)
+{
+    if (threads == 0)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    threadPool_t *pool = calloc(1, sizeof(threadPool_t));
+    if (pool == NULL)
+        return NULL;
+
+    pool->threads = malloc(threads * sizeof(pthread_t));
+    pool->capacity = 64;
+    pool->queue = malloc(pool->capacity * sizeof(queuedTask_t));
+    if (pool->threads == NULL || pool->queue == NULL)
+    {
+        free(pool->threads);
+        free(pool->queue);
+        free(pool);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->taskAvailable, NULL);
+    pthread_cond_init(&pool->allDone, NULL);
+
+    for (; pool->threadCount < threads; pool->threadCount++)
+    {
+        int result = pthread_create(&pool->threads[pool->threadCount], NULL, work, pool);
+        if (result != 0)
+        {
+            threadPoolDestroy(pool);
+            errno = result;
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+int threadPoolSubmit(threadPool_t *pool, task_t task, void *arg)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->queued == pool->capacity)
+    {
+        queuedTask_t *bigger = malloc(2 * pool->capacity * sizeof(queuedTask_t));
+        if (bigger == NULL)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            errno = ENOMEM;
+            return -1;
+        }
+
+        // unwrap the ring so the oldest task is at index 0 again
+        for (size_t i = 0; i < pool->queued; i++)
+            bigger[i] = pool->queue[(pool->head + i) % pool->capacity];
+
+        free(pool->queue);
+        pool->queue = bigger;
+        pool->capacity *= 2;
+        pool->head = 0;
+    }
+
+    pool->queue[(pool->head + pool->queued) % pool->capacity] = (queuedTask_t) {task, arg};
+    pool->queued++;
+    pool->pending++;
+    pthread_cond_signal(&pool->taskAvailable);
+
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void threadPoolWait(threadPool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->allDone, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void threadPoolDestroy(threadPool_t *pool)
+{
+    if (pool == NULL)
+        return;
+
+    threadPoolWait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->taskAvailable);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->threadCount; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->taskAvailable);
+    pthread_cond_destroy(&pool->allDone);
+    free(pool->threads);
+    free(pool->queue);
+    free(pool);
+}
+
+size_t threadPoolSize(const threadPool_t *pool)
+{
+    return pool->threadCount;
+}
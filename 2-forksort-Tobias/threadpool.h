@@ -0,0 +1,56 @@
+/**
+ * @file   threadpool.h
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief A fixed size pool of worker threads executing submitted tasks.
+ *
+ * @details Tasks are taken from one shared queue in the order they were submitted.
+ * threadPoolWait blocks until every submitted task completed, so work can be done in rounds
+ * (e.g. one round per merge level) without creating threads again. Tasks may submit further tasks,
+ * threadPoolWait waits for those too.
+ **/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+
+/** A pool of worker threads, see threadPoolCreate. */
+typedef struct threadPool threadPool_t;
+
+/** The function of a task, called with the argument given to threadPoolSubmit. */
+typedef void (*task_t)(void *arg);
+
+/**
+ * @brief Creates a pool with the given number of worker threads.
+ *
+ * @param threads The number of worker threads (at least 1).
+ *
+ * @return The pool or NULL upon failure (errno is set).
+ */
+threadPool_t *threadPoolCreate(size_t threads);
+
+/**
+ * @brief Adds a task to the queue of the pool.
+ *
+ * @return 0 upon success, -1 if no memory was left.
+ */
+int threadPoolSubmit(threadPool_t *pool, task_t task, void *arg);
+
+/**
+ * @brief Blocks until all submitted tasks completed.
+ */
+void threadPoolWait(threadPool_t *pool);
+
+/**
+ * @brief Waits for all submitted tasks, stops the workers and frees the pool.
+ */
+void threadPoolDestroy(threadPool_t *pool);
+
+/**
+ * @brief Returns the number of worker threads of the pool.
+ */
+size_t threadPoolSize(const threadPool_t *pool);
+
+#endif
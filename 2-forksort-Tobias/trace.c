@@ -0,0 +1,100 @@
+/**
+ * @file   trace.c
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief Runtime tracing of forksort processes.
+ **/
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/** The mapped trace file of the process or NULL if it isn't traced. */
+static traceHeader_t *header_g = NULL;
+
+/** The events following the header. */
+static traceEvent_t *events_g = NULL;
+
+void traceInit(void)
+{
+    const char *directory = getenv(TRACE_ENV);
+    if (directory == NULL || *directory == '\0')
+        return;
+
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/%d.trace", directory, (int) getpid()) >= (int) sizeof(path))
+        return;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return;
+
+    size_t size = sizeof(traceHeader_t) + TRACE_CAPACITY * sizeof(traceEvent_t);
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return;
+
+    header_g = map;
+    events_g = (traceEvent_t *) (header_g + 1);
+    memcpy(header_g->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header_g->version = TRACE_VERSION;
+    header_g->pid = getpid();
+    header_g->ppid = getppid();
+    header_g->capacity = TRACE_CAPACITY;
+    header_g->head = 0;
+
+    const char *execBegin = getenv(TRACE_EXEC_ENV);
+    if (execBegin != NULL)
+    {
+        traceSpan(TRACE_EXEC, strtoull(execBegin, NULL, 10), getppid(), 0);
+        unsetenv(TRACE_EXEC_ENV);
+    }
+}
+
+int traceEnabled(void)
+{
+    return header_g != NULL;
+}
+
+uint64_t traceNow(void)
+{
+    if (header_g == NULL)
+        return 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+void traceSpan(traceKind_e kind, uint64_t begin, int32_t peer, uint64_t arg)
+{
+    if (header_g == NULL)
+        return;
+
+    uint64_t end = traceNow();
+    // the workers of the engine may record spans too
+    uint64_t index = __atomic_fetch_add(&header_g->head, 1, __ATOMIC_RELAXED);
+    events_g[index % TRACE_CAPACITY] = (traceEvent_t) {begin, end, arg, kind, peer};
+}
+
+void traceBeforeExec(void)
+{
+    if (header_g == NULL)
+        return;
+
+    // the mapping of the parent is still there until exec, it must not be written to anymore
+    char now[32];
+    snprintf(now, sizeof(now), "%llu", (unsigned long long) traceNow());
+    header_g = NULL;
+    setenv(TRACE_EXEC_ENV, now, 1);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file   trace.h
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief Runtime tracing of forksort processes.
+ *
+ * @details Tracing is enabled by setting the environment variable FORKSORT_TRACE to a directory, every process
+ * (children inherit the variable) then records its spans into <directory>/<pid>.trace. The file is a mapped
+ * ring buffer of fixed size: a header (traceHeader_t) followed by TRACE_CAPACITY events (traceEvent_t), in host
+ * byte order. The oldest events are overwritten once it is full, the events are on disk even if the process
+ * crashes. Timestamps are CLOCK_MONOTONIC nanoseconds, which are comparable between processes.
+ * tracemerge.py converts the files of a directory into one Chrome trace / Perfetto JSON file.
+ *
+ * Without FORKSORT_TRACE every function returns right away.
+ **/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/** The environment variable naming the trace directory. */
+#define TRACE_ENV "FORKSORT_TRACE"
+/** The environment variable handing the start of an exec to the new program. */
+#define TRACE_EXEC_ENV "FORKSORT_TRACE_EXEC"
+
+#define TRACE_MAGIC    "FSTRACE"
+#define TRACE_VERSION  1
+#define TRACE_CAPACITY 4096
+
+/** The kinds of spans. peer is the child (fork, wait) or the parent (exec). */
+typedef enum {
+    TRACE_FORK = 1,
+    TRACE_EXEC = 2,
+    TRACE_READ = 3,
+    TRACE_MERGE = 4,
+    TRACE_WRITE = 5,
+    TRACE_SORT = 6,
+    TRACE_WAIT = 7
+} traceKind_e;
+
+/** The header of a trace file. head is the number of events ever recorded. */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    int32_t pid;
+    int32_t ppid;
+    uint32_t capacity;
+    uint64_t head;
+} traceHeader_t;
+
+/** A span: begin and end in nanoseconds, its kind, the other process and a number (e.g. lines or bytes). */
+typedef struct {
+    uint64_t begin;
+    uint64_t end;
+    uint64_t arg;
+    uint32_t kind;
+    int32_t peer;
+} traceEvent_t;
+
+/**
+ * @brief Creates the trace file of the process if FORKSORT_TRACE is set.
+ * @details If the process was started by a traced exec (FORKSORT_TRACE_EXEC) the exec span is recorded.
+ * Failing to create the file disables tracing, it never terminates the program.
+ */
+void traceInit(void);
+
+/** @brief Returns whether the process is traced. */
+int traceEnabled(void);
+
+/** @brief Returns the current CLOCK_MONOTONIC time in nanoseconds (0 if the process isn't traced). */
+uint64_t traceNow(void);
+
+/**
+ * @brief Records a span from begin (see traceNow) until now.
+ */
+void traceSpan(traceKind_e kind, uint64_t begin, int32_t peer, uint64_t arg);
+
+/**
+ * @brief To be called in a child right before exec: hands the current time to the new program,
+ * which records the exec span.
+ */
+void traceBeforeExec(void);
+
+#endif
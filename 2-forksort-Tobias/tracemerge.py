@@ -0,0 +1,106 @@
+import argparse
+import json
+import os
+import struct
+import sys
+
+
+# Merge the trace files forksort writes into FORKSORT_TRACE (see trace.h) into
+# one Chrome trace / Perfetto JSON file: every process is a track, every span a
+# complete event, forks are connected to the exec of the child by a flow arrow.
+# Open the result in https://ui.perfetto.dev or chrome://tracing.
+HEADER = struct.Struct("=8sIiiIQ")
+EVENT = struct.Struct("=QQQIi")
+MAGIC = b"FSTRACE\0"
+VERSION = 1
+KINDS = {1: "fork", 2: "exec", 3: "read", 4: "merge", 5: "write", 6: "sort", 7: "wait"}
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Merge forksort trace files into Chrome trace / Perfetto JSON"
+    )
+    parser.add_argument("directory", help="the directory FORKSORT_TRACE pointed to")
+    parser.add_argument(
+        "-o", "--output", default="-", help="output file (default: stdout)"
+    )
+    args = parser.parse_args()
+
+    processes = []
+    for name in sorted(os.listdir(args.directory)):
+        if name.endswith(".trace"):
+            process = read_trace(os.path.join(args.directory, name))
+            if process is not None:
+                processes.append(process)
+    if not processes:
+        sys.exit(f"no trace files in {args.directory}")
+
+    start = min((e[0] for _, _, events in processes for e in events), default=0)
+    trace = []
+    for pid, ppid, events in processes:
+        trace.append(metadata(pid, "process_name", {"name": f"forksort {pid}"}))
+        trace.append(metadata(pid, "process_labels", {"labels": f"parent {ppid}"}))
+        trace.append(metadata(pid, "process_sort_index", {"sort_index": pid}))
+        for begin, end, arg, kind, peer in events:
+            name = KINDS.get(kind, f"kind {kind}")
+            trace.append(
+                {
+                    "name": name,
+                    "ph": "X",
+                    "pid": pid,
+                    "tid": pid,
+                    "ts": (begin - start) / 1000,
+                    "dur": (end - begin) / 1000,
+                    "args": {"peer": peer, "arg": arg},
+                }
+            )
+            # an arrow from the fork in the parent to the exec in the child
+            if name in ("fork", "exec"):
+                child = peer if name == "fork" else pid
+                trace.append(
+                    {
+                        "name": "spawn",
+                        "cat": "fork",
+                        "ph": "s" if name == "fork" else "f",
+                        "bp": "e",
+                        "id": child,
+                        "pid": pid,
+                        "tid": pid,
+                        "ts": (begin - start) / 1000 if name == "fork" else (end - start) / 1000,
+                    }
+                )
+
+    output = sys.stdout if args.output == "-" else open(args.output, "w")
+    json.dump({"traceEvents": trace, "displayTimeUnit": "ns"}, output)
+    if output is not sys.stdout:
+        output.close()
+
+
+# Return (pid, ppid, events) of a trace file, the events oldest first, or None
+# if the file isn't a trace file of this version
+def read_trace(path: str):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER.size:
+        return None
+    magic, version, pid, ppid, capacity, head = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        print(f"skipping {path}: not a forksort trace", file=sys.stderr)
+        return None
+
+    # the ring holds the last capacity events, the oldest one at head % capacity
+    count = min(head, capacity)
+    first = head - count
+    events = []
+    for i in range(first, head):
+        offset = HEADER.size + (i % capacity) * EVENT.size
+        events.append(EVENT.unpack_from(data, offset))
+    return pid, ppid, events
+
+
+def metadata(pid: int, name: str, args: dict) -> dict:
+    return {"name": name, "ph": "M", "pid": pid, "tid": pid, "args": args}
+
+
+if __name__ == "__main__":
+    main()
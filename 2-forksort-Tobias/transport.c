@@ -0,0 +1,97 @@
+/**
+ * @file   transport.c
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The shared memory transport of the process tree (-z).
+ **/
+
+// memfd_create is a GNU extension
+#define _GNU_SOURCE
+
+#include "transport.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+int sharedFileCreate(const char *name)
+{
+    int fd;
+#ifdef MFD_CLOEXEC
+    fd = memfd_create(name, MFD_CLOEXEC);
+    if (fd != -1 || errno != ENOSYS)
+        return fd;
+#endif
+
+    const char *directory = getenv("TMPDIR");
+    if (directory == NULL || *directory == '\0')
+        directory = "/tmp";
+
+    size_t length = strlen(directory) + strlen(name) + sizeof("/-XXXXXX");
+    char *path = malloc(length);
+    if (path == NULL)
+        return -1;
+    snprintf(path, length, "%s/%s-XXXXXX", directory, name);
+
+    fd = mkstemp(path);
+    if (fd != -1)
+    {
+        unlink(path);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    free(path);
+    return fd;
+}
+
+int sharedFileWrite(int fd, const char *bytes, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = write(fd, bytes, size);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        bytes += n;
+        size -= n;
+    }
+
+    return lseek(fd, 0, SEEK_SET) == -1 ? -1 : 0;
+}
+
+int writeMerged(FILE *out, const char *aData, const line_t *aLines, size_t aCount,
+                const char *bData, const line_t *bLines, size_t bCount)
+{
+    size_t i = 0, j = 0;
+    while (i < aCount || j < bCount)
+    {
+        const char *record;
+        size_t length;
+        if (j == bCount || (i < aCount && compareRecords(aData + aLines[i].offset, aLines[i].length,
+                                                         bData + bLines[j].offset, bLines[j].length) <= 0))
+        {
+            record = aData + aLines[i].offset;
+            length = aLines[i++].length;
+        }
+        else
+        {
+            record = bData + bLines[j].offset;
+            length = bLines[j++].length;
+        }
+
+        if (fwrite(record, 1, length, out) != length)
+            return -1;
+        // both children had at least one line, so there are always two or more
+        if (putc(i + j < aCount + bCount ? '\n' : '\0', out) == EOF)
+            return -1;
+    }
+
+    return fflush(out);
+}
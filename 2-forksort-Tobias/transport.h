@@ -0,0 +1,46 @@
+/**
+ * @file   transport.h
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The shared memory transport of the process tree (-z).
+ *
+ * @details Instead of pipes every child gets two shared files (memfd): its input and its output, which
+ * become its stdin and stdout. The parent hands over the lines of a child with one write of a contiguous block
+ * of its own input, the child maps it (see arenaLoad) and writes its sorted lines through one large buffer.
+ * After the children terminated the parent maps their outputs and merges them. No line is read or written
+ * with a system call of its own.
+ **/
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "engine.h"
+
+/**
+ * @brief Creates a shared file in memory (memfd, closed on exec).
+ * @details Falls back to an unlinked temporary file if memfd_create isn't supported.
+ *
+ * @return The file descriptor or -1 upon failure (errno is set).
+ */
+int sharedFileCreate(const char *name);
+
+/**
+ * @brief Writes all bytes to the shared file and rewinds it.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int sharedFileWrite(int fd, const char *bytes, size_t size);
+
+/**
+ * @brief Merges the sorted lines of two children and writes them in the format of the process tree.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int writeMerged(FILE *out, const char *aData, const line_t *aLines, size_t aCount,
+                const char *bData, const line_t *bLines, size_t bCount);
+
+#endif
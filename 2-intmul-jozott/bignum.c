@@ -0,0 +1,124 @@
+/**
+ * @project: Integer Multiplication
+ * @module bignum
+ * @author Johannes Zottele 11911133
+ * @version 1.0
+ * @date 18.12.2020
+ * @section File Overview
+ * bignum stores big hex numbers as arrays of 64 bit limbs, so an addition handles 16 hex digits at once.
+ */
+
+#include <string.h>
+
+#include "bignum.h"
+
+/**
+ * @brief Returns the value of a hex character (the input is validated before).
+ */
+static uint64_t hexValue(char c)
+{
+    if (c >= 'a')
+        return c - 'a' + 10;
+    if (c >= 'A')
+        return c - 'A' + 10;
+    return c - '0';
+}
+
+int createBignum(bignum_t *n, size_t size)
+{
+    n->size = size;
+    n->limbs = calloc(size > 0 ? size : 1, sizeof(uint64_t));
+    return n->limbs == NULL ? -1 : 0;
+}
+
+int hexToBignum(bignum_t *n, char *hex, size_t len)
+{
+    if (createBignum(n, (len + LIMB_DIGITS - 1) / LIMB_DIGITS) == -1)
+        return -1;
+
+    // the last character is the least significant digit
+    for (size_t i = 0; i < len; i++)
+    {
+        uint64_t value = hexValue(hex[len - 1 - i]);
+        n->limbs[i / LIMB_DIGITS] |= value << (4 * (i % LIMB_DIGITS));
+    }
+    return 0;
+}
+
+void addShiftedBignum(bignum_t *result, bignum_t *a, size_t digits)
+{
+    size_t offset = digits / LIMB_DIGITS;
+    unsigned int shift = 4 * (digits % LIMB_DIGITS);
+
+    // limb i of the shifted number consists of the limbs i and i-1 of a
+    uint64_t carry = 0;
+    uint64_t previous = 0;
+    size_t i = offset;
+    for (size_t j = 0; j <= a->size && i < result->size; j++, i++)
+    {
+        uint64_t current = j < a->size ? a->limbs[j] : 0;
+        uint64_t limb = shift == 0 ? current : (current << shift) | (previous >> (64 - shift));
+        previous = current;
+
+        uint64_t sum;
+        uint64_t c1 = __builtin_add_overflow(result->limbs[i], limb, &sum);
+        uint64_t c2 = __builtin_add_overflow(sum, carry, &result->limbs[i]);
+        carry = c1 | c2;
+    }
+
+    for (; carry != 0 && i < result->size; i++)
+        carry = __builtin_add_overflow(result->limbs[i], carry, &result->limbs[i]);
+}
+
+int mulBignum(bignum_t *result, bignum_t *a, bignum_t *b)
+{
+    if (createBignum(result, a->size + b->size) == -1)
+        return -1;
+
+    // the product of two limbs has 128 bits
+    __extension__ typedef unsigned __int128 product_t;
+    for (size_t i = 0; i < a->size; i++)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b->size; j++)
+        {
+            product_t product = (product_t)a->limbs[i] * b->limbs[j] + result->limbs[i + j] + carry;
+            result->limbs[i + j] = (uint64_t)product;
+            carry = (uint64_t)(product >> 64);
+        }
+        result->limbs[i + b->size] = carry;
+    }
+    return 0;
+}
+
+char *bignumToHex(bignum_t *n, size_t minDigits)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    // number of significant digits
+    size_t digits = n->size * LIMB_DIGITS;
+    while (digits > 0 && ((n->limbs[(digits - 1) / LIMB_DIGITS] >> (4 * ((digits - 1) % LIMB_DIGITS))) & 0xf) == 0)
+        digits--;
+    if (digits < minDigits)
+        digits = minDigits;
+
+    char *hex = malloc(digits + 1);
+    if (hex == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < digits; i++)
+    {
+        size_t limb = i / LIMB_DIGITS;
+        uint64_t value = limb < n->size ? n->limbs[limb] >> (4 * (i % LIMB_DIGITS)) : 0;
+        hex[digits - 1 - i] = hexDigits[value & 0xf];
+    }
+    hex[digits] = '\0';
+    return hex;
+}
+
+void freeBignum(bignum_t *n)
+{
+    free(n->limbs);
+    n->limbs = NULL;
+    n->size = 0;
+}
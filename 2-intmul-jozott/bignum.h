@@ -0,0 +1,58 @@
+/**
+ * @project: Integer Multiplication
+ * @module bignum
+ * @author Johannes Zottele 11911133
+ * @version 1.0
+ * @date 18.12.2020
+ * @section File Overview
+ * bignum stores big hex numbers as arrays of 64 bit limbs (16 hex digits each, least significant first).
+ * The numbers are converted from hex once, added limb by limb and converted back to hex once.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @brief Number of hex digits in one limb.
+ */
+#define LIMB_DIGITS 16
+
+/**
+ * @brief A big number with size limbs, the least significant limb first.
+ */
+typedef struct
+{
+    uint64_t *limbs;
+    size_t size;
+} bignum_t;
+
+/**
+ * @brief Creates a big number of size limbs which are all zero. Uses calloc for the limbs.
+ */
+int createBignum(bignum_t *n, size_t size);
+
+/**
+ * @brief Converts the first len characters of the hex string into a big number. Uses calloc for the limbs.
+ */
+int hexToBignum(bignum_t *n, char *hex, size_t len);
+
+/**
+ * @brief Adds a * 16^digits to result (a carry out of the last limb of result is dropped).
+ */
+void addShiftedBignum(bignum_t *result, bignum_t *a, size_t digits);
+
+/**
+ * @brief Multiplies a and b limb by limb (schoolbook method) into result. Uses calloc for the a->size + b->size limbs of result.
+ */
+int mulBignum(bignum_t *result, bignum_t *a, bignum_t *b);
+
+/**
+ * @brief Converts the big number to a lowercase hex string with at least minDigits digits (leading zeros are added).
+ * Uses malloc for the created string
+ */
+char *bignumToHex(bignum_t *n, size_t minDigits);
+
+/**
+ * @brief Frees the limbs of the big number.
+ */
+void freeBignum(bignum_t *n);
@@ -6,6 +6,7 @@
  * @date 15.12.2020
  * @section File Overview
  * hexcalc is responsible for calculate the result of the combination of each child process.
+ * The child results are converted to big numbers (see bignum.h) once, added and converted back once.
  */
 
 #include <stdlib.h>
@@ -15,6 +16,7 @@
 #include <errno.h>
 
 #include "hexcalc.h"
+#include "bignum.h"
 
 #define EXIT_ERR(msg, iserrno)                                                                           \
     {                                                                                                    \
@@ -26,93 +28,49 @@
     }
 
 /**
- * @brief Adds a, b, and the overflow of the early addition.
- * The overlow is stored in the overflow pointer
- * 
- * @return The character which represents the result for this digit.
+ * @brief Converts a child result to a big number and adds it shifted by the given number of hex digits.
  */
-static char addHexChar(char a, char b, char *overflow)
+static void addChildResult(bignum_t *result, char *hex, size_t digits)
 {
-    char sa[] = {a, '\0'};
-    char sb[] = {b, '\0'};
+    bignum_t child;
+    if (hexToBignum(&child, hex, strlen(hex)) == -1)
+        EXIT_ERR("Could not allocate memory", 1);
 
-    long ia = strtol(sa, NULL, 16);
-    long ib = strtol(sb, NULL, 16);
-    long io = strtol(overflow, NULL, 16);
-    long sum = ia + ib + io;
-
-    //new overflow
-    int no = (int)sum / 16;
-    sprintf(overflow, "%x", no);
-
-    int result = sum % 16;
-    char sres[] = {' ', '\0'};
-    sprintf(sres, "%x", result);
-
-    return sres[0];
-}
-
-/**
- * @brief Adds two strings (hex base) bye iterating from back to front
- * and using the addHexChar() function.
- * 
- * The result is stored in the first operand.
- */
-static void addHexString(char *result, char *b)
-{
-    size_t count = strlen(result);
-    int diff = count - strlen(b);
-
-    char overflow[] = {'0', '\0'};
-
-    for (int i = count - 1; i >= 0; i--)
-    {
-        char cb = i - diff >= 0 ? b[i - diff] : '0';
-        char r = addHexChar(result[i], cb, overflow);
-        result[i] = r;
-    }
-
-    if (overflow[0] != '0')
-    {
-        if ((result = realloc(result, count + 1)) == NULL)
-            EXIT_ERR("Could not reallocate memory", 1);
-
-        // memcpy(result + 1, result, count);
-        strcpy(result + 1, result);
-        result[0] = overflow[0];
-        result[count + 1] = '\0';
-    }
-}
-
-/**
- * @brief adds zeros to the tail of a string. The number is given by the count.
- */
-static void addZerosToHex(char **a, size_t count)
-{
-    size_t len = strlen(*a);
-    size_t total = len + count;
-    char *result = malloc(total + 1 * sizeof(char));
-    memset(result, '0', total);
-    memcpy(result, *a, len);
-    result[total] = '\0';
-
-    *a = result;
+    addShiftedBignum(result, &child, digits);
+    freeBignum(&child);
 }
 
 int calcQuadResult(char **hh, char *hl, char *lh, char *ll, size_t len)
 {
-
-    addZerosToHex(hh, len);
-    addZerosToHex(&hl, len / 2);
-    addZerosToHex(&lh, len / 2);
-
-    addHexString(*hh, hl);
-    addHexString(*hh, lh);
-    addHexString(*hh, ll);
-
+    size_t hhlen = strlen(*hh) + len;
+
+    // enough limbs for every shifted child result and the carry of the additions
+    size_t digits = hhlen;
+    if (strlen(hl) + len / 2 > digits)
+        digits = strlen(hl) + len / 2;
+    if (strlen(lh) + len / 2 > digits)
+        digits = strlen(lh) + len / 2;
+    if (strlen(ll) > digits)
+        digits = strlen(ll);
+
+    bignum_t result;
+    if (createBignum(&result, digits / LIMB_DIGITS + 1) == -1)
+        EXIT_ERR("Could not allocate memory", 1);
+
+    addChildResult(&result, *hh, len);
+    addChildResult(&result, hl, len / 2);
+    addChildResult(&result, lh, len / 2);
+    addChildResult(&result, ll, 0);
+
+    free(*hh);
     free(hl);
     free(lh);
+    free(ll);
+
+    // the result has at least as many digits as hh shifted by len
+    if ((*hh = bignumToHex(&result, hhlen)) == NULL)
+        EXIT_ERR("Could not allocate memory", 1);
+    freeBignum(&result);
 
-    size_t hhlen = strlen(*hh);
-    return hhlen;
-}
\ No newline at end of file
+    return strlen(*hh);
+}
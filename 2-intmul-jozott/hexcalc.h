@@ -12,5 +12,9 @@
 
 /**
  * @brief The function manages the procedure of the result calculation of all child processes.
+ * 
+ * @details Computes hh * 16^len + (hl + lh) * 16^(len/2) + ll. The result replaces *hh, hl, lh and ll are freed.
+ * 
+ * @return The length of the result.
  */
 int calcQuadResult(char **hh, char *hl, char *lh, char *ll, size_t len);
\ No newline at end of file
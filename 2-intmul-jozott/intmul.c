@@ -19,6 +19,7 @@
 
 #include "hexcalc.h"
 #include "treerep.h"
+#include "taskmul.h"
 
 #define EXIT_ERR(msg, iserrno)                                                                           \
     {                                                                                                    \
@@ -36,6 +37,8 @@ int pipeout[4][2];
 
 int treerep;
 
+int parallel;
+
 /**
  * @brief Handles the waiting for all child processes.
  * 
@@ -246,12 +249,17 @@ static void fork_and_pipe(int hexlen, char *A, char *B)
  * Last but not least, the result is printed to stdout.
  * 
  * If the flag "-t" is set, an treerepresentation of all child processes is printed instead of the result. It ueses process_to_string() and read_and_print() from treerep.c 
+ * 
+ * If the flag "-p" is set, no child processes are created, multiplyParallel() from taskmul.c multiplies on a thread pool.
  */
 int main(int argc, char *argv[])
 {
     treerep = 0;
+    parallel = 0;
     if (argc > 1 && strcmp(argv[1], "-t") == 0)
         treerep = 1;
+    else if (argc > 1 && strcmp(argv[1], "-p") == 0)
+        parallel = 1;
 
     char *A;
     char *B;
@@ -261,6 +269,18 @@ int main(int argc, char *argv[])
     A[hexlen] = '\0';
     B[hexlen] = '\0';
 
+    if (parallel)
+    {
+        char *result = multiplyParallel(A, B, hexlen);
+        fprintf(stdout, "%s\n", result);
+        fflush(stdout);
+
+        free(result);
+        free(A);
+        free(B);
+        exit(EXIT_SUCCESS);
+    }
+
     char *pname;
     if (treerep)
         process_to_string(&pname, A, B);
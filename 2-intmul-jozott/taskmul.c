@@ -0,0 +1,114 @@
+/**
+ * @project: Integer Multiplication
+ * @module taskmul
+ * @author Johannes Zottele 11911133
+ * @version 1.0
+ * @date 19.12.2020
+ * @section File Overview
+ * taskmul multiplies like the tree of child processes, but every subproblem is a task on a thread pool.
+ * The tasks point into the input strings, the results are big numbers (see bignum.h) and are added like in hexcalc.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "taskmul.h"
+#include "threadpool.h"
+#include "bignum.h"
+
+#define EXIT_ERR(msg, iserrno)                                                                           \
+    {                                                                                                    \
+        if (iserrno == 1)                                                                                \
+            (void)fprintf(stderr, "[%s:%d] ERROR: " msg " : %s\n", __FILE__, __LINE__, strerror(errno)); \
+        else                                                                                             \
+            (void)fprintf(stderr, "[%s:%d] ERROR: " msg "\n", __FILE__, __LINE__);                       \
+        exit(EXIT_FAILURE);                                                                              \
+    }
+
+/**
+ * @brief The multiplication of the hex numbers a (alen digits) and b (blen digits).
+ */
+typedef struct
+{
+    task_t task;
+    char *a;
+    size_t alen;
+    char *b;
+    size_t blen;
+    bignum_t result;
+} mulTask_t;
+
+/**
+ * @brief Multiplies a small subproblem in this thread.
+ */
+static void multiplySequential(mulTask_t *t)
+{
+    bignum_t a, b;
+    if (hexToBignum(&a, t->a, t->alen) == -1 || hexToBignum(&b, t->b, t->blen) == -1 ||
+        mulBignum(&t->result, &a, &b) == -1)
+        EXIT_ERR("Could not allocate memory", 1);
+
+    freeBignum(&a);
+    freeBignum(&b);
+}
+
+/**
+ * @brief Splits the numbers into halves like fork_and_pipe() and multiplies them in 4 tasks.
+ * 
+ * @details With A = Ah * 16^al + Al and B = Bh * 16^bl + Bl the result is
+ * Ah*Bh * 16^(al+bl) + Ah*Bl * 16^al + Al*Bh * 16^bl + Al*Bl.
+ * 3 tasks are submitted (other threads may steal them), Ah*Bh is computed by this thread before it waits for the others.
+ */
+static void multiplyTask(task_t *task, worker_t *worker)
+{
+    mulTask_t *t = (mulTask_t *)task;
+    if ((t->alen <= PARALLEL_CUTOFF && t->blen <= PARALLEL_CUTOFF) || t->alen < 2 || t->blen < 2)
+    {
+        multiplySequential(t);
+        return;
+    }
+
+    size_t ah = t->alen / 2, al = t->alen - ah;
+    size_t bh = t->blen / 2, bl = t->blen - bh;
+
+    mulTask_t parts[4] = {
+        {{multiplyTask, 0}, t->a, ah, t->b, bh, {NULL, 0}},
+        {{multiplyTask, 0}, t->a, ah, t->b + bh, bl, {NULL, 0}},
+        {{multiplyTask, 0}, t->a + ah, al, t->b, bh, {NULL, 0}},
+        {{multiplyTask, 0}, t->a + ah, al, t->b + bh, bl, {NULL, 0}}};
+    size_t shifts[4] = {al + bl, al, bl, 0};
+
+    for (int i = 1; i < 4; i++)
+        submitTask(worker, &parts[i].task);
+    multiplyTask(&parts[0].task, worker);
+    for (int i = 1; i < 4; i++)
+        waitForTask(worker, &parts[i].task);
+
+    if (createBignum(&t->result, (t->alen + t->blen) / LIMB_DIGITS + 1) == -1)
+        EXIT_ERR("Could not allocate memory", 1);
+
+    for (int i = 0; i < 4; i++)
+    {
+        addShiftedBignum(&t->result, &parts[i].result, shifts[i]);
+        freeBignum(&parts[i].result);
+    }
+}
+
+char *multiplyParallel(char *A, char *B, size_t len)
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    threadPool_t *pool = createThreadPool(processors > 0 ? processors : 1);
+
+    mulTask_t root = {{multiplyTask, 0}, A, len, B, len, {NULL, 0}};
+    runTask(pool, &root.task);
+    destroyThreadPool(pool);
+
+    char *result = bignumToHex(&root.result, 1);
+    if (result == NULL)
+        EXIT_ERR("Could not allocate memory", 1);
+
+    freeBignum(&root.result);
+    return result;
+}
@@ -0,0 +1,24 @@
+/**
+ * @project: Integer Multiplication
+ * @module taskmul
+ * @author Johannes Zottele 11911133
+ * @version 1.0
+ * @date 19.12.2020
+ * @section File Overview
+ * taskmul multiplies like the tree of child processes, but every subproblem is a task on a thread pool (see threadpool.h)
+ * working on the numbers in shared memory instead of a process reading them from a pipe.
+ */
+
+#include <stdlib.h>
+
+/**
+ * @brief Below this number of hex digits a task multiplies the numbers itself instead of splitting them into 4 tasks.
+ */
+#define PARALLEL_CUTOFF 1024
+
+/**
+ * @brief Multiplies the hex numbers A and B (both of length len) on a pool with one thread per processor.
+ * 
+ * @return The result as lowercase hex string without leading zeros. Uses malloc for the created string
+ */
+char *multiplyParallel(char *A, char *B, size_t len);
@@ -0,0 +1,216 @@
+/**
+ * @project: Integer Multiplication
+ * @module threadpool
+ * @author Johannes Zottele 11911133
+ * @version 1.0
+ * @date 19.12.2020
+ * @section File Overview
+ * threadpool is a work stealing pool of threads for recursive tasks. The tasks are coarse, so all deques share one mutex.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "threadpool.h"
+
+#define EXIT_ERR(msg, iserrno)                                                                           \
+    {                                                                                                    \
+        if (iserrno == 1)                                                                                \
+            (void)fprintf(stderr, "[%s:%d] ERROR: " msg " : %s\n", __FILE__, __LINE__, strerror(errno)); \
+        else                                                                                             \
+            (void)fprintf(stderr, "[%s:%d] ERROR: " msg "\n", __FILE__, __LINE__);                       \
+        exit(EXIT_FAILURE);                                                                              \
+    }
+
+/**
+ * @brief The deque of one thread, a ring buffer where head is the oldest task.
+ */
+typedef struct
+{
+    task_t **tasks;
+    size_t capacity;
+    size_t head;
+    size_t count;
+} deque_t;
+
+struct threadPool
+{
+    pthread_t *threads;
+    worker_t *workers;
+    deque_t *deques;
+    size_t size;
+    int stopping;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+/**
+ * @brief Takes the newest task of the own deque or steals the oldest task of another one. The lock has to be held.
+ * 
+ * @return The task or NULL if all deques are empty.
+ */
+static task_t *takeTask(threadPool_t *pool, size_t index)
+{
+    deque_t *own = &pool->deques[index];
+    if (own->count > 0)
+    {
+        own->count--;
+        return own->tasks[(own->head + own->count) % own->capacity];
+    }
+
+    for (size_t i = 1; i < pool->size; i++)
+    {
+        deque_t *victim = &pool->deques[(index + i) % pool->size];
+        if (victim->count > 0)
+        {
+            task_t *task = victim->tasks[victim->head];
+            victim->head = (victim->head + 1) % victim->capacity;
+            victim->count--;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs the task without holding the lock and marks it as done. The lock has to be held.
+ */
+static void runTaken(worker_t *worker, task_t *task)
+{
+    pthread_mutex_unlock(&worker->pool->lock);
+    task->function(task, worker);
+    pthread_mutex_lock(&worker->pool->lock);
+
+    task->done = 1;
+    pthread_cond_broadcast(&worker->pool->changed);
+}
+
+/**
+ * @brief The loop of the threads 1 to size-1, runs tasks until the pool is stopped.
+ */
+static void *work(void *arg)
+{
+    worker_t *worker = arg;
+    threadPool_t *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping)
+    {
+        task_t *task = takeTask(pool, worker->index);
+        if (task != NULL)
+            runTaken(worker, task);
+        else
+            pthread_cond_wait(&pool->changed, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+threadPool_t *createThreadPool(size_t threads)
+{
+    threadPool_t *pool = calloc(1, sizeof(threadPool_t));
+    if (pool == NULL)
+        EXIT_ERR("Could not allocate memory", 1);
+
+    pool->size = threads > 0 ? threads : 1;
+    pool->threads = calloc(pool->size, sizeof(pthread_t));
+    pool->workers = calloc(pool->size, sizeof(worker_t));
+    pool->deques = calloc(pool->size, sizeof(deque_t));
+    if (pool->threads == NULL || pool->workers == NULL || pool->deques == NULL)
+        EXIT_ERR("Could not allocate memory", 1);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->changed, NULL);
+
+    for (size_t i = 0; i < pool->size; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+    }
+
+    // thread 0 is the one calling runTask
+    for (size_t i = 1; i < pool->size; i++)
+    {
+        if ((errno = pthread_create(&pool->threads[i], NULL, work, &pool->workers[i])) != 0)
+            EXIT_ERR("Could not create thread", 1);
+    }
+
+    return pool;
+}
+
+void runTask(threadPool_t *pool, task_t *task)
+{
+    task->done = 0;
+    task->function(task, &pool->workers[0]);
+    task->done = 1;
+}
+
+void submitTask(worker_t *worker, task_t *task)
+{
+    threadPool_t *pool = worker->pool;
+    deque_t *deque = &pool->deques[worker->index];
+    task->done = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    if (deque->count == deque->capacity)
+    {
+        size_t capacity = deque->capacity > 0 ? 2 * deque->capacity : 16;
+        task_t **bigger = malloc(capacity * sizeof(task_t *));
+        if (bigger == NULL)
+            EXIT_ERR("Could not allocate memory", 1);
+
+        // the oldest task is at index 0 again
+        for (size_t i = 0; i < deque->count; i++)
+            bigger[i] = deque->tasks[(deque->head + i) % deque->capacity];
+
+        free(deque->tasks);
+        deque->tasks = bigger;
+        deque->capacity = capacity;
+        deque->head = 0;
+    }
+
+    deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+    deque->count++;
+    pthread_cond_signal(&pool->changed);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void waitForTask(worker_t *worker, task_t *task)
+{
+    threadPool_t *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!task->done)
+    {
+        task_t *next = takeTask(pool, worker->index);
+        if (next != NULL)
+            runTaken(worker, next);
+        else
+            pthread_cond_wait(&pool->changed, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void destroyThreadPool(threadPool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->changed);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 1; i < pool->size; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->changed);
+    for (size_t i = 0; i < pool->size; i++)
+        free(pool->deques[i].tasks);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,60 @@
+/**
+ * @project: Integer Multiplication
+ * @module threadpool
+ * @author Johannes Zottele 11911133
+ * @version 1.0
+ * @date 19.12.2020
+ * @section File Overview
+ * threadpool is a work stealing pool of threads for recursive tasks. Every thread has its own deque of tasks,
+ * it takes the newest task of its own deque and steals the oldest task of another deque if its own is empty.
+ * A thread waiting for a task runs other tasks in the meantime, so tasks can wait for the tasks they submitted.
+ */
+
+#include <stdlib.h>
+
+typedef struct threadPool threadPool_t;
+
+/**
+ * @brief The thread running a task.
+ */
+typedef struct
+{
+    threadPool_t *pool;
+    size_t index;
+} worker_t;
+
+typedef struct task task_t;
+
+/**
+ * @brief A task, it is the first member of a struct with the arguments (the function casts the pointer back).
+ */
+struct task
+{
+    void (*function)(task_t *task, worker_t *worker);
+    int done;
+};
+
+/**
+ * @brief Creates a pool with the given number of threads (the thread calling runTask included).
+ */
+threadPool_t *createThreadPool(size_t threads);
+
+/**
+ * @brief Runs the task in the calling thread (as worker 0) and returns when it is done.
+ */
+void runTask(threadPool_t *pool, task_t *task);
+
+/**
+ * @brief Adds the task to the deque of the worker, other threads may steal it.
+ */
+void submitTask(worker_t *worker, task_t *task);
+
+/**
+ * @brief Runs tasks until the given task is done.
+ */
+void waitForTask(worker_t *worker, task_t *task);
+
+/**
+ * @brief Stops all threads and frees the pool.
+ */
+void destroyThreadPool(threadPool_t *pool);
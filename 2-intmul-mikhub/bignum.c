@@ -0,0 +1,338 @@
+#include "bignum.h"
+#include "ntt.h"
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file bignum.c
+ * @author Michael Huber 11712763
+ * @date 20.12.2020
+ * @brief Unsigned big integers stored as arrays of 64-bit limbs
+ */
+
+/** Double limb for the products of two limbs */
+__extension__ typedef unsigned __int128 dlimb_t;
+
+/**
+ * @brief Converts a hex char to the corresponding integer (the input is validated before)
+ */
+static limb_t hexvalue(char c) {
+    if (c >= 'a') return c - 'a' + 10;
+    if (c >= 'A') return c - 'A' + 10;
+    return c - '0';
+}
+
+int bignum_init(bignum_t* n, size_t size) {
+    n->size = size;
+    n->limbs = calloc(size > 0 ? size : 1, sizeof(limb_t));
+    return n->limbs == NULL ? -1 : 0;
+}
+
+int bignum_from_hex(bignum_t* n, const char* hex, size_t len) {
+    n->size = (len + LIMB_HEX_DIGITS - 1) / LIMB_HEX_DIGITS;
+    n->limbs = calloc(n->size > 0 ? n->size : 1, sizeof(limb_t));
+    if (n->limbs == NULL) {
+        return -1;
+    }
+
+    // limb i holds the digits len-16(i+1) to len-16i-1
+    for (size_t i = 0; i < len; i++) {
+        size_t position = len - 1 - i;
+        n->limbs[i / LIMB_HEX_DIGITS] |= hexvalue(hex[position]) << (4 * (i % LIMB_HEX_DIGITS));
+    }
+    return 0;
+}
+
+char* bignum_to_hex(const bignum_t* n, size_t digits) {
+    static const char hexdigits[] = "0123456789abcdef";
+
+    char* hex = malloc(digits + 1);
+    if (hex == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < digits; i++) {
+        size_t limb = i / LIMB_HEX_DIGITS;
+        limb_t value = limb < n->size ? n->limbs[limb] >> (4 * (i % LIMB_HEX_DIGITS)) : 0;
+        hex[digits - 1 - i] = hexdigits[value & 0xf];
+    }
+    hex[digits] = '\0';
+    return hex;
+}
+
+void bignum_free(bignum_t* n) {
+    free(n->limbs);
+    n->limbs = NULL;
+    n->size = 0;
+}
+
+/**
+ * @brief r = a + b for n limbs each
+ * @return The carry out of the top limb
+ */
+static limb_t add_n(limb_t* r, const limb_t* a, const limb_t* b, size_t n) {
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        limb_t sum;
+        limb_t c1 = __builtin_add_overflow(a[i], b[i], &sum);
+        limb_t c2 = __builtin_add_overflow(sum, carry, &r[i]);
+        carry = c1 | c2;
+    }
+    return carry;
+}
+
+/**
+ * @brief r += a, where r has rn >= an limbs (the carry runs through all of r)
+ * @return The carry out of the top limb of r
+ */
+static limb_t add_into(limb_t* r, size_t rn, const limb_t* a, size_t an) {
+    limb_t carry = add_n(r, r, a, an);
+    for (size_t i = an; carry != 0 && i < rn; i++) {
+        carry = __builtin_add_overflow(r[i], carry, &r[i]);
+    }
+    return carry;
+}
+
+/**
+ * @brief r -= a, where r has rn >= an limbs (the borrow runs through all of r)
+ * @return The borrow out of the top limb of r
+ */
+static limb_t sub_into(limb_t* r, size_t rn, const limb_t* a, size_t an) {
+    limb_t borrow = 0;
+    for (size_t i = 0; i < an; i++) {
+        limb_t difference;
+        limb_t b1 = __builtin_sub_overflow(r[i], a[i], &difference);
+        limb_t b2 = __builtin_sub_overflow(difference, borrow, &r[i]);
+        borrow = b1 | b2;
+    }
+    for (size_t i = an; borrow != 0 && i < rn; i++) {
+        borrow = __builtin_sub_overflow(r[i], borrow, &r[i]);
+    }
+    return borrow;
+}
+
+void bignum_add_shifted(bignum_t* r, const bignum_t* a, size_t digits) {
+    size_t offset = digits / LIMB_HEX_DIGITS;
+    unsigned shift = 4 * (digits % LIMB_HEX_DIGITS);
+    if (offset >= r->size) {
+        return;
+    }
+
+    // limb i of a * 16^digits is made of the limbs i and i-1 of a shifted
+    limb_t carry = 0;
+    limb_t previous = 0;
+    size_t i;
+    for (i = 0; i <= a->size && offset + i < r->size; i++) {
+        limb_t current = i < a->size ? a->limbs[i] : 0;
+        limb_t limb = shift == 0 ? current : current << shift | previous >> (64 - shift);
+        previous = current;
+
+        limb_t sum;
+        limb_t c1 = __builtin_add_overflow(r->limbs[offset + i], limb, &sum);
+        limb_t c2 = __builtin_add_overflow(sum, carry, &r->limbs[offset + i]);
+        carry = c1 | c2;
+    }
+    for (i += offset; carry != 0 && i < r->size; i++) {
+        carry = __builtin_add_overflow(r->limbs[i], carry, &r->limbs[i]);
+    }
+}
+
+/**
+ * @brief Schoolbook multiplication r = a * b, r has an + bn limbs
+ */
+static void mul_schoolbook(limb_t* r, const limb_t* a, size_t an, const limb_t* b, size_t bn) {
+    memset(r, 0, (an + bn) * sizeof(limb_t));
+    for (size_t i = 0; i < an; i++) {
+        limb_t carry = 0;
+        for (size_t j = 0; j < bn; j++) {
+            dlimb_t product = (dlimb_t)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (limb_t)product;
+            carry = (limb_t)(product >> 64);
+        }
+        r[i + bn] = carry;
+    }
+}
+
+/**
+ * @brief Number of scratch limbs mul_karatsuba needs for n limbs
+ * @details Every level needs 4 * (n - n/2 + 1) limbs and the next level works on at most n/2 + 2 limbs.
+ */
+static size_t karatsuba_scratch(size_t n) {
+    size_t total = 0;
+    while (n >= KARATSUBA_THRESHOLD) {
+        size_t high = n - n / 2;
+        total += 4 * (high + 1);
+        n = high + 1;
+    }
+    return total;
+}
+
+/**
+ * @brief Karatsuba multiplication r = a * b of two numbers with n limbs, r has 2n limbs
+ * @details With a = a1*X + a0 and b = b1*X + b0 (X = 2^(64*(n/2))) the three half size products
+ * z0 = a0*b0, z2 = a1*b1 and z1 = (a0+a1)*(b0+b1) - z0 - z2 give a*b = z2*X^2 + z1*X + z0
+ * instead of the four products a1*b1, a1*b0, a0*b1, a0*b0.
+ * @param scratch At least karatsuba_scratch(n) limbs
+ */
+static void mul_karatsuba(limb_t* r, const limb_t* a, const limb_t* b, size_t n, limb_t* scratch) {
+    if (n < KARATSUBA_THRESHOLD) {
+        mul_schoolbook(r, a, n, b, n);
+        return;
+    }
+
+    size_t low = n / 2;
+    size_t high = n - low;
+
+    // z0 and z2 go straight to their places in r
+    mul_karatsuba(r, a, b, low, scratch);
+    mul_karatsuba(r + 2 * low, a + low, b + low, high, scratch);
+
+    // the sums have high + 1 limbs (the top one is the carry)
+    limb_t* sum_a = scratch;
+    limb_t* sum_b = sum_a + high + 1;
+    limb_t* z1 = sum_b + high + 1;
+    memcpy(sum_a, a + low, high * sizeof(limb_t));
+    memcpy(sum_b, b + low, high * sizeof(limb_t));
+    sum_a[high] = add_into(sum_a, high, a, low);
+    sum_b[high] = add_into(sum_b, high, b, low);
+
+    mul_karatsuba(z1, sum_a, sum_b, high + 1, z1 + 2 * (high + 1));
+    sub_into(z1, 2 * (high + 1), r, 2 * low);
+    sub_into(z1, 2 * (high + 1), r + 2 * low, 2 * high);
+
+    // z1 < 2^(64 * (n + high)), its top limbs beyond r are zero
+    size_t z1_size = 2 * (high + 1) < 2 * n - low ? 2 * (high + 1) : 2 * n - low;
+    add_into(r + low, 2 * n - low, z1, z1_size);
+}
+
+/**
+ * @brief r = a * b of two numbers with n limbs in this thread, r has 2n limbs
+ * @return 0 on success, -1 if no memory is left
+ */
+static int mul_sequential(limb_t* r, const limb_t* a, const limb_t* b, size_t n, bignum_algorithm_t algorithm) {
+    if (algorithm == BIGNUM_NTT || (algorithm == BIGNUM_AUTO && n >= NTT_THRESHOLD)) {
+        return ntt_mul(r, a, n, b, n);
+    }
+
+    limb_t* scratch = malloc((karatsuba_scratch(n) + 1) * sizeof(limb_t));
+    if (scratch == NULL) {
+        return -1;
+    }
+    mul_karatsuba(r, a, b, n, scratch);
+    free(scratch);
+    return 0;
+}
+
+/** Struct for one product of the parallel Karatsuba multiplication */
+typedef struct {
+    pool_task_t task;
+    limb_t* r;
+    const limb_t* a;
+    const limb_t* b;
+    size_t n;
+    int depth;      /**< number of levels that still submit tasks */
+    int error;
+} karatsuba_task_t;
+
+/**
+ * @brief Task computing r = a * b like mul_karatsuba, the three products are tasks themselves
+ * @details Below PARALLEL_CUTOFF limbs or the last parallel level the product is computed by
+ * mul_sequential. z2 and z1 are submitted, z0 is computed by this worker before it waits.
+ */
+static void karatsuba_task(pool_task_t* task, pool_worker_t* worker) {
+    karatsuba_task_t* t = (karatsuba_task_t*)task;
+    size_t n = t->n;
+    size_t low = n / 2;
+    size_t high = n - low;
+
+    limb_t* buffer = NULL;
+    if (t->depth > 0 && n >= PARALLEL_CUTOFF) {
+        buffer = malloc(4 * (high + 1) * sizeof(limb_t));
+    }
+    if (buffer == NULL) {
+        t->error = mul_sequential(t->r, t->a, t->b, n, BIGNUM_AUTO);
+        return;
+    }
+
+    limb_t* sum_a = buffer;
+    limb_t* sum_b = sum_a + high + 1;
+    limb_t* z1 = sum_b + high + 1;
+    memcpy(sum_a, t->a + low, high * sizeof(limb_t));
+    memcpy(sum_b, t->b + low, high * sizeof(limb_t));
+    sum_a[high] = add_into(sum_a, high, t->a, low);
+    sum_b[high] = add_into(sum_b, high, t->b, low);
+
+    karatsuba_task_t products[3] = {
+        {{karatsuba_task, false}, t->r, t->a, t->b, low, t->depth - 1, 0},
+        {{karatsuba_task, false}, t->r + 2 * low, t->a + low, t->b + low, high, t->depth - 1, 0},
+        {{karatsuba_task, false}, z1, sum_a, sum_b, high + 1, t->depth - 1, 0},
+    };
+    pool_submit(worker, &products[1].task);
+    pool_submit(worker, &products[2].task);
+    karatsuba_task(&products[0].task, worker);
+    pool_wait(worker, &products[1].task);
+    pool_wait(worker, &products[2].task);
+
+    t->error = products[0].error | products[1].error | products[2].error;
+    if (t->error == 0) {
+        sub_into(z1, 2 * (high + 1), t->r, 2 * low);
+        sub_into(z1, 2 * (high + 1), t->r + 2 * low, 2 * high);
+        size_t z1_size = 2 * (high + 1) < 2 * n - low ? 2 * (high + 1) : 2 * n - low;
+        add_into(t->r + low, 2 * n - low, z1, z1_size);
+    }
+    free(buffer);
+}
+
+/**
+ * @brief Multiplies a and b padded to n limbs each, in this thread or with a pool on its threads
+ * @return 0 on success, -1 if no memory is left
+ */
+static int mul_padded(bignum_t* result, const bignum_t* a, const bignum_t* b, bignum_algorithm_t algorithm,
+        thread_pool_t* pool) {
+    size_t n = a->size > b->size ? a->size : b->size;
+    result->size = a->size + b->size;
+    result->limbs = NULL;
+
+    // both operands are padded to n limbs, the product to 2n
+    limb_t* padded = calloc(2 * n > 0 ? 2 * n : 1, sizeof(limb_t));
+    limb_t* product = malloc((2 * n > 0 ? 2 * n : 1) * sizeof(limb_t));
+    if (padded == NULL || product == NULL) {
+        free(padded);
+        free(product);
+        return -1;
+    }
+    memcpy(padded, a->limbs, a->size * sizeof(limb_t));
+    memcpy(padded + n, b->limbs, b->size * sizeof(limb_t));
+
+    int error;
+    if (pool == NULL) {
+        error = mul_sequential(product, padded, padded + n, n, algorithm);
+    } else {
+        // enough tasks for every thread to steal a few, each level has three times as many
+        int depth = 0;
+        for (size_t tasks = 1; pool_size(pool) > 1 && tasks < 4 * pool_size(pool); tasks *= 3) {
+            depth++;
+        }
+        karatsuba_task_t root = {{karatsuba_task, false}, product, padded, padded + n, n, depth, 0};
+        pool_run(pool, &root.task);
+        error = root.error;
+    }
+
+    free(padded);
+    if (error != 0) {
+        free(product);
+        return -1;
+    }
+    result->limbs = product;
+    return 0;
+}
+
+int bignum_mul(bignum_t* result, const bignum_t* a, const bignum_t* b, bignum_algorithm_t algorithm) {
+    return mul_padded(result, a, b, algorithm, NULL);
+}
+
+int bignum_mul_parallel(bignum_t* result, const bignum_t* a, const bignum_t* b, thread_pool_t* pool) {
+    return mul_padded(result, a, b, BIGNUM_AUTO, pool);
+}
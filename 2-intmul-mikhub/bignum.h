@@ -0,0 +1,94 @@
+#ifndef _BIGNUM_H_
+#define _BIGNUM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "thread_pool.h"
+
+/**
+ * @file bignum.h
+ * @author Michael Huber 11712763
+ * @date 20.12.2020
+ * @brief Unsigned big integers stored as arrays of 64-bit limbs, used by the in-process engine (-e)
+ * @details The limbs are stored least significant first. Hex strings are converted to limbs once
+ * on input and back once on output, all arithmetic in between works on whole limbs.
+ */
+
+/** One limb, 16 hex digits */
+typedef uint64_t limb_t;
+
+/** Number of hex digits per limb */
+#define LIMB_HEX_DIGITS 16
+
+/** Below this number of limbs Karatsuba falls back to schoolbook multiplication (tuned on x86-64) */
+#define KARATSUBA_THRESHOLD 32
+
+/** From this number of limbs on the number theoretic transform (see ntt.h) is used (tuned on x86-64) */
+#define NTT_THRESHOLD 4096
+
+/** Below this number of limbs bignum_mul_parallel does not split the product into tasks */
+#define PARALLEL_CUTOFF 512
+
+/** Multiplication algorithms of bignum_mul */
+typedef enum {
+    BIGNUM_AUTO,        /**< chosen by the size of the operands */
+    BIGNUM_KARATSUBA,   /**< Karatsuba (schoolbook below KARATSUBA_THRESHOLD limbs) */
+    BIGNUM_NTT          /**< number theoretic transform */
+} bignum_algorithm_t;
+
+/** Struct for storing a big integer: size limbs, least significant first */
+typedef struct {
+    limb_t* limbs;
+    size_t size;
+} bignum_t;
+
+/**
+ * @brief Initializes n with size limbs set to zero
+ * @return 0 on success, -1 if no memory is left
+ */
+int bignum_init(bignum_t* n, size_t size);
+
+/**
+ * @brief Converts len hex digits (most significant first) into a big integer
+ * @return 0 on success, -1 if no memory is left
+ */
+int bignum_from_hex(bignum_t* n, const char* hex, size_t len);
+
+/**
+ * @brief Converts a big integer into exactly digits lowercase hex digits (with leading zeros)
+ * @return The zero terminated string (to be freed by the caller) or NULL if no memory is left
+ */
+char* bignum_to_hex(const bignum_t* n, size_t digits);
+
+/**
+ * @brief Adds a * 16^digits to r, one limb (16 hex digits) per addition
+ * @details A carry out of the top limb of r is dropped, r has to be large enough.
+ */
+void bignum_add_shifted(bignum_t* r, const bignum_t* a, size_t digits);
+
+/**
+ * @brief Multiplies a and b
+ * @details With BIGNUM_AUTO operands of at least NTT_THRESHOLD limbs are multiplied with the
+ * number theoretic transform, smaller ones with Karatsuba.
+ * @param result Receives a.size + b.size limbs
+ * @return 0 on success, -1 if no memory is left
+ */
+int bignum_mul(bignum_t* result, const bignum_t* a, const bignum_t* b, bignum_algorithm_t algorithm);
+
+/**
+ * @brief Multiplies a and b with Karatsuba on the threads of the pool
+ * @details The first levels of the recursion submit their three products as tasks, below
+ * PARALLEL_CUTOFF limbs (or once there are enough tasks for all threads) each task multiplies
+ * sequentially like bignum_mul.
+ * @param result Receives a.size + b.size limbs
+ * @return 0 on success, -1 if no memory is left
+ */
+int bignum_mul_parallel(bignum_t* result, const bignum_t* a, const bignum_t* b, thread_pool_t* pool);
+
+/**
+ * @brief Frees the limbs of n
+ */
+void bignum_free(bignum_t* n);
+
+#endif
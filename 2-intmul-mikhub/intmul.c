@@ -7,12 +7,12 @@ static void close_unused_pipes(void);
 
 // utils
 static int hextoint(char c);
-static char inttohex(int n);
 static void cleanup(void);
 static const char* PROGRAM_NAME;
 
 // main
 static size_t readinput(void);
+static void run_engine(size_t len);
 static void base_case(char cA, char cB);
 static void invoke_child(int i);
 static void write_to_children(int len);
@@ -32,6 +32,9 @@ static void USAGE(void);
  * @details The program takes two hexadecimal integers A and B with an equal number of digits as 
  * input, multiplies them and prints the result. The input is read from stdin and consists of two 
  * lines: the first line is the integer A and the second line is the integer B.
+ * With -e the product is computed in this process (see bignum.h) instead of by a tree of children,
+ * the length of the numbers then does not have to be a power of two. -p does the same on a thread
+ * pool with one thread per processor (see thread_pool.h).
  */
 
 /** Struct for storing input numbers */
@@ -44,7 +47,7 @@ static child_process_t children[NUM_CHILDREN];
 static pipe_end_t pipe_ends[NUM_PIPE_ENDS];
 
 /** Booleans set by options */
-static bool tree, parent;
+static bool tree, parent, engine, parallel;
 
 /**
  * @brief Sets up cleanup function, parses options, calls functions to fork children and
@@ -64,7 +67,7 @@ int main(int argc, char* const *argv) {
     // parse options
     int count_t = 0;
     int c;  
-    while((c = getopt(argc, argv, "tT")) != -1 ) {
+    while((c = getopt(argc, argv, "tTep")) != -1 ) {
         switch (c) {
             case 't':
                 parent = true;
@@ -75,6 +78,13 @@ int main(int argc, char* const *argv) {
                 tree = true;
                 count_t++;
                 break;
+            case 'e':
+                engine = true;
+                break;
+            case 'p':
+                engine = true;
+                parallel = true;
+                break;
             case '?':
                 USAGE();
                 break;
@@ -96,6 +106,10 @@ int main(int argc, char* const *argv) {
     // read in number
     size_t len = readinput(); // freeing is done in cleanup function
 
+    if (engine) {
+        run_engine(len);
+    }
+
     // recursion base case
     if (len == 1) {
         base_case(numbers.A[0], numbers.B[0]);
@@ -171,7 +185,7 @@ static size_t readinput(void){
         ERROR_EXIT("Input is empty", NULL);
     }
 
-    if ((len & (len-1)) != 0) {
+    if (!engine && (len & (len-1)) != 0) {
         ERROR_EXIT("Input length is not a power of two", NULL);
     }
 
@@ -192,6 +206,56 @@ static size_t readinput(void){
     return len;
 }
 
+/**
+ * @brief Multiplies the numbers in this process and prints the result (2*len hex digits) to stdout
+ * @details Uses the global struct numbers. The numbers are converted to limbs once, multiplied by
+ * bignum_mul and converted back once. INTMUL_ALGORITHM=karatsuba|ntt forces an algorithm, with -p
+ * bignum_mul_parallel multiplies on a thread pool instead.
+ * @param len Length of the input numbers
+ */
+static void run_engine(size_t len) {
+    bignum_t A, B, result;
+    bignum_algorithm_t algorithm = BIGNUM_AUTO;
+    char* forced = getenv("INTMUL_ALGORITHM");
+    if (forced != NULL && strcmp(forced, "karatsuba") == 0) {
+        algorithm = BIGNUM_KARATSUBA;
+    } else if (forced != NULL && strcmp(forced, "ntt") == 0) {
+        algorithm = BIGNUM_NTT;
+    } else if (forced != NULL) {
+        ERROR_EXIT("Unknown INTMUL_ALGORITHM (karatsuba or ntt)", forced);
+    }
+
+    if (bignum_from_hex(&A, numbers.A, len) < 0 || bignum_from_hex(&B, numbers.B, len) < 0) {
+        ERROR_EXIT("Converting input failed", strerror(errno));
+    }
+
+    if (parallel) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_pool_t* pool = pool_create(processors > 0 ? processors : 1);
+        if (pool == NULL) {
+            ERROR_EXIT("Creating thread pool failed", strerror(errno));
+        }
+        if (bignum_mul_parallel(&result, &A, &B, pool) < 0) {
+            ERROR_EXIT("Multiplication failed", strerror(errno));
+        }
+        pool_destroy(pool);
+    } else if (bignum_mul(&result, &A, &B, algorithm) < 0) {
+        ERROR_EXIT("Multiplication failed", strerror(errno));
+    }
+
+    char* hex = bignum_to_hex(&result, 2*len);
+    if (hex == NULL) {
+        ERROR_EXIT("Converting result failed", strerror(errno));
+    }
+    fprintf(stdout, "%s\n", hex);
+
+    free(hex);
+    bignum_free(&A);
+    bignum_free(&B);
+    bignum_free(&result);
+    exit(EXIT_SUCCESS);
+}
+
 /**
  * @brief Recursion base case - multiplies two one-digit hex numbers and prints the result to stdout
  * @param cA First hex char
@@ -380,52 +444,27 @@ static void read_from_children_and_print_combined_result(int len) {
         child_results_len[i] = result_len;
     }
 
-    // combine children results
-    int half_len = len/2;
-    int double_len = 2*len;
+    // combine children results: Ah*Bh * 16^n + Ah*Bl * 16^n/2 + Al*Bh * 16^n/2 + Al*Bl,
+    // each result is converted to limbs once and added 16 digits at a time
+    size_t shift[NUM_CHILDREN];
+    shift[AhBh] = len;
+    shift[AhBl] = len/2;
+    shift[AlBh] = len/2;
+    shift[AlBl] = 0;
 
     // the result can have at most 2*input-length digits
-    char result[double_len+1];
-    memset(result, 0, double_len);
-    result[double_len] = '\0';
-
-    int index[NUM_CHILDREN];
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
-    {
-        index[i] = child_results_len[i]-1;
+    bignum_t result;
+    if (bignum_init(&result, (2*len + LIMB_HEX_DIGITS - 1) / LIMB_HEX_DIGITS) < 0) {
+        ERROR_EXIT("Combining results failed", strerror(errno));
     }
-
-    int carry = 0;
-    for (int i = double_len-1; i >= 0; i--)
+    for (size_t i = 0; i < NUM_CHILDREN; i++)
     {
-        if(i >= len+half_len) {
-        // Al*Bl 
-        // (for first n/2 digits can be just copied)
-            result[i] = index[AlBl] < 0 ? 0 : child_results[AlBl][index[AlBl]--];
-        } else if (i >= len) {
-        // Ah*Bl * 16^n/2 + Al*Bh * 16^n/2 + Al*Bl 
-        // (for next n/2 digits AhBl and AlBh need to be taken into account)
-            int n0 = index[AlBl] < 0 ? 0 : hextoint(child_results[AlBl][index[AlBl]--]);
-            int n1 = index[AlBh] < 0 ? 0 : hextoint(child_results[AlBh][index[AlBh]--]);
-            int n2 = index[AhBl] < 0 ? 0 : hextoint(child_results[AhBl][index[AhBl]--]);
-
-            int n = n0 + n1 + n2 + carry;
-            
-            result[i] = inttohex(n % 16);
-            carry = n / 16;
-        } else {
-        // Ah*Bh * 16^n + Ah*Bl * 16^n/2 + Al*Bh * 16^n/2 + Al*Bl
-        // (for the remaining digits all subresults have to be combined)
-            int n0 = index[AlBl] < 0 ? 0 : hextoint(child_results[AlBl][index[AlBl]--]);
-            int n1 = index[AlBh] < 0 ? 0 : hextoint(child_results[AlBh][index[AlBh]--]);
-            int n2 = index[AhBl] < 0 ? 0 : hextoint(child_results[AhBl][index[AhBl]--]);
-            int n3 = index[AhBh] < 0 ? 0 : hextoint(child_results[AhBh][index[AhBh]--]);
-
-            int n = n0 + n1 + n2 + n3 + carry;
-            
-            result[i] = inttohex(n % 16);
-            carry = n / 16;
+        bignum_t child;
+        if (bignum_from_hex(&child, child_results[i], child_results_len[i]) < 0) {
+            ERROR_EXIT("Combining results failed", strerror(errno));
         }
+        bignum_add_shifted(&result, &child, shift[i]);
+        bignum_free(&child);
     }
 
     for (size_t i = 0; i < NUM_CHILDREN; i++)
@@ -433,8 +472,15 @@ static void read_from_children_and_print_combined_result(int len) {
         free(child_results[i]);
     }
 
+    char* hex = bignum_to_hex(&result, 2*len);
+    bignum_free(&result);
+    if (hex == NULL) {
+        ERROR_EXIT("Converting result failed", strerror(errno));
+    }
+
     // print result to stdout
-    fprintf(stdout, "%s\n", result);
+    fprintf(stdout, "%s\n", hex);
+    free(hex);
 
     /* BONUS{ */
     if (tree) {
@@ -539,23 +585,6 @@ static int hextoint(char c){
     return value;
 }
 
-/**
- * @brief Converts an int 0<=n<=15 to the corresponding hex char
- * @param n Integer to be converted
- */
-static char inttohex(int n) {
-    char c;
-    if (n>15 || n<0) {
-        ERROR_MSG("invalid hex number", NULL);
-        return -1;
-    } else if (n<10) {
-        c = '0'+n;
-    } else {
-        c = 'a'+(n-10);
-    }
-    return c;
-}
-
 static void ERROR_EXIT(char *message, char *error_details) {
     ERROR_MSG(message, error_details);
     exit(EXIT_FAILURE);
@@ -570,6 +599,6 @@ static void ERROR_MSG(char *message, char *error_details) {
 }
 
 void USAGE(void) {
-    fprintf(stderr, "Usage: %s [-t]", PROGRAM_NAME);
+    fprintf(stderr, "Usage: %s [-t | -e | -p]", PROGRAM_NAME);
     exit(EXIT_FAILURE);
 }
\ No newline at end of file
@@ -13,6 +13,8 @@
 #include <errno.h>
 #include <getopt.h>
 
+#include "bignum.h"
+
 /** Number of children to fork (always 4 with intmul) */
 #define NUM_CHILDREN 4
 /** Number of pipe ends needed for children */
@@ -0,0 +1,263 @@
+#include "ntt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file ntt.c
+ * @author Michael Huber 11712763
+ * @date 21.12.2020
+ * @brief Number theoretic transform multiplication with Montgomery arithmetic
+ * @details All residues are kept in normal form, only the roots and constants are stored in
+ * Montgomery form (times 2^64 mod p), so a Montgomery product with them is a normal product.
+ */
+
+/** Double limb for the products of two limbs */
+__extension__ typedef unsigned __int128 dlimb_t;
+
+/** Struct for one prime and its Montgomery constants */
+typedef struct {
+    limb_t p;
+    limb_t ninv;    /**< -p^-1 mod 2^64 */
+    limb_t one;     /**< 2^64 mod p, the Montgomery form of 1 */
+    limb_t r2;      /**< 2^128 mod p */
+    limb_t root;    /**< generator of the multiplicative group */
+} modulus_t;
+
+/** The three primes c * 2^k + 1 and their generators */
+static const limb_t PRIMES[3][2] = {
+    {4179340454199820289ULL, 3},    // 29 * 2^57 + 1
+    {2485986994308513793ULL, 5},    // 69 * 2^55 + 1
+    {1945555039024054273ULL, 5},    // 27 * 2^56 + 1
+};
+
+/**
+ * @brief (a * b) mod p for setup, slow but exact
+ */
+static limb_t mulmod(limb_t a, limb_t b, limb_t p) {
+    return (dlimb_t)a * b % p;
+}
+
+/**
+ * @brief a^e mod p for setup
+ */
+static limb_t powmod(limb_t a, limb_t e, limb_t p) {
+    limb_t result = 1;
+    for (a %= p; e != 0; e >>= 1) {
+        if (e & 1) result = mulmod(result, a, p);
+        a = mulmod(a, a, p);
+    }
+    return result;
+}
+
+static void modulus_init(modulus_t* m, limb_t p, limb_t root) {
+    // Newton iteration, every step doubles the correct low bits (p * p = 1 mod 8)
+    limb_t inv = p;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - p * inv;
+    }
+    m->p = p;
+    m->ninv = -inv;
+    m->one = ((dlimb_t)1 << 64) % p;
+    m->r2 = mulmod(m->one, m->one, p);
+    m->root = root;
+}
+
+/**
+ * @brief Montgomery product a * b * 2^-64 mod p, a * b has to be below p * 2^64
+ * @details So one factor may be any limb as long as the other one is reduced.
+ */
+static inline limb_t mont_mul(limb_t a, limb_t b, const modulus_t* m) {
+    dlimb_t t = (dlimb_t)a * b;
+    limb_t q = (limb_t)t * m->ninv;
+    limb_t u = (t + (dlimb_t)q * m->p) >> 64;
+    return u >= m->p ? u - m->p : u;
+}
+
+static inline limb_t add_mod(limb_t a, limb_t b, const modulus_t* m) {
+    limb_t s = a + b;
+    return s >= m->p ? s - m->p : s;
+}
+
+static inline limb_t sub_mod(limb_t a, limb_t b, const modulus_t* m) {
+    return a >= b ? a - b : a + m->p - b;
+}
+
+/** Converts x < p into Montgomery form */
+static limb_t to_mont(limb_t x, const modulus_t* m) {
+    return mont_mul(x, m->r2, m);
+}
+
+/**
+ * @brief Fills roots[half + j] = w^j (Montgomery form) for every power of two half < n,
+ * w a primitive root of unity of order 2 * half, or its inverse if inverse is set
+ */
+static void compute_roots(limb_t* roots, size_t n, const modulus_t* m, int inverse) {
+    limb_t generator = inverse ? powmod(m->root, m->p - 2, m->p) : m->root;
+    for (size_t half = 1; half < n; half *= 2) {
+        limb_t w = to_mont(powmod(generator, (m->p - 1) / (2 * half), m->p), m);
+        limb_t current = m->one;
+        for (size_t j = 0; j < half; j++) {
+            roots[half + j] = current;
+            current = mont_mul(current, w, m);
+        }
+    }
+}
+
+/**
+ * @brief Decimation in frequency transform, natural order in, bit reversed order out
+ */
+static void ntt_forward(limb_t* a, size_t n, const limb_t* roots, const modulus_t* m) {
+    for (size_t half = n / 2; half >= 1; half /= 2) {
+        for (size_t start = 0; start < n; start += 2 * half) {
+            limb_t* x = a + start;
+            limb_t* y = x + half;
+            for (size_t j = 0; j < half; j++) {
+                limb_t u = x[j], v = y[j];
+                x[j] = add_mod(u, v, m);
+                y[j] = mont_mul(sub_mod(u, v, m), roots[half + j], m);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Decimation in time transform with the inverse roots, bit reversed order in,
+ * natural order out, the result is n times too large
+ */
+static void ntt_inverse(limb_t* a, size_t n, const limb_t* roots, const modulus_t* m) {
+    for (size_t half = 1; half < n; half *= 2) {
+        for (size_t start = 0; start < n; start += 2 * half) {
+            limb_t* x = a + start;
+            limb_t* y = x + half;
+            for (size_t j = 0; j < half; j++) {
+                limb_t u = x[j], v = mont_mul(y[j], roots[half + j], m);
+                x[j] = add_mod(u, v, m);
+                y[j] = sub_mod(u, v, m);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Computes the cyclic convolution of a and b modulo one prime into result (n limbs)
+ * @details b is scaled by n^-1 * 2^64 while it is reduced, this cancels both the factor n of the
+ * inverse transform and the 2^-64 of the Montgomery products of the transforms.
+ */
+static void convolve(limb_t* result, limb_t* buffer, limb_t* roots, size_t n, const limb_t* a, size_t an,
+        const limb_t* b, size_t bn, const modulus_t* m) {
+    limb_t scale = mulmod(powmod(n % m->p, m->p - 2, m->p), m->r2, m->p);
+
+    for (size_t i = 0; i < an; i++) {
+        result[i] = mont_mul(a[i], m->one, m);
+    }
+    memset(result + an, 0, (n - an) * sizeof(limb_t));
+    for (size_t i = 0; i < bn; i++) {
+        buffer[i] = mont_mul(b[i], scale, m);
+    }
+    memset(buffer + bn, 0, (n - bn) * sizeof(limb_t));
+
+    compute_roots(roots, n, m, 0);
+    ntt_forward(result, n, roots, m);
+    ntt_forward(buffer, n, roots, m);
+    for (size_t i = 0; i < n; i++) {
+        result[i] = mont_mul(result[i], buffer[i], m);
+    }
+    compute_roots(roots, n, m, 1);
+    ntt_inverse(result, n, roots, m);
+}
+
+/**
+ * @brief Reconstructs every coefficient from its three residues, in place
+ * @details Afterwards low, mid and high hold the three limbs of each coefficient.
+ */
+static void crt(limb_t* low, limb_t* mid, limb_t* high, size_t n, const modulus_t* m) {
+    const modulus_t* m1 = &m[0];
+    const modulus_t* m2 = &m[1];
+    const modulus_t* m3 = &m[2];
+
+    // x = r1 + p1 * t1 + p1 * p2 * t2
+    limb_t inv_p1 = to_mont(powmod(m1->p % m2->p, m2->p - 2, m2->p), m2);
+    limb_t p1_mod_p3 = to_mont(m1->p % m3->p, m3);
+    limb_t inv_p1p2 = to_mont(powmod(mulmod(m1->p, m2->p, m3->p), m3->p - 2, m3->p), m3);
+    dlimb_t p1p2 = (dlimb_t)m1->p * m2->p;
+    limb_t p1p2_low = (limb_t)p1p2, p1p2_high = (limb_t)(p1p2 >> 64);
+
+    for (size_t i = 0; i < n; i++) {
+        limb_t r1 = low[i], r2 = mid[i], r3 = high[i];
+
+        limb_t t1 = mont_mul(sub_mod(r2, mont_mul(r1, m2->one, m2), m2), inv_p1, m2);
+        limb_t v = add_mod(mont_mul(r1, m3->one, m3), mont_mul(t1, p1_mod_p3, m3), m3);
+        limb_t t2 = mont_mul(sub_mod(r3, v, m3), inv_p1p2, m3);
+
+        dlimb_t x12 = r1 + (dlimb_t)m1->p * t1;
+        dlimb_t product_low = (dlimb_t)p1p2_low * t2;
+        dlimb_t product_high = (dlimb_t)p1p2_high * t2;
+
+        dlimb_t sum = (dlimb_t)(limb_t)x12 + (limb_t)product_low;
+        low[i] = (limb_t)sum;
+        sum = (sum >> 64) + (x12 >> 64) + (product_low >> 64) + (limb_t)product_high;
+        mid[i] = (limb_t)sum;
+        high[i] = (limb_t)(sum >> 64) + (limb_t)(product_high >> 64);
+    }
+}
+
+/**
+ * @brief r = low + mid * 2^64 + high * 2^128 (shifted limb by limb), r has rn <= n limbs
+ * @details The first pass adds the three limbs of every position independently of the others
+ * (so the compiler can vectorize it, there is an AVX2 clone for the 64-bit comparisons, chosen at
+ * load time) and keeps the carries (at most 2) in low. The second pass
+ * only ripples these small carries, which runs further than one limb almost never.
+ */
+__attribute__((target_clones("avx2", "default")))
+static void propagate_carries(limb_t* restrict r, size_t rn, limb_t* restrict low, const limb_t* restrict mid,
+        const limb_t* restrict high) {
+    r[0] = low[0];
+    low[0] = 0;
+    if (rn > 1) {
+        r[1] = low[1] + mid[0];
+        low[1] = r[1] < mid[0];
+    }
+    // comparisons instead of __builtin_add_overflow, which gcc does not vectorize
+    for (size_t i = 2; i < rn; i++) {
+        limb_t sum = low[i] + mid[i - 1];
+        limb_t total = sum + high[i - 2];
+        low[i] = (sum < mid[i - 1]) + (total < sum);
+        r[i] = total;
+    }
+
+    limb_t carry = 0;
+    for (size_t i = 1; i < rn; i++) {
+        carry = __builtin_add_overflow(r[i], low[i - 1] + carry, &r[i]);
+    }
+}
+
+int ntt_mul(limb_t* r, const limb_t* a, size_t an, const limb_t* b, size_t bn) {
+    size_t rn = an + bn;
+    size_t n = 1;
+    while (n < rn) {
+        n *= 2;
+    }
+
+    // three residue arrays, the second operand and the roots
+    limb_t* memory = malloc(5 * n * sizeof(limb_t));
+    if (memory == NULL) {
+        return -1;
+    }
+    limb_t* residues[3] = {memory, memory + n, memory + 2 * n};
+    limb_t* buffer = memory + 3 * n;
+    limb_t* roots = memory + 4 * n;
+
+    modulus_t m[3];
+    for (int k = 0; k < 3; k++) {
+        modulus_init(&m[k], PRIMES[k][0], PRIMES[k][1]);
+        convolve(residues[k], buffer, roots, n, a, an, b, bn, &m[k]);
+    }
+
+    // the coefficients beyond rn - 2 are zero, so no limb beyond rn is touched
+    crt(residues[0], residues[1], residues[2], rn, m);
+    propagate_carries(r, rn, residues[0], residues[1], residues[2]);
+
+    free(memory);
+    return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef _NTT_H_
+#define _NTT_H_
+
+#include "bignum.h"
+
+/**
+ * @file ntt.h
+ * @author Michael Huber 11712763
+ * @date 21.12.2020
+ * @brief Multiplication of big integers with a number theoretic transform over three primes
+ * @details Every limb is one coefficient of a polynomial. The convolution of the two polynomials
+ * is computed modulo three primes p < 2^62 (with 2^55 | p - 1) and the coefficients are
+ * reconstructed with the chinese remainder theorem, p1 * p2 * p3 > 2^183 is larger than any
+ * coefficient n * (2^64 - 1)^2 for operands below 2^55 limbs.
+ */
+
+/**
+ * @brief Multiplies a (an limbs) and b (bn limbs) into r (an + bn limbs)
+ * @return 0 on success, -1 if no memory is left
+ */
+int ntt_mul(limb_t* r, const limb_t* a, size_t an, const limb_t* b, size_t bn);
+
+#endif
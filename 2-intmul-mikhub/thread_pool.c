@@ -0,0 +1,218 @@
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+/**
+ * @file thread_pool.c
+ * @author Michael Huber 11712763
+ * @date 22.12.2020
+ * @brief A work stealing thread pool for recursive tasks
+ * @details The deques are short (a few tasks per recursion level) and the tasks coarse, so all
+ * deques share one mutex.
+ */
+
+/** Struct for the deque of one worker: a ring buffer, head is the oldest task */
+typedef struct {
+    pool_task_t** tasks;
+    size_t capacity;
+    size_t head;
+    size_t count;
+} deque_t;
+
+/** Struct for the pool, worker 0 is the thread calling pool_run */
+struct thread_pool {
+    pthread_t* threads;
+    size_t thread_count;
+    pool_worker_t* workers;
+    deque_t* deques;
+    bool stopping;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;     /**< a task was submitted or is done */
+};
+
+/**
+ * @brief Takes the newest task of the own deque or steals the oldest one of another deque
+ * @details The lock has to be held.
+ * @return The task or NULL if all deques are empty
+ */
+static pool_task_t* take_task(thread_pool_t* pool, size_t index) {
+    deque_t* own = &pool->deques[index];
+    if (own->count > 0) {
+        own->count--;
+        return own->tasks[(own->head + own->count) % own->capacity];
+    }
+
+    for (size_t i = 1; i < pool->thread_count; i++) {
+        deque_t* victim = &pool->deques[(index + i) % pool->thread_count];
+        if (victim->count > 0) {
+            pool_task_t* task = victim->tasks[victim->head];
+            victim->head = (victim->head + 1) % victim->capacity;
+            victim->count--;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs a task taken from a deque without the lock and marks it as done
+ * @details The lock has to be held, it is held again afterwards.
+ */
+static void run_task(pool_worker_t* worker, pool_task_t* task) {
+    thread_pool_t* pool = worker->pool;
+    pthread_mutex_unlock(&pool->lock);
+    task->function(task, worker);
+    pthread_mutex_lock(&pool->lock);
+
+    task->done = true;
+    pthread_cond_broadcast(&pool->changed);
+}
+
+/**
+ * @brief Loop of the worker threads 1 to n-1: runs tasks until the pool is stopped
+ */
+static void* work(void* argument) {
+    pool_worker_t* worker = argument;
+    thread_pool_t* pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping) {
+        pool_task_t* task = take_task(pool, worker->index);
+        if (task != NULL) {
+            run_task(worker, task);
+        } else {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+thread_pool_t* pool_create(size_t threads) {
+    if (threads == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    thread_pool_t* pool = calloc(1, sizeof(thread_pool_t));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->threads = calloc(threads, sizeof(pthread_t));
+    pool->workers = calloc(threads, sizeof(pool_worker_t));
+    pool->deques = calloc(threads, sizeof(deque_t));
+    if (pool->threads == NULL || pool->workers == NULL || pool->deques == NULL) {
+        pool_destroy(pool);
+        errno = ENOMEM;
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->changed, NULL);
+
+    pool->thread_count = threads;
+    for (size_t i = 0; i < threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+    }
+
+    // thread 0 is the caller of pool_run
+    for (size_t i = 1; i < threads; i++) {
+        int result = pthread_create(&pool->threads[i], NULL, work, &pool->workers[i]);
+        if (result != 0) {
+            pool->thread_count = i;
+            pool_destroy(pool);
+            errno = result;
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+size_t pool_size(const thread_pool_t* pool) {
+    return pool->thread_count;
+}
+
+void pool_run(thread_pool_t* pool, pool_task_t* task) {
+    task->done = false;
+    task->function(task, &pool->workers[0]);
+    task->done = true;
+}
+
+void pool_submit(pool_worker_t* worker, pool_task_t* task) {
+    thread_pool_t* pool = worker->pool;
+    deque_t* deque = &pool->deques[worker->index];
+    task->done = false;
+
+    pthread_mutex_lock(&pool->lock);
+    if (deque->count == deque->capacity) {
+        size_t capacity = deque->capacity > 0 ? 2 * deque->capacity : 16;
+        pool_task_t** bigger = malloc(capacity * sizeof(pool_task_t*));
+        if (bigger == NULL) {
+            pthread_mutex_unlock(&pool->lock);
+            task->function(task, worker);
+            task->done = true;
+            return;
+        }
+
+        // unwrap the ring so the oldest task is at index 0 again
+        for (size_t i = 0; i < deque->count; i++) {
+            bigger[i] = deque->tasks[(deque->head + i) % deque->capacity];
+        }
+        free(deque->tasks);
+        deque->tasks = bigger;
+        deque->capacity = capacity;
+        deque->head = 0;
+    }
+
+    deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+    deque->count++;
+    pthread_cond_signal(&pool->changed);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_wait(pool_worker_t* worker, pool_task_t* task) {
+    thread_pool_t* pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!task->done) {
+        pool_task_t* next = take_task(pool, worker->index);
+        if (next != NULL) {
+            run_task(worker, next);
+        } else {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(thread_pool_t* pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    if (pool->thread_count > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pool->stopping = true;
+        pthread_cond_broadcast(&pool->changed);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (size_t i = 1; i < pool->thread_count; i++) {
+            pthread_join(pool->threads[i], NULL);
+        }
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->changed);
+    }
+
+    if (pool->deques != NULL) {
+        for (size_t i = 0; i < pool->thread_count; i++) {
+            free(pool->deques[i].tasks);
+        }
+    }
+    free(pool->deques);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,74 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @file thread_pool.h
+ * @author Michael Huber 11712763
+ * @date 22.12.2020
+ * @brief A work stealing thread pool for recursive tasks
+ * @details Every worker has its own deque of tasks. A worker takes the newest task of its own deque
+ * (depth first, the data is still in the cache) and, if it is empty, steals the oldest task of
+ * another deque (the largest subproblem). pool_wait does not block while tasks are left: the
+ * waiting worker runs tasks itself until the awaited one is done, so a task can wait for the tasks
+ * it submitted without occupying a thread.
+ */
+
+/** A pool of worker threads, see pool_create */
+typedef struct thread_pool thread_pool_t;
+
+/** Struct for the worker running a task */
+typedef struct {
+    thread_pool_t* pool;
+    size_t index;
+} pool_worker_t;
+
+typedef struct pool_task pool_task_t;
+
+/** Function of a task, called with the task and the worker running it */
+typedef void (*pool_function_t)(pool_task_t* task, pool_worker_t* worker);
+
+/**
+ * Struct for a task, to be embedded as first member into a struct holding the arguments
+ * (the function casts the task pointer back)
+ */
+struct pool_task {
+    pool_function_t function;
+    bool done;
+};
+
+/**
+ * @brief Creates a pool with the given number of threads (including the one calling pool_run)
+ * @return The pool or NULL on failure (errno is set)
+ */
+thread_pool_t* pool_create(size_t threads);
+
+/**
+ * @brief Returns the number of threads of the pool (including the one calling pool_run)
+ */
+size_t pool_size(const thread_pool_t* pool);
+
+/**
+ * @brief Runs the task as worker 0 in the calling thread and returns when it is done
+ */
+void pool_run(thread_pool_t* pool, pool_task_t* task);
+
+/**
+ * @brief Adds a task to the deque of the worker, other workers may steal it
+ * @details If no memory is left the task is run right away.
+ */
+void pool_submit(pool_worker_t* worker, pool_task_t* task);
+
+/**
+ * @brief Runs tasks until the given task (submitted by this worker) is done
+ */
+void pool_wait(pool_worker_t* worker, pool_task_t* task);
+
+/**
+ * @brief Stops the threads and frees the pool, no task may be left
+ */
+void pool_destroy(thread_pool_t* pool);
+
+#endif
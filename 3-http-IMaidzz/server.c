@@ -23,10 +23,50 @@
 #include <time.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <stdint.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <netinet/in.h>
 
 //buffer size used when reading and copying files from a stream
 #define BUFFER_SIZE 1024
 
+//connections handled at the same time, more get a 503 right away
+#define DEFAULT_MAX_CONNECTIONS 64
+
+//requests per second a single client ip may send on average and how many it may
+//send at once before it gets a 429
+#define DEFAULT_RATE 20
+#define DEFAULT_BURST 40
+
+//seconds a single read or write on a connection may block
+#define IO_TIMEOUT 5
+
+//seconds a client has to send the request line
+#define REQUEST_TIMEOUT 10
+
+//size of the table of client ips (power of two) and how many slots are searched
+#define CLIENT_SLOTS 4096
+#define CLIENT_PROBES 16
+
+/**
+ * @brief Token bucket of a single client ip
+ */
+typedef struct
+{
+    //ip address of the client in network byte order
+    uint32_t addr;
+    //whether the slot is in use
+    bool used;
+    //tokens left, every request takes one
+    double tokens;
+    //time of the last refill in seconds
+    double last;
+} client_bucket_t;
+
+//table of client ips with open addressing, only the main process accesses it
+static client_bucket_t clients[CLIENT_SLOTS];
+
 //name of program primarilly used for error messages
 char * prog_name = NULL;
 
@@ -68,7 +108,144 @@ static void error_exit(char * msg){
  * this error message is displayed to inform the user of the correct usage of the program.
  */
 static void usage(void){
-    fprintf(stderr, "USAGE : [%s] server [-p PORT] [-i INDEX] DOC_ROOT\n", prog_name);
+    fprintf(stderr, "USAGE : [%s] server [-p PORT] [-i INDEX] [-c MAX_CONNECTIONS] [-r RATE] [-b BURST] DOC_ROOT\n", prog_name);
+}
+
+/**
+ * @brief Parses a positive number given as argument of an option
+ * 
+ * @details Terminates the program if the argument isn't a positive number.
+ * 
+ * @param arg the argument of the option
+ * 
+ * @return the parsed number
+ */
+static long parse_positive(char * arg)
+{
+    char *end;
+    long value = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || value <= 0)
+    {
+        usage();
+        error_exit("Expected a positive number");
+    }
+    return value;
+}
+
+/**
+ * @brief Returns the current time of the monotonic clock in seconds
+ */
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Takes a token from the bucket of a client ip
+ * 
+ * @details The bucket is looked up in the table of clients. If the ip isn't in the
+ * table yet it takes the first slot that is free or whose bucket would be full again
+ * anyway, so clients that were quiet long enough are forgotten without deleting slots.
+ * If the table is too crowded the client is let in.
+ * 
+ * @param addr the ip address of the client
+ * @param rate tokens added per second
+ * @param burst maximum number of tokens in the bucket
+ * 
+ * @return true if the client may send the request, false if it is too fast
+ */
+static bool take_token(uint32_t addr, double rate, double burst)
+{
+    double now = now_seconds();
+    uint32_t hash = addr * 2654435761u;
+    client_bucket_t *bucket = NULL;
+    client_bucket_t *free_slot = NULL;
+
+    for (int i = 0; i < CLIENT_PROBES; i++)
+    {
+        client_bucket_t *slot = &clients[(hash + i) & (CLIENT_SLOTS - 1)];
+        if (slot->used && slot->addr == addr)
+        {
+            bucket = slot;
+            break;
+        }
+        if (free_slot == NULL && (!slot->used || slot->tokens + (now - slot->last) * rate >= burst))
+        {
+            free_slot = slot;
+        }
+    }
+
+    if (bucket == NULL)
+    {
+        if (free_slot == NULL)
+        {
+            return true;
+        }
+        bucket = free_slot;
+        bucket->addr = addr;
+        bucket->used = true;
+        bucket->tokens = burst;
+        bucket->last = now;
+    }
+
+    bucket->tokens += (now - bucket->last) * rate;
+    if (bucket->tokens > burst)
+    {
+        bucket->tokens = burst;
+    }
+    bucket->last = now;
+
+    if (bucket->tokens < 1)
+    {
+        return false;
+    }
+    bucket->tokens -= 1;
+    return true;
+}
+
+/**
+ * @brief Rejects a connection without waiting for the client
+ * 
+ * @details The response is sent without blocking, so a slow client can't stall the
+ * main process. What the client already sent is read first, so the connection isn't
+ * reset before the client could read the response.
+ * 
+ * @param socket the accepted connection, it is closed afterwards
+ * @param error the status to respond with, like 503 Service Unavailable
+ */
+static void reject_connection(int socket, char * error)
+{
+    char buffer[BUFFER_SIZE];
+    char response[200];
+    int length = snprintf(response, sizeof(response), "HTTP/1.1 %s\r\nConnection: close\r\n\r\n", error);
+
+    recv(socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+    send(socket, response, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    close(socket);
+}
+
+/**
+ * @brief Reaps the children that finished handling their connection
+ * 
+ * @param children the pids of the running children
+ * @param active the number of running children, gets decreased
+ */
+static void reap_children(pid_t *children, int *active)
+{
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0)
+    {
+        for (int i = 0; i < *active; i++)
+        {
+            if (children[i] == pid)
+            {
+                children[i] = children[--(*active)];
+                break;
+            }
+        }
+    }
 }
 
 /**
@@ -186,6 +363,9 @@ static void read_request(int socket_fd, char *root_doc, char *request_file)
         error_exit("Failed getting the first header line of the request");
     }
 
+    //the client sent the request in time
+    alarm(0);
+
     char *req_method = strtok(line, " ");
     char *path_of_file = strtok(NULL, " ");
     char *protool = strtok(NULL, "\r");
@@ -257,7 +437,11 @@ static void read_request(int socket_fd, char *root_doc, char *request_file)
             size_t bytesRead;
             while ((bytesRead = fread(buffer, 1, sizeof(buffer), toread)) > 0)
             {
-                write(socket_fd, buffer, bytesRead);
+                // the client is gone or didn't read for IO_TIMEOUT seconds
+                if (write(socket_fd, buffer, bytesRead) != bytesRead)
+                {
+                    break;
+                }
             }
 
     fclose(toread);
@@ -277,16 +461,22 @@ sa.sa_handler = handle_signal;
 sigaction(SIGINT, &sa, NULL);
 sigaction(SIGTERM, &sa, NULL);
 
+// Writing to a client that is gone shouldn't kill us
+signal(SIGPIPE, SIG_IGN);
+
 char * port_num = NULL;
 int p_option = 0;
 char * doc_root = NULL;
 char * file_name = NULL;
 int file_option = 0;
+long max_connections = DEFAULT_MAX_CONNECTIONS;
+long rate = DEFAULT_RATE;
+long burst = DEFAULT_BURST;
 
 int c = 0;
 
 //argument handling
-while ((c = getopt(argc, argv, "p:i:")) != -1)
+while ((c = getopt(argc, argv, "p:i:c:r:b:")) != -1)
 {
     switch (c)
     {
@@ -312,6 +502,18 @@ while ((c = getopt(argc, argv, "p:i:")) != -1)
         file_name = optarg;
         file_option ++;
         break;
+
+    case 'c':
+        max_connections = parse_positive(optarg);
+        break;
+
+    case 'r':
+        rate = parse_positive(optarg);
+        break;
+
+    case 'b':
+        burst = parse_positive(optarg);
+        break;
     
     case '?':
         usage();
@@ -346,11 +548,22 @@ if (file_option == 0)
 //opening and setting socket
 int sock_fd = make_socket(port_num);
 
+//pids of the children handling connections
+pid_t *children = malloc(max_connections * sizeof(pid_t));
+int active = 0;
+if (children == NULL)
+{
+    close(sock_fd);
+    error_exit("Error while allocating memory");
+}
+
 //read from socket
 
 while (alive)
 {
-    int confd = accept(sock_fd, NULL, NULL);
+    struct sockaddr_in client_addr;
+    socklen_t addr_len = sizeof(client_addr);
+    int confd = accept(sock_fd, (struct sockaddr *) &client_addr, &addr_len);
 
     if (confd == -1)
     {
@@ -366,9 +579,56 @@ while (alive)
     }
 
     printf("connection established\n");
-    read_request(confd, doc_root, file_name);
-    
+
+    //admission control, rejected clients are answered right here
+    reap_children(children, &active);
+    if (!take_token(client_addr.sin_addr.s_addr, rate, burst))
+    {
+        reject_connection(confd, "429 Too Many Requests");
+        continue;
+    }
+    if (active >= max_connections)
+    {
+        reject_connection(confd, "503 Service Unavailable");
+        continue;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        reject_connection(confd, "503 Service Unavailable");
+        continue;
+    }
+
+    if (pid == 0)
+    {
+        //the child handles the connection and may be terminated right away
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        close(sock_fd);
+        free(children);
+
+        struct timeval timeout = { .tv_sec = IO_TIMEOUT, .tv_usec = 0 };
+        setsockopt(confd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(confd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        alarm(REQUEST_TIMEOUT);
+
+        read_request(confd, doc_root, file_name);
+        exit(EXIT_SUCCESS);
+    }
+
+    children[active++] = pid;
+    close(confd);
+}
+
+//stop the children still handling connections
+for (int i = 0; i < active; i++)
+{
+    kill(children[i], SIGTERM);
 }
+while (wait(NULL) > 0 || errno == EINTR);
+free(children);
 
 //close resources and exit
 close(sock_fd);
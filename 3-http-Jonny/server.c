@@ -22,10 +22,39 @@
 #include <time.h>
 #include <signal.h> 
 #include <assert.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+
+// Files up to this size are served from a memory mapping, larger ones with sendfile
+#define MMAP_THRESHOLD (1024 * 1024)
+// Number of mappings which are kept to be reused by later requests
+#define MAPPING_CACHE_SIZE 32
+
+/**
+ * @brief
+ * A file mapped into memory which can be shared by multiple requests
+**/
+typedef struct {
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    void *addr;
+    // number of requests currently sending from this mapping
+    int refcount;
+    // value of mapping_clock when the mapping was used the last time
+    unsigned long last_used;
+} mapping_t;
 
 static char *prog_name;
 volatile sig_atomic_t quit = 0;
 
+// Whether files are sent straight from mappings/with sendfile instead of stdio (-m)
+static bool use_mmap = false;
+static mapping_t mappings[MAPPING_CACHE_SIZE];
+static unsigned long mapping_clock = 0;
+
 
 /**
  * @brief
@@ -48,7 +77,7 @@ void handle_signal(int signal) { quit = 1; }
 **/
 void usage(void)
 {
-    fprintf(stderr, "[%s] Usage: %s [-p PORT] [-i INDEX] DOC_ROOT\n", prog_name, prog_name);
+    fprintf(stderr, "[%s] Usage: %s [-p PORT] [-i INDEX] [-m] DOC_ROOT\n", prog_name, prog_name);
     exit(EXIT_FAILURE);
 }
 
@@ -238,6 +267,179 @@ void write_content(FILE *input_file, FILE *socket_file){
 }
 
 
+/**
+ * @brief
+ * Writes the whole buffer to the file descriptor
+ * 
+ * @details
+ * Repeats the write until everything is written, as write may write less than requested.
+ * @param fd The file descriptor to write to
+ * @param buffer The data to write
+ * @param size The number of bytes to write
+ * @return Returns 0 on success and -1 on failure
+**/
+int write_all(int fd, const char *buffer, size_t size){
+    while(size > 0){
+        ssize_t written = write(fd, buffer, size);
+        if(written == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            return -1;
+        }
+        buffer += written;
+        size -= written;
+    }
+    return 0;
+}
+
+/**
+ * @brief
+ * Returns a mapping of the file at the specified path
+ * 
+ * @details
+ * Reuses an existing mapping if the file didn't change since it was mapped. Otherwise the file
+ * is mapped and the least recently used mapping nobody references is replaced. The reference count
+ * of the returned mapping is increased, release it with release_mapping.
+ * @param path The path to the file
+ * @param fd The opened file, it is only used if the file has to be mapped
+ * @param st The stat of the file
+ * @return Returns the mapping or NULL on failure
+**/
+mapping_t* acquire_mapping(char *path, int fd, struct stat *st){
+    mapping_t *victim = NULL;
+    for(int i = 0; i < MAPPING_CACHE_SIZE; i++){
+        mapping_t *m = &mappings[i];
+        if(m->path != NULL && strcmp(m->path, path) == 0 && m->dev == st->st_dev && m->ino == st->st_ino
+            && m->size == st->st_size && m->mtime.tv_sec == st->st_mtim.tv_sec && m->mtime.tv_nsec == st->st_mtim.tv_nsec){
+            m->refcount++;
+            m->last_used = ++mapping_clock;
+            return m;
+        }
+        if(m->refcount == 0 && (victim == NULL || m->path == NULL || (victim->path != NULL && m->last_used < victim->last_used))){
+            victim = m;
+        }
+    }
+
+    // every mapping is in use, the caller has to fall back to sendfile
+    if(victim == NULL){
+        return NULL;
+    }
+
+    void *addr = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(addr == MAP_FAILED){
+        fprintf(stderr, "[%s] Error mmap failed (%s)\n", prog_name, strerror(errno));
+        return NULL;
+    }
+    char *path_copy = strdup(path);
+    if(path_copy == NULL){
+        munmap(addr, st->st_size);
+        return NULL;
+    }
+
+    // the file is read front to back and will be needed right away
+    madvise(addr, st->st_size, MADV_SEQUENTIAL);
+    madvise(addr, st->st_size, MADV_WILLNEED);
+
+    if(victim->path != NULL){
+        munmap(victim->addr, victim->size);
+        free(victim->path);
+    }
+    victim->path = path_copy;
+    victim->dev = st->st_dev;
+    victim->ino = st->st_ino;
+    victim->size = st->st_size;
+    victim->mtime = st->st_mtim;
+    victim->addr = addr;
+    victim->refcount = 1;
+    victim->last_used = ++mapping_clock;
+    return victim;
+}
+
+/**
+ * @brief
+ * Releases a mapping returned by acquire_mapping
+ * 
+ * @details
+ * The mapping stays mapped so later requests can reuse it.
+ * @param mapping The mapping to release
+**/
+void release_mapping(mapping_t *mapping){
+    assert(mapping->refcount > 0);
+    mapping->refcount--;
+}
+
+/**
+ * @brief
+ * Unmaps all mappings
+**/
+void free_mappings(void){
+    for(int i = 0; i < MAPPING_CACHE_SIZE; i++){
+        if(mappings[i].path != NULL){
+            munmap(mappings[i].addr, mappings[i].size);
+            free(mappings[i].path);
+            mappings[i].path = NULL;
+        }
+    }
+}
+
+/**
+ * @brief
+ * Writes the content to the connection without copying it through user-space buffers
+ * 
+ * @details
+ * Small files are written straight from a (reused) memory mapping, large files are sent with sendfile.
+ * If neither works the content is copied with write_content.
+ * @param path The path of the file, used to find a mapping which can be reused.
+ * @param input_file The FILE* from which should be read.
+ * @param socket_file The FILE* to which should be written. This is the connection file which msut be opened before
+**/
+void write_content_zero_copy(char *path, FILE *input_file, FILE *socket_file){
+    int input_fd = fileno(input_file);
+    int socket_fd = fileno(socket_file);
+    struct stat st;
+
+    // everything buffered in the FILE* must be sent before we write to the fd directly
+    fflush(socket_file);
+
+    if(fstat(input_fd, &st) == -1 || !S_ISREG(st.st_mode)){
+        write_content(input_file, socket_file);
+        return;
+    }
+    if(st.st_size == 0){
+        return;
+    }
+
+    if(st.st_size <= MMAP_THRESHOLD){
+        mapping_t *mapping = acquire_mapping(path, input_fd, &st);
+        if(mapping != NULL){
+            if(write_all(socket_fd, mapping->addr, mapping->size) == -1){
+                fprintf(stderr, "[%s] Error write failed (%s)\n", prog_name, strerror(errno));
+            }
+            release_mapping(mapping);
+            return;
+        }
+    }
+
+    posix_fadvise(input_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    off_t offset = 0;
+    while(offset < st.st_size){
+        ssize_t sent = sendfile(socket_fd, input_fd, &offset, st.st_size - offset);
+        if(sent == -1 && errno == EINTR){
+            continue;
+        }
+        if(sent == -1 && offset == 0){
+            // sendfile isn't supported for this file, copy it the old way
+            write_content(input_file, socket_file);
+            return;
+        }
+        if(sent <= 0){
+            fprintf(stderr, "[%s] Error sendfile failed (%s)\n", prog_name, strerror(errno));
+            return;
+        }
+    }
+}
+
 /**
  * @brief
  * Accepts the next pending connection
@@ -347,7 +549,7 @@ int main(int argc, char *argv[])
     port = "8080";
     index_filename = "index.html";
 
-    while ((opt = getopt(argc, argv, "p:i:")) != -1)
+    while ((opt = getopt(argc, argv, "p:i:m")) != -1)
     {
         switch (opt)
         {
@@ -374,6 +576,9 @@ int main(int argc, char *argv[])
 
             index_filename = optarg;
             break;
+        case 'm':
+            use_mmap = true;
+            break;
         default:
             usage();
             break;
@@ -448,7 +653,12 @@ int main(int argc, char *argv[])
         // Write the normal header and content if the status code is 200. Otherwise write the error header and no content
         if(status_code == 200){
             write_header(status_code, full_path, connect_file);
-            write_content(input_file, connect_file);
+            if(use_mmap){
+                write_content_zero_copy(full_path, input_file, connect_file);
+            }
+            else{
+                write_content(input_file, connect_file);
+            }
             //write_content(input_file, stderr);
         }
         else{
@@ -465,6 +675,7 @@ int main(int argc, char *argv[])
 
     // Free resources
     free(buffer);
+    free_mappings();
     
     exit(EXIT_SUCCESS);
 }
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include "cache.h"
+
+/**
+ * @file cache.c
+ * @date 15.01.2021
+ * @brief Shared memory response cache
+ * @details Small files are kept in a shared memory region that all worker processes of
+ * the server map. The region consists of a fixed-size open-addressing index and an arena
+ * of slabs the file contents are stored in. Readers never lock, they validate what they
+ * read with the sequence counter of the slot. Changes are made by a single writer at a
+ * time (whoever holds the writer semaphore), which also evicts the least recently used
+ * files when the arena or the index is full.
+ */
+
+static uint32_t hash_path(const char* path);
+static cache_slot_t* find_slot(response_cache_t* cache, const char* path);
+static bool copy_content(response_cache_t* cache, cache_slot_t* slot, char* buf, size_t length);
+static bool is_current(cache_slot_t* slot, const struct stat* st);
+static void begin_write(cache_slot_t* slot);
+static void end_write(cache_slot_t* slot);
+static void remove_slot(response_cache_t* cache, cache_slot_t* slot);
+static void evict(response_cache_t* cache);
+
+response_cache_t* cache_create(void) {
+    char name[64];
+    snprintf(name, sizeof(name), "/osue-http-cache-%ld", (long) getpid());
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    // the new object is filled with zeros, so all slots start out empty
+    if (ftruncate(fd, sizeof(response_cache_t)) < 0) {
+        int error = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = error;
+        return NULL;
+    }
+
+    response_cache_t* cache = mmap(NULL, sizeof(response_cache_t), PROT_READ | PROT_WRITE,
+        MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    shm_unlink(name);
+    if (cache == MAP_FAILED) {
+        errno = error;
+        return NULL;
+    }
+
+    if (sem_init(&cache->writer, 1, 1) < 0) {
+        error = errno;
+        munmap(cache, sizeof(response_cache_t));
+        errno = error;
+        return NULL;
+    }
+
+    // all slabs are free in the beginning
+    for (uint32_t i = 0; i < CACHE_SLABS; i++) {
+        cache->next_slab[i] = i + 1;
+    }
+    cache->next_slab[CACHE_SLABS - 1] = CACHE_NO_SLAB;
+    cache->free_slab = 0;
+    cache->free_slabs = CACHE_SLABS;
+
+    return cache;
+}
+
+void cache_destroy(response_cache_t* cache) {
+    munmap(cache, sizeof(response_cache_t));
+}
+
+bool cache_lookup(response_cache_t* cache, const char* path, const struct stat* st, char* buf) {
+    if (st->st_size > CACHE_MAX_FILE_SIZE || strlen(path) >= CACHE_MAX_PATH) {
+        return false;
+    }
+
+    uint32_t hash = hash_path(path);
+    for (uint32_t i = 0; i < CACHE_SLOTS; i++) {
+        cache_slot_t* slot = &cache->slots[(hash + i) & (CACHE_SLOTS - 1)];
+
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            // slot is being written right now, the file might be somewhere further
+            continue;
+        }
+
+        uint32_t state = slot->state;
+        if (state == CACHE_SLOT_EMPTY) {
+            return false;
+        }
+        if (state == CACHE_SLOT_DELETED || strncmp(slot->path, path, CACHE_MAX_PATH) != 0) {
+            continue;
+        }
+
+        bool hit = is_current(slot, st) && copy_content(cache, slot, buf, st->st_size);
+
+        // only trust the copy if the writer didn't touch the slot in the meantime
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+            return false;
+        }
+
+        if (hit) {
+            uint64_t now = __atomic_add_fetch(&cache->clock, 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&slot->last_used, now, __ATOMIC_RELAXED);
+        }
+        return hit;
+    }
+
+    return false;
+}
+
+void cache_insert(response_cache_t* cache, const char* path, const struct stat* st, const char* data) {
+    size_t length = st->st_size;
+    if (length > CACHE_MAX_FILE_SIZE || strlen(path) >= CACHE_MAX_PATH) {
+        return;
+    }
+
+    // somebody else is writing, don't wait for them
+    if (sem_trywait(&cache->writer) < 0) {
+        return;
+    }
+
+    // drop an outdated version of the file
+    cache_slot_t* slot = find_slot(cache, path);
+    if (slot != NULL) {
+        remove_slot(cache, slot);
+    }
+
+    uint32_t needed = (length + CACHE_SLAB_SIZE - 1) / CACHE_SLAB_SIZE;
+    while ((cache->free_slabs < needed || cache->entries >= CACHE_MAX_ENTRIES)
+            && cache->entries > 0) {
+        evict(cache);
+    }
+
+    // take the first free slot of the probe sequence, there always is one as the index is
+    // never filled completely
+    uint32_t hash = hash_path(path);
+    for (uint32_t i = 0; i < CACHE_SLOTS; i++) {
+        slot = &cache->slots[(hash + i) & (CACHE_SLOTS - 1)];
+        if (slot->state != CACHE_SLOT_USED) {
+            break;
+        }
+    }
+
+    begin_write(slot);
+
+    // take the slabs from the free list and fill them
+    uint32_t* link = &slot->first_slab;
+    for (uint32_t i = 0; i < needed; i++) {
+        uint32_t slab = cache->free_slab;
+        cache->free_slab = cache->next_slab[slab];
+        cache->free_slabs--;
+
+        size_t n = length - (size_t) i * CACHE_SLAB_SIZE;
+        if (n > CACHE_SLAB_SIZE) n = CACHE_SLAB_SIZE;
+        memcpy(cache->arena[slab], data + (size_t) i * CACHE_SLAB_SIZE, n);
+
+        *link = slab;
+        link = &cache->next_slab[slab];
+    }
+    *link = CACHE_NO_SLAB;
+
+    strcpy(slot->path, path);
+    slot->dev = st->st_dev;
+    slot->ino = st->st_ino;
+    slot->size = st->st_size;
+    slot->mtime = st->st_mtim;
+    slot->last_used = __atomic_add_fetch(&cache->clock, 1, __ATOMIC_RELAXED);
+    slot->state = CACHE_SLOT_USED;
+    cache->entries++;
+
+    end_write(slot);
+
+    sem_post(&cache->writer);
+}
+
+/**
+ * @brief FNV-1a hash of path.
+ */
+static uint32_t hash_path(const char* path) {
+    uint32_t hash = 2166136261u;
+    for (; *path != '\0'; path++) {
+        hash ^= (unsigned char) *path;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Returns the used slot for path or NULL. Only the writer may call this.
+ */
+static cache_slot_t* find_slot(response_cache_t* cache, const char* path) {
+    uint32_t hash = hash_path(path);
+    for (uint32_t i = 0; i < CACHE_SLOTS; i++) {
+        cache_slot_t* slot = &cache->slots[(hash + i) & (CACHE_SLOTS - 1)];
+        if (slot->state == CACHE_SLOT_EMPTY) {
+            return NULL;
+        }
+        if (slot->state == CACHE_SLOT_USED && strcmp(slot->path, path) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Copies length bytes of the content of slot into buf.
+ * @details As the writer might change the slab chain at the same time, every link is
+ * checked before it is followed. Returns false if the chain is broken.
+ */
+static bool copy_content(response_cache_t* cache, cache_slot_t* slot, char* buf, size_t length) {
+    uint32_t slab = slot->first_slab;
+    for (size_t offset = 0; offset < length; offset += CACHE_SLAB_SIZE) {
+        if (slab >= CACHE_SLABS) {
+            return false;
+        }
+        size_t n = length - offset;
+        if (n > CACHE_SLAB_SIZE) n = CACHE_SLAB_SIZE;
+        memcpy(buf + offset, cache->arena[slab], n);
+        slab = cache->next_slab[slab];
+    }
+    return true;
+}
+
+/**
+ * @brief Checks if the cached content of slot still belongs to the file described by st.
+ */
+static bool is_current(cache_slot_t* slot, const struct stat* st) {
+    return slot->dev == st->st_dev && slot->ino == st->st_ino && slot->size == st->st_size
+        && slot->mtime.tv_sec == st->st_mtim.tv_sec && slot->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Makes the sequence counter of slot odd, so readers ignore it until end_write.
+ */
+static void begin_write(cache_slot_t* slot) {
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Makes the sequence counter of slot even again, publishing the changes.
+ */
+static void end_write(cache_slot_t* slot) {
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Marks slot as deleted and gives its slabs back to the free list. Only the writer
+ * may call this.
+ */
+static void remove_slot(response_cache_t* cache, cache_slot_t* slot) {
+    begin_write(slot);
+
+    uint32_t slab = slot->first_slab;
+    while (slab != CACHE_NO_SLAB) {
+        uint32_t next = cache->next_slab[slab];
+        cache->next_slab[slab] = cache->free_slab;
+        cache->free_slab = slab;
+        cache->free_slabs++;
+        slab = next;
+    }
+    slot->state = CACHE_SLOT_DELETED;
+    cache->entries--;
+
+    end_write(slot);
+}
+
+/**
+ * @brief Removes the least recently used file from the cache. Only the writer may call this.
+ */
+static void evict(response_cache_t* cache) {
+    cache_slot_t* oldest = NULL;
+    for (uint32_t i = 0; i < CACHE_SLOTS; i++) {
+        cache_slot_t* slot = &cache->slots[i];
+        if (slot->state != CACHE_SLOT_USED) {
+            continue;
+        }
+        if (oldest == NULL || __atomic_load_n(&slot->last_used, __ATOMIC_RELAXED)
+                < __atomic_load_n(&oldest->last_used, __ATOMIC_RELAXED)) {
+            oldest = slot;
+        }
+    }
+
+    if (oldest != NULL) {
+        remove_slot(cache, oldest);
+    }
+}
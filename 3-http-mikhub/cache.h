@@ -0,0 +1,109 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/** Number of entries in the index (must be a power of two) */
+#define CACHE_SLOTS 1024
+/** Maximum number of files in the cache, keeps the probe sequences short */
+#define CACHE_MAX_ENTRIES (CACHE_SLOTS / 4 * 3)
+/** Size of one slab of the data arena */
+#define CACHE_SLAB_SIZE 4096
+/** Number of slabs in the data arena (16 MiB) */
+#define CACHE_SLABS 4096
+/** Only files up to this size are cached */
+#define CACHE_MAX_FILE_SIZE (64 * 1024)
+/** Maximum length of a cached path including the terminating 0 */
+#define CACHE_MAX_PATH 256
+
+/** Marks the end of a slab chain and an empty free list */
+#define CACHE_NO_SLAB UINT32_MAX
+
+#define CACHE_SLOT_EMPTY 0
+#define CACHE_SLOT_USED 1
+#define CACHE_SLOT_DELETED 2
+
+/**
+ * @brief One slot of the open-addressing index
+ * @details Readers access slots without a lock, they only trust what they read if seq
+ * was even and didn't change while they read. The writer makes seq odd while it changes
+ * the slot and the slabs the slot points to.
+ */
+typedef struct {
+    /** Sequence counter, odd while the slot is being written */
+    uint32_t seq;
+    /** One of CACHE_SLOT_EMPTY, CACHE_SLOT_USED or CACHE_SLOT_DELETED */
+    uint32_t state;
+    /** Path of the cached file */
+    char path[CACHE_MAX_PATH];
+    /** Device, inode, size and modification time of the file when it was cached */
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    /** First slab of the content, the others are linked in next_slab */
+    uint32_t first_slab;
+    /** Value of the clock at the last hit, used to evict the least recently used file */
+    uint64_t last_used;
+} cache_slot_t;
+
+/**
+ * @brief The shared memory region every worker maps
+ */
+typedef struct {
+    /** Only the process holding this semaphore may change the cache */
+    sem_t writer;
+    /** Incremented on every hit */
+    uint64_t clock;
+    /** Number of used slots */
+    uint32_t entries;
+    /** Head and length of the list of free slabs (only used by the writer) */
+    uint32_t free_slab;
+    uint32_t free_slabs;
+    /** Link to the next slab of the same file or free list */
+    uint32_t next_slab[CACHE_SLABS];
+    cache_slot_t slots[CACHE_SLOTS];
+    char arena[CACHE_SLABS][CACHE_SLAB_SIZE];
+} response_cache_t;
+
+/**
+ * @brief Creates the cache in a new shared memory object and maps it.
+ * @details The shared memory object is unlinked right away, so only this process and
+ * the children forked afterwards can use it and nothing is left behind on exit.
+ * Returns NULL on error.
+ */
+response_cache_t* cache_create(void);
+
+/**
+ * @brief Unmaps the cache.
+ */
+void cache_destroy(response_cache_t* cache);
+
+/**
+ * @brief Looks up the file at path and copies its content into buf, which must be able
+ * to hold CACHE_MAX_FILE_SIZE bytes.
+ * @details Returns true on a hit. Entries whose file was changed since it was cached
+ * (according to st) are treated as a miss. This function never blocks.
+ */
+bool cache_lookup(response_cache_t* cache, const char* path, const struct stat* st, char* buf);
+
+/**
+ * @brief Inserts the content of the file at path into the cache, evicting the least
+ * recently used files if there is not enough space.
+ * @details If another process is currently writing the file is not cached, so this
+ * function never blocks either.
+ */
+void cache_insert(response_cache_t* cache, const char* path, const struct stat* st, const char* data);
+
+#endif
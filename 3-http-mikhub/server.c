@@ -3,6 +3,8 @@
 
 static server_arg_t parse_arguments(int argc, char** argv);
 static void set_signal_handler(void);
+static void run_workers(void);
+static void serve_connections(void);
 static server_socket_t setup_server_socket(void);
 static client_connection_t accept_next_connection(void);
 static void handle_connection(client_connection_t conn);
@@ -13,10 +15,11 @@ static void handle_signal(int signal);
 static size_t get_file_size(FILE* file);
 static char* get_current_date_time(void);
 static char* get_mime_type(char* path);
+static char* get_cached_content(char* path, size_t* length);
 static void close_server_socket(server_socket_t sock);
 
 char* PROGRAM_NAME;
-char* USAGE_MESSAGE = "Usage: %s [-p PORT] [-i INDEX] \n";
+char* USAGE_MESSAGE = "Usage: %s [-p PORT] [-i INDEX] [-w WORKERS] \n";
 
 /**
  * @file client.c
@@ -25,6 +28,8 @@ char* USAGE_MESSAGE = "Usage: %s [-p PORT] [-i INDEX] \n";
  * @brief OSUE Exercise 3 http
  * @details This server program partially implements version 1.1 of the HTTP. 
  * The server waits for connections from clients and transmits the requested files.
+ * With -w the connections are accepted by several worker processes, which share a cache
+ * of small files in shared memory.
  */
 
 // The following variables are global because they are relevant in the whole context of
@@ -39,6 +44,9 @@ static server_socket_t server_socket;
 /** Terminate-Flag - set by the signal handler */
 static volatile sig_atomic_t running;
 
+/** Cache of small files shared by all workers (NULL if it couldn't be created) */
+static response_cache_t* cache;
+
 /**
  * @brief Main function handling the program flow
  * @details Uses the global variables args, server_socket, running.
@@ -53,19 +61,19 @@ int main(int argc, char** argv) {
 
     server_socket = setup_server_socket();
 
+    cache = cache_create();
+    if (cache == NULL) {
+        ERROR_LOG("Could not create cache, serving all files from disk", strerror(errno));
+    }
+
     running = true;
-    while(running) {
-        LOG("Waiting for new connection...");
-        client_connection_t conn = accept_next_connection();
-        if (conn.succesful) {
-            LOG("New connection successfully established");
-            handle_connection(conn);
-            LOG("Closed connection");
-        } else {
-            continue;
-        }
+    if (args.workers > 1) {
+        run_workers();
+    } else {
+        serve_connections();
     }
-    
+
+    if (cache != NULL) cache_destroy(cache);
     close_server_socket(server_socket);
     LOG("Closed server socket and freed all resources");
     exit(EXIT_SUCCESS);
@@ -76,11 +84,12 @@ int main(int argc, char** argv) {
  * @details This function terminates the program if the usage of the program is violated
  */ 
 static server_arg_t parse_arguments(int argc, char** argv) {
-    server_arg_t args = {.index = NULL, .port = NULL, .root = NULL};
+    server_arg_t args = {.index = NULL, .port = NULL, .root = NULL, .workers = DEFAULT_WORKERS};
 
-    int count_p = 0, count_i = 0;
+    int count_p = 0, count_i = 0, count_w = 0;
+    char* endptr;
     int c;  
-    while((c = getopt(argc, argv, "p:i:")) != -1 ) {
+    while((c = getopt(argc, argv, "p:i:w:")) != -1 ) {
         switch (c) {
             case 'p':
                 args.port = optarg;
@@ -92,6 +101,15 @@ static server_arg_t parse_arguments(int argc, char** argv) {
                 count_i++;
                 break;
 
+            case 'w':
+                args.workers = strtol(optarg, &endptr, 10);
+                if (*optarg == '\0' || *endptr != '\0' || args.workers < 1 || args.workers > MAX_WORKERS) {
+                    fprintf(stderr, "[%s]: Invalid number of workers '%s'\n", PROGRAM_NAME, optarg);
+                    USAGE();
+                }
+                count_w++;
+                break;
+
             case '?':
                 USAGE();
                 break;
@@ -102,7 +120,7 @@ static server_arg_t parse_arguments(int argc, char** argv) {
         }
     }
     // wrong usage
-    if (count_p > 1 || count_i > 1) {
+    if (count_p > 1 || count_i > 1 || count_w > 1) {
         USAGE();
     }
     if (argc == optind || argc > (optind+1)) {
@@ -147,6 +165,68 @@ static void set_signal_handler(void) {
     }
 }
 
+/**
+ * @brief Forks the worker processes, waits until the server is terminated and then
+ * terminates the workers.
+ * @details Every worker accepts connections on the same server socket. Uses the global
+ * variables args, running.
+ */
+static void run_workers(void) {
+    pid_t workers[MAX_WORKERS];
+    pid_t parent = getpid();
+    long count = 0;
+
+    for (; count < args.workers; count++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            ERROR_LOG("Could not fork worker", strerror(errno));
+            break;
+        }
+        if (pid == 0) {
+            // don't outlive the main process if it gets killed
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (getppid() != parent) exit(EXIT_FAILURE);
+            serve_connections();
+            if (cache != NULL) cache_destroy(cache);
+            close_server_socket(server_socket);
+            exit(EXIT_SUCCESS);
+        }
+        workers[count] = pid;
+    }
+    LOG("Started %ld workers", count);
+
+    // wait returns early if a signal is caught
+    while (running) {
+        if (wait(NULL) < 0 && errno == ECHILD) {
+            ERROR_LOG("All workers exited", NULL);
+            break;
+        }
+    }
+
+    for (long i = 0; i < count; i++) {
+        kill(workers[i], SIGTERM);
+    }
+    while (wait(NULL) > 0 || errno == EINTR);
+}
+
+/**
+ * @brief Accepts and handles connections until the server is terminated.
+ * @details Uses the global variable running.
+ */
+static void serve_connections(void) {
+    while(running) {
+        LOG("Waiting for new connection...");
+        client_connection_t conn = accept_next_connection();
+        if (conn.succesful) {
+            LOG("New connection successfully established");
+            handle_connection(conn);
+            LOG("Closed connection");
+        } else {
+            continue;
+        }
+    }
+}
+
 /**
  * @brief Creates a new server socket listening on the port specified in the program arguments
  * and returns a struct containing the socket fd, the port and the addrinfo struct ai.
@@ -237,7 +317,10 @@ static void handle_connection(client_connection_t conn) {
     LOG("Sent response status %ld %s", res.status.code, res.status.detail);
 
     // only send body if successful
-    if (res.status.code == OK) {
+    if (res.status.code == OK && res.body != NULL) {
+        fwrite(res.body, 1, res.content_length, conn.socket_file);
+        LOG("Sent response body from cache");
+    } else if (res.status.code == OK) {
         char buf[1];
         while (fread(buf, 1, 1, res.content) == 1) {
             fwrite(buf, 1, 1, conn.socket_file);
@@ -249,6 +332,7 @@ static void handle_connection(client_connection_t conn) {
     if (req.path != NULL) free(req.path);
     if (res.date_time != NULL) free(res.date_time);
     if (res.content != NULL) fclose(res.content);
+    if (res.body != NULL) free(res.body);
     if (conn.socket_file != NULL) fclose(conn.socket_file);
 }
 
@@ -304,7 +388,7 @@ static http_request_t get_request_header(client_connection_t conn) {
  * gets the current date/time and returns a struct containing the response values.
  */
 static http_response_t create_response_header(http_request_t req) {
-    http_response_t res = { .content = NULL, .content_length = 0 };
+    http_response_t res = { .content = NULL, .body = NULL, .content_length = 0 };
 
     // check for errors in request
     if (req.method == NULL) { // 500
@@ -361,6 +445,16 @@ static http_response_t create_response_header(http_request_t req) {
     // get mime-type of file
     res.mime_type = get_mime_type(path);
 
+    // small files are served out of the shared cache
+    res.body = get_cached_content(path, &res.content_length);
+    if (res.body != NULL) {
+        free(path);
+        res.date_time = get_current_date_time();
+        res.status.code = OK;
+        res.status.detail = OK_STRING;
+        return res;
+    }
+
     // open file
     res.content = fopen(path, "r");
     free(path);
@@ -415,6 +509,45 @@ static char* get_mime_type(char* path) {
     }
 }
 
+/**
+ * @brief Returns the content of the file at path out of the shared cache and adds the
+ * file to the cache on a miss. Returns NULL if the file is too large to be cached or
+ * something went wrong, then the caller has to send the file from disk.
+ * @details Uses the global variable cache.
+ */
+static char* get_cached_content(char* path, size_t* length) {
+    struct stat st;
+    if (cache == NULL || stat(path, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size > CACHE_MAX_FILE_SIZE) {
+        return NULL;
+    }
+
+    char* content = malloc(CACHE_MAX_FILE_SIZE);
+    if (content == NULL) {
+        return NULL;
+    }
+
+    *length = st.st_size;
+    if (cache_lookup(cache, path, &st, content)) {
+        LOG("Cache hit for %s", path);
+        return content;
+    }
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        free(content);
+        return NULL;
+    }
+    size_t read = fread(content, 1, st.st_size, file);
+    fclose(file);
+    if (read != st.st_size) {
+        free(content);
+        return NULL;
+    }
+
+    cache_insert(cache, path, &st, content);
+    return content;
+}
+
 /**
  * @brief Gets the size of a file in bytes.
  */
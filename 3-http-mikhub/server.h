@@ -16,10 +16,17 @@
 #include <signal.h>
 #include <dirent.h>
 #include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+#include "cache.h"
 
 #define DEFAULT_PORT 8080
 #define DEFAULT_PORT_STRING "8080"
 #define DEFAULT_FILENAME "index.html"
+#define DEFAULT_WORKERS 1
+#define MAX_WORKERS 64
 
 #define OK 200
 #define OK_STRING "OK"
@@ -70,6 +77,8 @@ typedef struct {
     size_t content_length;
     /** File to be sent in response body */
     FILE* content;
+    /** Content of a cached file, sent instead of content if not NULL */
+    char* body;
 } http_response_t;
 
 /**
@@ -103,6 +112,8 @@ typedef struct {
     char* index; 
     /** Directory to serve files out of */
     char* root;
+    /** Number of worker processes accepting connections */
+    long workers;
  } server_arg_t;
 
 #endif
\ No newline at end of file
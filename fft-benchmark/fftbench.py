@@ -0,0 +1,278 @@
+import argparse
+import json
+import math
+import os
+import platform
+import signal
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+try:
+    import numpy as np
+except ImportError:
+    sys.exit("fftbench.py needs numpy (pip install numpy)")
+
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(HERE)
+MEASURE = os.path.join(HERE, "measure")
+
+# Every way to run one of the FFTs. "tree" modes fork about 2N processes and are
+# only run up to 2^tree-max points. "format" is the input/output format: "text"
+# is "re im", "lorix" is "re im*i" and "binary" is raw little-endian complex64.
+MODES = [
+    {"name": "jonny-tree", "dir": "2-forkFFT-Jonny", "args": [], "format": "text", "tree": True},
+    {"name": "jonny-pool", "dir": "2-forkFFT-Jonny", "args": ["-p"], "format": "text", "tree": False},
+    {"name": "jonny-binary", "dir": "2-forkFFT-Jonny", "args": ["-b"], "format": "binary", "tree": False},
+    {"name": "lorix-tree", "dir": "2-forkFFT-Lorix", "args": [], "format": "lorix", "tree": True},
+    {"name": "lorix-engine", "dir": "2-forkFFT-Lorix", "args": ["-e"], "format": "lorix", "tree": False},
+    {"name": "lorix-binary", "dir": "2-forkFFT-Lorix", "args": ["-b"], "format": "binary", "tree": False},
+    {"name": "imaidzz-tree", "dir": "1B-forkFFT-IMaidzz", "args": [], "format": "text", "tree": True},
+    {"name": "imaidzz-binary", "dir": "1B-forkFFT-IMaidzz", "args": ["-b"], "format": "binary", "tree": True},
+    {"name": "imaidzz-shared", "dir": "1B-forkFFT-IMaidzz", "args": ["-s"], "format": "text", "tree": False},
+    {"name": "imaidzz-shared-binary", "dir": "1B-forkFFT-IMaidzz", "args": ["-b", "-s"], "format": "binary", "tree": False},
+]
+
+INPUTS = ["random", "impulse", "constant", "tone"]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare time, processes, memory and accuracy of all forkFFT implementations"
+    )
+    parser.add_argument("--min", type=int, default=1, help="smallest 2^k (default: 1)")
+    parser.add_argument("--max", type=int, default=16, help="largest 2^k (default: 16)")
+    parser.add_argument(
+        "--tree-max",
+        type=int,
+        default=8,
+        help="largest 2^k the process trees are run for (default: 8)",
+    )
+    parser.add_argument(
+        "--modes",
+        default=",".join(m["name"] for m in MODES),
+        help="comma separated modes to run (default: all)",
+    )
+    parser.add_argument(
+        "--inputs",
+        default=",".join(INPUTS),
+        help="comma separated inputs to run (default: all)",
+    )
+    parser.add_argument(
+        "--timeout", type=float, default=60, help="seconds before a run is killed"
+    )
+    parser.add_argument(
+        "--report",
+        default="fft-report.json",
+        help="file the results are written to as JSON",
+    )
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument(
+        "--no-build", action="store_true", help="don't run make in the folders"
+    )
+    args = parser.parse_args()
+
+    modes = [m for m in MODES if m["name"] in args.modes.split(",")]
+    inputs = [i for i in INPUTS if i in args.inputs.split(",")]
+    if not args.no_build:
+        subprocess.run(["make", "-s", "-C", HERE, "measure"], check=True)
+        for directory in sorted({m["dir"] for m in modes}):
+            subprocess.run(
+                ["make", "-s", "-C", os.path.join(ROOT, directory), "all"],
+                check=True,
+                stdout=subprocess.DEVNULL,
+            )
+
+    rng = np.random.default_rng(args.seed)
+    results = []
+    print(
+        f"{'mode':<22} {'input':<9} {'points':>8} {'status':<8} {'time [s]':>9} "
+        + f"{'procs':>7} {'rss [KiB]':>10} {'max rel err':>12}"
+    )
+    for k in range(args.min, args.max + 1):
+        n = 1 << k
+        for input_name in inputs:
+            x = create_input(input_name, n, rng)
+            for mode in modes:
+                if mode["tree"] and k > args.tree_max:
+                    continue
+                result = benchmark(mode, input_name, x, args.timeout)
+                results.append(result)
+                print_result(result)
+
+    report = {
+        "machine": {
+            "system": platform.platform(),
+            "processor": platform.processor(),
+            "cpus": os.cpu_count(),
+        },
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "seed": args.seed,
+        "results": results,
+    }
+    with open(args.report, "w") as f:
+        json.dump(report, f, indent=2)
+        f.write("\n")
+
+    if any(r["status"] != "ok" for r in results):
+        sys.exit(1)
+
+
+# Return the n complex numbers of an input
+def create_input(name: str, n: int, rng) -> np.ndarray:
+    if name == "random":
+        return rng.uniform(-1, 1, n) + 1j * rng.uniform(-1, 1, n)
+    if name == "impulse":
+        x = np.zeros(n, dtype=complex)
+        x[0] = 1
+        return x
+    if name == "constant":
+        return np.ones(n, dtype=complex)
+    # a cosine with 3 periods (or fewer if n is too small), all energy in two bins
+    return np.cos(2 * np.pi * min(3, n // 2) * np.arange(n) / n) + 0j
+
+
+# Encode the numbers in the format of a mode and return them together with the
+# numbers the program actually sees (after rounding to text or float32)
+def encode(x: np.ndarray, fmt: str):
+    if fmt == "binary":
+        data = x.astype(np.complex64)
+        return data.tobytes(), data.astype(complex)
+    suffix = "*i" if fmt == "lorix" else ""
+    lines = [f"{v.real:f} {v.imag:f}{suffix}\n" for v in x]
+    seen = np.array([float(f"{v.real:f}") + 1j * float(f"{v.imag:f}") for v in x])
+    return "".join(lines).encode(), seen
+
+
+# Parse the first n results of an output, the Jonny tree comes after them
+def decode(output: bytes, n: int, fmt: str) -> np.ndarray:
+    if fmt == "binary":
+        return np.frombuffer(output, dtype=np.complex64, count=n).astype(complex)
+    values = []
+    for line in output.decode().splitlines()[:n]:
+        real, imaginary = line.split()
+        values.append(float(real) + 1j * float(imaginary.removesuffix("*i")))
+    if len(values) != n:
+        raise ValueError(f"expected {n} results, got {len(values)}")
+    return np.array(values)
+
+
+# A direct DFT in double precision, the twiddle factors are taken from a table
+# of the n roots of unity so their error doesn't grow with j*k. Large sizes
+# use numpy's FFT, which is accurate to a few ulps.
+def reference_dft(x: np.ndarray) -> np.ndarray:
+    n = len(x)
+    if n > 2048:
+        return np.fft.fft(x)
+    roots = np.exp(-2j * np.pi * np.arange(n) / n)
+    k = np.arange(n)
+    return roots[np.outer(k, k) % n] @ x
+
+
+# Largest error relative to the largest bin: bins that are 0 in the reference
+# (most of them for structured inputs) can't have a meaningful relative error
+def max_relative_error(result: np.ndarray, reference: np.ndarray) -> float:
+    scale = np.max(np.abs(reference))
+    if scale == 0:
+        return float(np.max(np.abs(result)))
+    return float(np.max(np.abs(result - reference)) / scale)
+
+
+# The kernel counts every fork and every new thread in /proc/stat, the
+# difference over a run is the number of tasks it started (plus whatever else
+# runs on the machine at the same time)
+def forks() -> int:
+    with open("/proc/stat") as f:
+        for line in f:
+            if line.startswith("processes "):
+                return int(line.split()[1])
+    return 0
+
+
+# Run one mode on one input and return the result record
+def benchmark(mode, input_name: str, x: np.ndarray, timeout: float) -> dict:
+    n = len(x)
+    data, seen = encode(x, mode["format"])
+    result = {
+        "mode": mode["name"],
+        "directory": mode["dir"],
+        "command": " ".join(["./forkFFT"] + mode["args"]),
+        "input": input_name,
+        "points": n,
+        "status": "ok",
+        "wall_seconds": None,
+        "processes": None,
+        "peak_rss_kib": None,
+        "max_relative_error": None,
+    }
+
+    with tempfile.TemporaryFile() as stdin, tempfile.TemporaryFile() as stdout, \
+            tempfile.NamedTemporaryFile("r") as rss:
+        stdin.write(data)
+        stdin.seek(0)
+        p = None
+        # the tree is killed as a whole, children would keep the pipes open
+        timer = threading.Timer(timeout, lambda: os.killpg(p.pid, signal.SIGKILL))
+        # the thread of the timer is started before counting
+        timer.start()
+        before = forks()
+        start = time.perf_counter()
+        p = subprocess.Popen(
+            [MEASURE, rss.name, "./forkFFT"] + mode["args"],
+            cwd=os.path.join(ROOT, mode["dir"]),
+            stdin=stdin,
+            stdout=stdout,
+            stderr=subprocess.DEVNULL,
+            start_new_session=True,
+        )
+        p.wait()
+        elapsed = time.perf_counter() - start
+        timed_out = not timer.is_alive()
+        timer.cancel()
+
+        result["wall_seconds"] = elapsed
+        # one fork is the one of ./measure, the root of the tree is counted
+        result["processes"] = forks() - before - 1
+        # the largest single process of the tree, not their sum
+        peak = rss.read().strip()
+        result["peak_rss_kib"] = int(peak) if peak else None
+        if timed_out:
+            result["status"] = "timeout"
+            return result
+        if p.returncode != 0:
+            result["status"] = f"exit {p.returncode}"
+            return result
+
+        stdout.seek(0)
+        try:
+            output = decode(stdout.read(), n, mode["format"])
+        except ValueError:
+            result["status"] = "bad output"
+            return result
+
+    result["max_relative_error"] = max_relative_error(output, reference_dft(seen))
+    return result
+
+
+def print_result(r: dict):
+    def column(value, fmt, width):
+        return f"{'-':>{width}}" if value is None else f"{value:{width}{fmt}}"
+
+    print(
+        f"{r['mode']:<22} {r['input']:<9} {r['points']:>8} {r['status']:<8} "
+        + column(r["wall_seconds"], ".3f", 9)
+        + " "
+        + column(r["processes"], "d", 7)
+        + " "
+        + column(r["peak_rss_kib"], "d", 10)
+        + " "
+        + column(r["max_relative_error"], ".2e", 12),
+        flush=True,
+    )
+
+
+if __name__ == "__main__":
+    main()
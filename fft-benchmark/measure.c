@@ -0,0 +1,59 @@
+/**
+ * @file measure.c
+ * @date 17.12.2020
+ *
+ * @brief Runs a command and writes its peak resident set size to a file.
+ *
+ * A process started directly by the benchmark (python with numpy) would inherit the memory
+ * high-water mark of the interpreter through fork and exec. This small launcher has almost no
+ * memory of its own, so the value reported for its child is the one of the command.
+ *
+ * USAGE: ./measure report command [arguments]
+ * The report contains the largest resident set size in KiB of the command and all descendants
+ * it waited for. The exit code is the one of the command (128 + signal if it was killed).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+int main(int argc, char * argv[]){
+    if(argc < 3) {
+        fprintf(stderr, "USAGE: %s report command [arguments]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    pid_t pid = fork();
+    if(pid == -1) {
+        perror("fork");
+        return EXIT_FAILURE;
+    }
+    if(pid == 0) {
+        execvp(argv[2], argv + 2);
+        perror(argv[2]);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    while(wait4(pid, &status, 0, &usage) == -1) {
+        if(errno != EINTR) {
+            perror("wait4");
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE * report = fopen(argv[1], "w");
+    if(report == NULL || fprintf(report, "%ld\n", usage.ru_maxrss) < 0 || fclose(report) == EOF) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    if(WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
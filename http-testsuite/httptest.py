@@ -1,38 +1,131 @@
 import subprocess
 import os
 import shutil
+import socket
+import tempfile
+import threading
+import traceback
 import urllib.request
-from typing import Dict
+from concurrent.futures import ThreadPoolExecutor
+from typing import IO, Callable, Dict, List, Optional, Tuple
 import zlib
 import http.client
+import json
 import time
 
 
+# Ask the kernel for a port that is currently unused. There is a tiny window
+# in which another process could grab it, but that is good enough for tests
+# and allows us to run many servers at the same time.
+def free_port() -> int:
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+        s.bind(("localhost", 0))
+        return s.getsockname()[1]
+
+
+# Return the pids of process and all its descendants (forking servers handle
+# requests in children).
+def process_tree(pid: int) -> List[int]:
+    pids = [pid]
+    for p in pids:
+        try:
+            for task in os.listdir(f"/proc/{p}/task"):
+                with open(f"/proc/{p}/task/{task}/children") as f:
+                    pids.extend(int(c) for c in f.read().split())
+        except OSError:
+            pass
+    return pids
+
+
+# Return the resident memory (in KiB) and the number of open filedescriptors
+# of a process and all its descendants.
+def process_stats(pid: int) -> Dict[str, int]:
+    rss = 0
+    fds = 0
+    for p in process_tree(pid):
+        try:
+            with open(f"/proc/{p}/status") as f:
+                for line in f:
+                    if line.startswith("VmRSS:"):
+                        rss += int(line.split()[1])
+            fds += len(os.listdir(f"/proc/{p}/fd"))
+        except OSError:
+            pass
+    return {"rss_kb": rss, "fds": fds}
+
+
+# Samples the memory usage of a process tree in the background and remembers
+# the peak, use it as context manager around the code to observe.
+class PeakMonitor:
+    def __init__(self, pid: int, interval: float = 0.01):
+        self.pid = pid
+        self.interval = interval
+        self.peak_rss_kb = 0
+        self._stop = threading.Event()
+        self._thread = threading.Thread(target=self._run, daemon=True)
+
+    def _run(self):
+        while not self._stop.is_set():
+            rss = process_stats(self.pid)["rss_kb"]
+            self.peak_rss_kb = max(self.peak_rss_kb, rss)
+            self._stop.wait(self.interval)
+
+    def __enter__(self):
+        self._thread.start()
+        return self
+
+    def __exit__(self, *args):
+        self._stop.set()
+        self._thread.join()
+
+
 class HttpTest:
 
     # The constuctor prints a simple message about this testsuite and
-    # initialises all testcounters and a temporary folder
-    def __init__(self):
+    # initialises all testcounters and a temporary folder.
+    # With valgrind=False the servers are started without valgrind, which is
+    # a lot faster but doesn't find memory leaks. jobs limits how many test
+    # groups run_parallel executes at the same time (0 means number of cpus).
+    def __init__(self, valgrind: bool = True, jobs: int = 0, _group: str = ""):
         self._tests = 0
         self._tests_failed = 0
         self._timeout = 1
+        self._valgrind = valgrind
+        self._jobs = jobs if jobs > 0 else (os.cpu_count() or 1)
+        self._group = _group
+        self._buffer: Optional[List[str]] = [] if _group else None
+        self._scratch = tempfile.mkdtemp(prefix="httptest-")
+        self._server_logs: Dict[int, str] = {}
+        self._server_output: Dict[int, IO[bytes]] = {}
+        if _group:
+            return
+
         self._create_dir()
-        print("OSUE Exercise 3 Testsuite (WS 2020/2021)")
-        print(
+        self.log("OSUE Exercise 3 Testsuite (WS 2020/2021)")
+        self.log(
             "GitHub: https://github.com/flofriday/OSUE-2020/tree/main/http-testsuite\n"
         )
 
+    # Print to stdout, or into the buffer if this is a group running in
+    # parallel so that the output of different groups doesn't get mixed up.
+    def log(self, *args):
+        line = " ".join(str(a) for a in args)
+        if self._buffer is None:
+            print(line)
+        else:
+            self._buffer.append(line)
+
     # Increase the internal testcounter and print a simple message to stdout
     def test_passed(self):
         self._tests += 1
-        print(f"✅ Test {self._tests:02d} Passed")
+        self.log(f"✅ Test {self._group}{self._tests:02d} Passed")
 
     # Increate the interal testscounter and failed tests counter and print a
     # simple message to stdout
     def test_failed(self):
         self._tests += 1
         self._tests_failed += 1
-        print(f"🚨 Test {self._tests:02d} Failed")
+        self.log(f"🚨 Test {self._group}{self._tests:02d} Failed")
 
     # Create a directory called __tmp to be used save output files the client
     # creates.
@@ -42,13 +135,86 @@ class HttpTest:
             shutil.rmtree("__tmp")
         os.makedirs("__tmp")
 
+    # Run every group in its own thread (at most jobs at once). Each group is
+    # called with a fresh HttpTest object so that counters and output stay
+    # separated, afterwards the results are merged into this object in the
+    # order the groups were given. A crashing group counts as a failed test
+    # instead of taking the whole testsuite down.
+    # jobs overwrites the number of groups running at once.
+    def run_parallel(
+        self,
+        groups: List[Callable[["HttpTest"], None]],
+        jobs: Optional[int] = None,
+    ):
+        def run(index: int, group: Callable[["HttpTest"], None]):
+            sub = HttpTest(self._valgrind, self._jobs, _group=f"{index}.")
+            start = time.monotonic()
+            try:
+                group(sub)
+            except Exception:
+                sub.test_failed()
+                sub.log(f'Group "{group.__name__}" crashed:')
+                sub.log(traceback.format_exc())
+            sub._elapsed = time.monotonic() - start
+            sub.cleanup()
+            return sub
+
+        with ThreadPoolExecutor(max_workers=jobs or self._jobs) as pool:
+            futures = [
+                pool.submit(run, i + 1, g) for i, g in enumerate(groups)
+            ]
+            subs = [f.result() for f in futures]
+
+        for group, sub in zip(groups, subs):
+            self.log(
+                f"\n--- {sub._group} {group.__name__} ({sub._elapsed:.2f}s) ---"
+            )
+            for line in sub._buffer:
+                self.log(line)
+            self._tests += sub._tests
+            self._tests_failed += sub._tests_failed
+
+    # Copy the docroot into a new temporary folder so that every server works
+    # on its own files. The folder is removed in cleanup().
+    def isolated_docroot(self, docroot: str) -> str:
+        path = os.path.join(self._scratch, "docroot")
+        shutil.copytree(docroot, path)
+        return path
+
+    # Remove all temporary files this object created.
+    def cleanup(self):
+        shutil.rmtree(self._scratch, ignore_errors=True)
+
+    # Build the valgrind command for command and return it together with the
+    # path of the logfile valgrind will write to.
+    def _valgrind_cmd(self, command: str):
+        fd, log = tempfile.mkstemp(prefix="valgrind-", dir=self._scratch)
+        os.close(fd)
+        return (
+            "valgrind --leak-check=full --show-leak-kinds=all --track-origins=yes --verbose "
+            + f"--log-file={log} {command}",
+            log,
+        )
+
+    # Wait until something accepts connections on port, but at most timeout
+    # seconds. Returns False if nothing did.
+    def _wait_for_port(self, port: int, timeout: float) -> bool:
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            try:
+                with socket.create_connection(("localhost", port), 0.1):
+                    return True
+            except OSError:
+                time.sleep(0.05)
+        return False
+
     # This testcase expects the program to exit with an provided exit code.
     # It is considered failing if the exitcodes are different or if the
     # process does not exit after 0.5 seconds.
     def is_returncode(self, command: str, code: int) -> bool:
         try:
             cp = subprocess.run(
-                command,
+                "exec " + command,
                 stdout=subprocess.PIPE,
                 stderr=subprocess.STDOUT,
                 timeout=self._timeout,
@@ -56,14 +222,14 @@ class HttpTest:
             )
         except subprocess.TimeoutExpired:
             self.test_failed()
-            print(
+            self.log(
                 f'"{command}" ran for more than {self._timeout}s, but was expected to return {code}'
             )
             return False
 
         if not cp.returncode == code:
             self.test_failed()
-            print(
+            self.log(
                 f'"{command}" returned with {cp.returncode} instead of {code}'
             )
             return False
@@ -76,7 +242,7 @@ class HttpTest:
     def does_timeout(self, command: str) -> bool:
         try:
             cp = subprocess.run(
-                command,
+                "exec " + command,
                 stdout=subprocess.PIPE,
                 stderr=subprocess.STDOUT,
                 timeout=self._timeout,
@@ -87,16 +253,13 @@ class HttpTest:
             return True
 
         self.test_failed()
-        print(
+        self.log(
             f'"{command}" should run forever but did exit with {cp.returncode}.'
         )
         return False
 
     def does_leak(self, command: str) -> bool:
-        valgrind_cmd = (
-            "valgrind --leak-check=full --show-leak-kinds=all --track-origins=yes --verbose --log-file=__tmp/valgrind-out.txt "
-            + command
-        )
+        valgrind_cmd, log = self._valgrind_cmd(command)
         try:
             subprocess.run(
                 valgrind_cmd,
@@ -107,16 +270,16 @@ class HttpTest:
             )
         except subprocess.TimeoutExpired:
             self.test_failed()
-            print(
+            self.log(
                 f'"{command}" with valgrind ran for more than {self._timeout * 10}s, but was expected to execute faster.'
             )
             return False
 
         # Read the outputfile and delte it again
-        f = open("__tmp/valgrind-out.txt", "rb")
+        f = open(log, "rb")
         output = f.read().decode("utf-8")
         f.close()
-        os.remove("__tmp/valgrind-out.txt")
+        os.remove(log)
 
         # Parse the outputfile
         if (
@@ -124,9 +287,9 @@ class HttpTest:
             or "ERROR SUMMARY: 0 errors from 0 contexts" not in output
         ):
             self.test_failed()
-            print(f'"{command}" resulted in a memmory corruption/leak.')
-            print("Run the following to reproduce the error:")
-            print(
+            self.log(f'"{command}" resulted in a memmory corruption/leak.')
+            self.log("Run the following to reproduce the error:")
+            self.log(
                 f"valgrind --leak-check=full --show-leak-kinds=all --track-origins=yes --verbose {command}"
             )
             return False
@@ -136,23 +299,47 @@ class HttpTest:
 
     # Start the server to test it
     # This is not a test
-    def start_server(self, command: str) -> subprocess.Popen:
-        valgrind_cmd = (
-            "valgrind --leak-check=full --show-leak-kinds=all --track-origins=yes --verbose --log-file=__tmp/valgrind-out.txt "
-            + command
-        )
+    # If port is given we wait until the server accepts connections on it
+    # instead of sleeping for a fixed time. valgrind overwrites the setting
+    # from the constructor for this server only.
+    def start_server(
+        self,
+        command: str,
+        port: Optional[int] = None,
+        valgrind: Optional[bool] = None,
+    ) -> subprocess.Popen:
+        if valgrind is None:
+            valgrind = self._valgrind
+
+        log = None
+        if valgrind:
+            command, log = self._valgrind_cmd(command)
+        # The output goes to a file and not a pipe, as nobody reads the pipe
+        # while the server runs and a full pipe would block the server.
+        output = tempfile.TemporaryFile(dir=self._scratch)
         p = subprocess.Popen(
-            valgrind_cmd,
+            "exec " + command,
             shell=True,
-            stdout=subprocess.PIPE,
+            stdout=output,
             stderr=subprocess.STDOUT,
         )
-        time.sleep(3)
+        self._server_output[p.pid] = output
+        if log is not None:
+            self._server_logs[p.pid] = log
+
+        if port is None:
+            time.sleep(3)
+        elif not self._wait_for_port(port, 10 if valgrind else 3):
+            self.log(f'"{command}" did not accept connections on {port}')
         return p
 
     # Stop the server
-    # This tests the server for leaks and if it can handle sigterm
-    def stop_server(self, process: subprocess.Popen):
+    # This tests the server for leaks (if started with valgrind) and if it can
+    # handle sigterm. With show_output=False the output of the server is not
+    # printed.
+    def stop_server(
+        self, process: subprocess.Popen, show_output: bool = True
+    ) -> bool:
         success = True
         try:
             process.terminate()
@@ -160,41 +347,51 @@ class HttpTest:
             self.test_passed()
         except subprocess.TimeoutExpired:
             self.test_failed()
-            print(
+            self.log(
                 "The server didn't terminate in the 0.5sec after SIGTERM was sent"
             )
+            process.kill()
+            process.wait()
             success = False
 
-        # Parse valgrind
-        f = open("__tmp/valgrind-out.txt", "rb")
+        log = self._server_logs.pop(process.pid, None)
+        if log is not None:
+            success = self._check_server_log(log) and success
+
+        output = self._server_output.pop(process.pid)
+        output.seek(0)
+        if show_output:
+            self.log("\n--- Server Output Start ---")
+            self.log(output.read().decode(errors="replace").strip())
+            self.log("--- Server Output End ---")
+        output.close()
+        return success
+
+    # Parse the valgrind logfile of a stopped server
+    def _check_server_log(self, log: str) -> bool:
+        f = open(log, "rb")
         output = f.read().decode("utf-8")
         f.close()
-        os.remove("__tmp/valgrind-out.txt")
+        os.remove(log)
 
-        # Parse the outputfile
         if (
             "All heap blocks were freed -- no leaks are possibl" not in output
             or "ERROR SUMMARY: 0 errors from 0 contexts" not in output
         ):
             self.test_failed()
-            print("The server has a memmory corruption/leak.")
-            print(
+            self.log("The server has a memmory corruption/leak.")
+            self.log(
                 "Start your server with the following and request some files:"
             )
-            print(
+            self.log(
                 "valgrind --leak-check=full --show-leak-kinds=all --track-origins=yes --verbose ./server -p 1339 __docroot/"
             )
-            print("--- Valgrind Output ---")
-            print(output)
-
-            success = False
-        else:
-            self.test_passed()
+            self.log("--- Valgrind Output ---")
+            self.log(output)
+            return False
 
-        print("\n--- Server Output Start ---")
-        print(process.stdout.read().decode().strip())
-        print("--- Server Output End ---")
-        return success
+        self.test_passed()
+        return True
 
     # This test runs the command and checks afterwards if the file at path got
     # created. However, this test does not check if the file has any content
@@ -212,19 +409,19 @@ class HttpTest:
             )
         except subprocess.TimeoutExpired:
             self.test_failed()
-            print(
+            self.log(
                 f'"{command}" ran for more than {self._timeout}s, but was expected to execute faster.'
             )
             return False
 
         if cp.returncode != 0:
             self.test_failed()
-            print(f'"{command}" returned with {cp.returncode} instead of 0')
+            self.log(f'"{command}" returned with {cp.returncode} instead of 0')
             return False
 
         if not os.path.exists(path):
             self.test_failed()
-            print(f'"{command}" did not create file "{path}"')
+            self.log(f'"{command}" did not create file "{path}"')
             return False
 
         self.test_passed()
@@ -247,19 +444,19 @@ class HttpTest:
             )
         except subprocess.TimeoutExpired:
             self.test_failed()
-            print(
+            self.log(
                 f'"{command}" ran for more than {self._timeout}s, but was expected to execute faster.'
             )
             return False
 
         if cp.returncode != 0:
             self.test_failed()
-            print(f'"{command}" returned with {cp.returncode} instead of 0')
+            self.log(f'"{command}" returned with {cp.returncode} instead of 0')
             return False
 
         if not os.path.exists(path):
             self.test_failed()
-            print(f'"{command}" did not create file "{path}"')
+            self.log(f'"{command}" did not create file "{path}"')
             return False
 
         res = urllib.request.urlopen(url)
@@ -269,7 +466,7 @@ class HttpTest:
         output = file.read()
         if body != output:
             self.test_failed()
-            print(
+            self.log(
                 f'"{command}" did not create the same output as Python 3 (with urllib).'
             )
             return False
@@ -299,28 +496,28 @@ class HttpTest:
             res_headers = e.headers
         except urllib.error.URLError as e:
             self.test_failed()
-            print(f"Request to {url} failed horribly. Reason: {e.reason}")
+            self.log(f"Request to {url} failed horribly. Reason: {e.reason}")
             if method != "GET":
-                print(f"The request was made with HTTP-Method {method}.")
+                self.log(f"The request was made with HTTP-Method {method}.")
             if headers != {}:
-                print(
+                self.log(
                     f'The request was send with the additional header "{headers}"'
                 )
             return False
 
         if name not in res_headers or value != res_headers[name]:
             self.test_failed()
-            print(
+            self.log(
                 f'Response to "{url}" did not contain "{name}: {value}" in the headers.'
             )
             if method != "GET":
-                print(f"The request was made with HTTP-Method {method}.")
+                self.log(f"The request was made with HTTP-Method {method}.")
             if headers != {}:
-                print(
+                self.log(
                     f'The request was send with the additional header "{headers}"'
                 )
             if name in res_headers:
-                print(f'Closest Header was: "{name}: {res_headers[name]}"')
+                self.log(f'Closest Header was: "{name}: {res_headers[name]}"')
             return False
 
         self.test_passed()
@@ -341,18 +538,18 @@ class HttpTest:
             headers = e.headers
         except urllib.error.URLError as e:
             self.test_failed()
-            print(f"Request to {url} failed horribly. Reason: {e.reason}")
+            self.log(f"Request to {url} failed horribly. Reason: {e.reason}")
             if method != "GET":
-                print(f"The request was made with HTTP-Method {method}.")
+                self.log(f"The request was made with HTTP-Method {method}.")
             return False
 
         if name in headers and value == headers[name]:
             self.test_failed()
-            print(
+            self.log(
                 f'Response to "{url}" did contain "{name}: {value}" in the headers.'
             )
             if method != "GET":
-                print(f"The request was made with HTTP-Method {method}.")
+                self.log(f"The request was made with HTTP-Method {method}.")
             return False
 
         self.test_passed()
@@ -371,12 +568,12 @@ class HttpTest:
             pass
         except urllib.error.URLError as e:
             self.test_failed()
-            print(f"The request failed: {e.reason}")
+            self.log(f"The request failed: {e.reason}")
             return False
 
         if "Content-Length" not in res.headers:
             self.test_failed()
-            print(
+            self.log(
                 f'Response to {url} did not contain the header "Content-Length"'
             )
             return False
@@ -384,7 +581,7 @@ class HttpTest:
         size = int(res.headers["Content-Length"])
         if size != content_size:
             self.test_failed()
-            print(
+            self.log(
                 f'The response to "{url}" had the header "Content-Length: {content_size}" however the body sent was {size} bytes long.'
             )
             return False
@@ -405,7 +602,7 @@ class HttpTest:
             raw_body = e.partial
         except urllib.error.URLError as e:
             self.test_failed()
-            print(
+            self.log(
                 f"The request returned with status {e.reason} instead of 200"
             )
             return False
@@ -422,17 +619,17 @@ class HttpTest:
         content = open(path, "rb").read()
         if body != content:
             self.test_failed()
-            print(
+            self.log(
                 f'"Response to {url}" was not the same content as in "{path}"'
             )
-            print(
+            self.log(
                 f"Response was {len(body)} bytes while original was {len(content)}"
             )
             if headers != {}:
-                print(
+                self.log(
                     f'The request was send with the additional header "{headers}"'
                 )
-            print(
+            self.log(
                 "NOTE: This might be because you haven't yet implemented the bonus task, binary files."
             )
             return False
@@ -461,26 +658,26 @@ class HttpTest:
             code = e.code
         except urllib.error.URLError as e:
             self.test_failed()
-            print(f"Request to {url} failed horribly. Reason: {e.reason}")
+            self.log(f"Request to {url} failed horribly. Reason: {e.reason}")
             if headers != {}:
-                print(
+                self.log(
                     f'The request was send with the additional header "{headers}"'
                 )
             if method != "GET":
-                print(f"The request was made with HTTP-Method {method}.")
+                self.log(f"The request was made with HTTP-Method {method}.")
             return False
 
         if status != code:
             self.test_failed()
-            print(
+            self.log(
                 f'"Response to {url}" returned with status {code} instead of {status}'
             )
             if headers != {}:
-                print(
+                self.log(
                     f'The request was send with the additional header "{headers}"'
                 )
             if method != "GET":
-                print(f"The request was made with HTTP-Method {method}.")
+                self.log(f"The request was made with HTTP-Method {method}.")
             return False
 
         self.test_passed()
@@ -498,7 +695,7 @@ class HttpTest:
             )
         except subprocess.TimeoutExpired:
             self.test_failed()
-            print(
+            self.log(
                 f'"{command}" ran for more than {self._timeout}s, but was expected to execute faster.'
             )
             return False
@@ -506,20 +703,155 @@ class HttpTest:
         output = cp.stdout.decode()
         if expected_output not in cp.stdout.decode():
             self.test_failed()
-            print(f'"{command}" did not print "{expected_output}".')
-            print(f"---Program Output---\n{output}")
+            self.log(f'"{command}" did not print "{expected_output}".')
+            self.log(f"---Program Output---\n{output}")
+            return False
+
+        self.test_passed()
+        return True
+
+    # Send requests GET requests to url from concurrency threads and measure
+    # the latency of each request and the overall throughput. This is not a
+    # test, but the result can be passed to no_regression. Responses with a
+    # status in ok are counted as successful requests.
+    def measure(
+        self,
+        url: str,
+        requests: int = 500,
+        concurrency: int = 8,
+        ok: Tuple[int, ...] = (200,),
+    ) -> Dict[str, float]:
+        latencies: List[float] = []
+        errors: List[str] = []
+
+        def worker(count: int):
+            for _ in range(count):
+                start = time.perf_counter()
+                try:
+                    urllib.request.urlopen(url, timeout=5).read()
+                except urllib.error.HTTPError as e:
+                    if e.code not in ok:
+                        errors.append(str(e))
+                        continue
+                except (OSError, http.client.HTTPException) as e:
+                    errors.append(str(e))
+                    continue
+                latencies.append(time.perf_counter() - start)
+
+        counts = [requests // concurrency] * concurrency
+        for i in range(requests % concurrency):
+            counts[i] += 1
+
+        start = time.perf_counter()
+        with ThreadPoolExecutor(max_workers=concurrency) as pool:
+            list(pool.map(worker, counts))
+        elapsed = time.perf_counter() - start
+
+        latencies.sort()
+
+        def percentile(p: float) -> float:
+            if not latencies:
+                return float("inf")
+            return latencies[min(len(latencies) - 1, int(p * len(latencies)))]
+
+        return {
+            "requests": requests,
+            "concurrency": concurrency,
+            "errors": len(errors),
+            "p50_ms": percentile(0.50) * 1000,
+            "p99_ms": percentile(0.99) * 1000,
+            "throughput_rps": len(latencies) / elapsed,
+        }
+
+    # Record result for build in the json file at history and compare it with
+    # the last recorded result of a different build (or the build named by
+    # baseline). The test fails if the latency got higher or the throughput
+    # lower by more than threshold (0.2 means 20%) or if requests failed.
+    def no_regression(
+        self,
+        name: str,
+        build: str,
+        result: Dict[str, float],
+        history: str,
+        threshold: float = 0.2,
+        baseline: Optional[str] = None,
+    ) -> bool:
+        entries = []
+        if os.path.exists(history):
+            with open(history, "r") as f:
+                entries = json.load(f)
+
+        previous = None
+        for entry in reversed(entries):
+            if entry["name"] != name:
+                continue
+            if (baseline is None and entry["build"] != build) or (
+                entry["build"] == baseline
+            ):
+                previous = entry
+                break
+
+        entries.append(
+            {"name": name, "build": build, "time": time.time(), **result}
+        )
+        with open(history, "w") as f:
+            json.dump(entries, f, indent=2)
+
+        self.log(
+            f'{name}: p50 {result["p50_ms"]:.2f}ms, p99 {result["p99_ms"]:.2f}ms, '
+            + f'{result["throughput_rps"]:.0f} req/s (build {build})'
+        )
+
+        if result["errors"] > 0:
+            self.test_failed()
+            self.log(
+                f'{name}: {result["errors"]} of {result["requests"]} requests failed'
+            )
+            return False
+
+        if previous is None:
+            self.test_passed()
+            return True
+
+        worse = []
+        for key in ["p50_ms", "p99_ms"]:
+            if result[key] > previous[key] * (1 + threshold):
+                worse.append(f"{key} {previous[key]:.2f} -> {result[key]:.2f}")
+        key = "throughput_rps"
+        if result[key] < previous[key] * (1 - threshold):
+            worse.append(f"{key} {previous[key]:.0f} -> {result[key]:.0f}")
+
+        if worse:
+            self.test_failed()
+            self.log(
+                f'{name} got slower than build {previous["build"]}: '
+                + ", ".join(worse)
+            )
+            return False
+
+        self.test_passed()
+        return True
+
+    # This test fails if value is larger than limit. what describes the value
+    # in the error message.
+    def within_limit(self, what: str, value: float, limit: float) -> bool:
+        if value > limit:
+            self.test_failed()
+            self.log(f"{what} was {value}, but should be at most {limit}")
             return False
 
         self.test_passed()
         return True
 
     # Print a very simple statistics to stdout
-    def print_result(self):
+    def print_result(self) -> bool:
         self._create_dir()
-        print(f"\n{20*'-'} Statistics {20*'-'}")
+        self.cleanup()
+        self.log(f"\n{20*'-'} Statistics {20*'-'}")
         if self._tests_failed == 0:
-            print(f"🎉 All {self._tests} tests passed 🎉")
+            self.log(f"🎉 All {self._tests} tests passed 🎉")
         else:
-            print(
+            self.log(
                 f"⚠️  {self._tests_failed} out of {self._tests} tests failed. ⚠️"
             )
+        return self._tests_failed == 0
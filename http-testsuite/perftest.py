@@ -0,0 +1,71 @@
+from httptest import HttpTest, free_port
+from servertest import create_docroot
+import argparse
+import hashlib
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Measure latency and throughput of ./server and compare "
+        + "it with earlier builds"
+    )
+    parser.add_argument(
+        "--history",
+        default="perf-history.json",
+        help="file the results of every build are recorded in",
+    )
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=0.2,
+        help="allowed slowdown before a test fails (default: 0.2 = 20%%)",
+    )
+    parser.add_argument(
+        "--baseline",
+        help="compare against this build instead of the last other build",
+    )
+    parser.add_argument("-n", "--requests", type=int, default=500)
+    parser.add_argument("-c", "--concurrency", type=int, default=8)
+    args = parser.parse_args()
+
+    # Performance numbers are useless with valgrind, so it is always off here
+    h = HttpTest(valgrind=False)
+    create_docroot()
+
+    # A build is identified by the hash of the server binary
+    with open("./server", "rb") as f:
+        build = hashlib.sha256(f.read()).hexdigest()[:12]
+
+    port = free_port()
+    docroot = h.isolated_docroot("__docroot")
+    p = h.start_server(f"./server -p {port} {docroot}", port=port)
+    try:
+        url = f"http://localhost:{port}"
+        for name, path in [
+            ("index", "/"),
+            ("javascript", "/countdown.js"),
+            ("image", "/cat.png"),
+            ("stylesheet", "/solarized.css"),
+            ("not found", "/doesnotexist"),
+        ]:
+            result = h.measure(
+                url + path, args.requests, args.concurrency, ok=(200, 404)
+            )
+            h.no_regression(
+                name,
+                build,
+                result,
+                args.history,
+                args.threshold,
+                args.baseline,
+            )
+    finally:
+        h.stop_server(p, show_output=False)
+
+    if not h.print_result():
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
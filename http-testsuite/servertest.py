@@ -1,254 +1,636 @@
-from httptest import HttpTest
+from httptest import HttpTest, PeakMonitor, free_port, process_stats
+from concurrent.futures import ThreadPoolExecutor
+import argparse
 import os
+import shutil
+import socket
+import struct
+import sys
 import urllib.request
 import subprocess
 import time
 import http.client
 
 
+# The server binary to test and the settings of the stress tier, they can be
+# changed from the commandline.
+SERVER = "./server"
+STRESS_SIZE = 2048 * 1024 * 1024
+STRESS_CONNECTIONS = 200
+STRESS_RSS_LIMIT = 64 * 1024
+
+
 def main():
+    global SERVER, STRESS_SIZE, STRESS_CONNECTIONS, STRESS_RSS_LIMIT
+
+    parser = argparse.ArgumentParser(description="Test ./server")
+    parser.add_argument(
+        "--no-valgrind",
+        action="store_true",
+        help="run the servers without valgrind (faster, but no leak checks)",
+    )
+    parser.add_argument(
+        "-j",
+        "--jobs",
+        type=int,
+        default=0,
+        help="number of test groups to run at once (default: number of cpus)",
+    )
+    parser.add_argument(
+        "--server",
+        default=SERVER,
+        help="the server binary to test (default: ./server)",
+    )
+    parser.add_argument(
+        "--stress",
+        action="store_true",
+        help="also run the stress tests (large files, many connections, ...)",
+    )
+    parser.add_argument(
+        "--stress-size",
+        type=int,
+        default=STRESS_SIZE // (1024 * 1024),
+        help="size of the large file in MiB (default: 2048)",
+    )
+    parser.add_argument(
+        "--stress-connections",
+        type=int,
+        default=STRESS_CONNECTIONS,
+        help="number of simultaneous connections (default: 200)",
+    )
+    parser.add_argument(
+        "--stress-rss",
+        type=int,
+        default=STRESS_RSS_LIMIT // 1024,
+        help="allowed memory growth of the server in MiB (default: 64)",
+    )
+    args = parser.parse_args()
+    SERVER = args.server
+    STRESS_SIZE = args.stress_size * 1024 * 1024
+    STRESS_CONNECTIONS = args.stress_connections
+    STRESS_RSS_LIMIT = args.stress_rss * 1024
+
     # Create a test object
-    h = HttpTest()
+    valgrind = not args.no_valgrind and shutil.which("valgrind") is not None
+    h = HttpTest(valgrind=valgrind, jobs=args.jobs)
+    if not valgrind:
+        print("Running without valgrind, memory leaks won't be detected.\n")
 
     # Download some files from https://pan.vmars.tuwien.ac.at/osue/ to use in
     # the tests.
     create_docroot()
 
-    # Test the server with invalid arguments
-    h.is_returncode("./server", 1)
-    h.is_returncode("./server -p __docroot/", 1)
-    h.is_returncode("./server -p 1331 -p 1332 __docroot/", 1)
-    h.is_returncode("./server -p 12 __docroot/index.html", 1)
-
-    # Test the server with valid arguments
-    h.does_timeout("./server -p 1334 __docroot")
-    h.does_timeout("./server -p 1335 -i servertest.py ./__docroot/")
-
-    # Start a server in the background and test a couple of requests
-    p = h.start_server("./server -p 1337 __docroot")
-    try:
-
-        gzip_header = {"Accept-Encoding": "gzip"}
-
-        # Check response headers upon success
-        h.in_response_header("http://localhost:1337/", "Connection", "close")
-
-        index_size = os.path.getsize("__docroot/index.html")
-        h.in_response_header(
-            "http://localhost:1337/", "Content-Length", str(index_size)
-        )
-
-        date_text = time.strftime("%a, %d %b %y %T %Z", time.gmtime())
-        h.in_response_header("http://localhost:1337/", "Date", date_text)
-
-        if not h.in_response_header(
-            "http://localhost:1337/", "Content-Type", "text/html"
-        ):
-            print("NOTE: This is a bonus task.")
-
-        if not h.in_response_header(
-            "http://localhost:1337/countdown.js",
-            "Content-Type",
-            "application/javascript",
-        ):
-            print("NOTE: This is a bonus task.")
-
-        if not h.in_response_header(
-            "http://localhost:1337/solarized.css", "Content-Type", "text/css"
-        ):
-            print("NOTE: This is a bonus task.")
-
-        # Check if the response header contains the gzip if we request gzip
-        if not h.in_response_header(
-            "http://localhost:1337/",
-            "Content-Encoding",
-            "gzip",
-            headers=gzip_header,
-        ):
-            print("NOTE: This is a bonus task.")
-
-        # If the client doesn't tell the server that it understands gzip the
-        # server cannot answer with gzip
-        if not h.notin_response_header(
-            "http://localhost:1337/", "Content-Encoding", "gzip"
-        ):
-            print(
-                "NOTE: The server cannot send the client gzip data if the"
-                + "client didn't tell the server that it understands gzip"
-            )
-
-        # Check headers of failing requests
-        h.in_response_header(
-            "http://localhost:1337/doesnotexist", "Connection", "close"
-        )
-        h.in_response_header(
-            "http://localhost:1337/", "Connection", "close", method="POST"
-        )
-
-        # Check if response is the same as the file
-        h.compare_response_body(
-            "http://localhost:1337/", "__docroot/index.html"
-        )
-        h.compare_response_body(
-            "http://localhost:1337/index.html", "__docroot/index.html"
-        )
-        h.compare_response_body(
-            "http://localhost:1337/countdown.js", "__docroot/countdown.js"
-        )
-        h.compare_response_body(
-            "http://localhost:1337/cat.png", "__docroot/cat.png"
-        )
-        h.compare_response_body(
-            "http://localhost:1337/solarized.css", "__docroot/solarized.css"
-        )
-
-        h.compare_response_body(
-            "http://localhost:1337/",
-            "__docroot/index.html",
-            headers=gzip_header,
-        )
-        h.compare_response_body(
-            "http://localhost:1337/index.html",
-            "__docroot/index.html",
-            headers=gzip_header,
-        )
-        h.compare_response_body(
-            "http://localhost:1337/countdown.js",
-            "__docroot/countdown.js",
-            headers=gzip_header,
-        )
-        h.compare_response_body(
-            "http://localhost:1337/cat.png",
-            "__docroot/cat.png",
-            headers=gzip_header,
-        )
-        h.compare_response_body(
-            "http://localhost:1337/solarized.css",
-            "__docroot/solarized.css",
-            headers=gzip_header,
-        )
-
-        # Check the content-lenght
-        h.verify_content_length("http://localhost:1337/")
-        h.verify_content_length("http://localhost:1337/countdown.js")
-        h.verify_content_length("http://localhost:1337/cat.png")
-        h.verify_content_length("http://localhost:1337/solarized.css")
-        h.verify_content_length("http://localhost:1337/", headers=gzip_header)
-        h.verify_content_length(
-            "http://localhost:1337/countdown.js", headers=gzip_header
-        )
-        h.verify_content_length(
-            "http://localhost:1337/cat.png", headers=gzip_header
-        )
-        h.verify_content_length(
-            "http://localhost:1337/solarized.css", headers=gzip_header
-        )
-
-        # Check Status codes upon success
-        h.is_statuscode("http://localhost:1337/", 200)
-        h.is_statuscode("http://localhost:1337/index.html", 200)
-        h.is_statuscode("http://localhost:1337/countdown.js", 200)
-        h.is_statuscode("http://localhost:1337/cat.png", 200)
-        h.is_statuscode("http://localhost:1337/solarized.css", 200)
-        h.is_statuscode("http://localhost:1337/", 200, headers=gzip_header)
-        h.is_statuscode(
-            "http://localhost:1337/index.html", 200, headers=gzip_header
-        )
-        h.is_statuscode(
-            "http://localhost:1337/countdown.js", 200, headers=gzip_header
-        )
-        h.is_statuscode(
-            "http://localhost:1337/cat.png", 200, headers=gzip_header
-        )
-        h.is_statuscode(
-            "http://localhost:1337/solarized.css", 200, headers=gzip_header
+    # Every group runs in parallel with its own server on its own port and
+    # with its own copy of the docroot.
+    h.run_parallel(
+        [
+            test_arguments,
+            test_headers,
+            test_bodies,
+            test_content_length,
+            test_status_codes,
+            test_bad_requests,
+        ]
+    )
+
+    # The stress tests run one after another so that they don't distort each
+    # others measurements.
+    if args.stress:
+        h.run_parallel(
+            [
+                stress_large_file,
+                stress_connections,
+                stress_slowloris,
+                stress_disconnect,
+            ],
+            jobs=1,
         )
 
-        # Check status codes of failed requests
-        h.is_statuscode(
-            "http://localhost:1337/doesnotexist", 404, method="GET"
-        )
-        h.is_statuscode(
-            "http://localhost:1337/doesnotexist",
-            404,
-            method="GET",
-            headers=gzip_header,
-        )
-        h.is_statuscode("http://localhost:1337/index.html", 501, method="HEAD")
-        h.is_statuscode(
-            "http://localhost:1337/index.html",
-            501,
-            method="HEAD",
-            headers=gzip_header,
-        )
-        h.is_statuscode("http://localhost:1337/index.html", 501, method="POST")
-        h.is_statuscode("http://localhost:1337/index.html", 501, method="PUT")
-        h.is_statuscode(
-            "http://localhost:1337/index.html", 501, method="DELETE"
-        )
-        h.is_statuscode(
-            "http://localhost:1337/index.html", 501, method="CONNECT"
-        )
-        h.is_statuscode(
-            "http://localhost:1337/index.html", 501, method="OPTIONS"
-        )
-        h.is_statuscode(
-            "http://localhost:1337/index.html", 501, method="TRACE"
-        )
-        h.is_statuscode(
-            "http://localhost:1337/index.html", 501, method="PATCH"
-        )
-
-        # Now lets simulate a client so bad we have to write it ourself.
-        # Oh boy/girl this will be fun 😈
-        first = "GET / HTTP/1.0"
-        res = send_bad_request("localhost:1337", first)
-        if res.status == 400:
-            h.test_passed()
-        else:
-            h.test_failed()
-            print(
-                f'A request with "{first}" responded with status {res.status} instead of 400'
-            )
-
-        first = "GET / HTTP/1.3"
-        res = send_bad_request("localhost:1337", first)
-        if res.status == 400:
-            h.test_passed()
-        else:
-            h.test_failed()
-            print(
-                f'A request with "{first}" responded with status {res.status} instead of 400'
+    # Print the statistics and results
+    if not h.print_result():
+        sys.exit(1)
+
+
+# Test the server with invalid and valid arguments
+def test_arguments(h: HttpTest):
+    h.is_returncode(SERVER, 1)
+    h.is_returncode(f"{SERVER} -p __docroot/", 1)
+    h.is_returncode(
+        f"{SERVER} -p {free_port()} -p {free_port()} __docroot/", 1
+    )
+    h.is_returncode(f"{SERVER} -p 12 __docroot/index.html", 1)
+
+    h.does_timeout(f"{SERVER} -p {free_port()} __docroot")
+    h.does_timeout(f"{SERVER} -p {free_port()} -i servertest.py ./__docroot/")
+
+
+# Turn a test function into a group that starts its own server in the
+# background (on a free port with a private docroot), runs the test and
+# stops the server afterwards.
+def server_group(test):
+    def group(h: HttpTest):
+        port = free_port()
+        docroot = h.isolated_docroot("__docroot")
+        p = h.start_server(f"{SERVER} -p {port} {docroot}", port=port)
+        try:
+            test(h, f"http://localhost:{port}", f"localhost:{port}", docroot)
+        finally:
+            h.stop_server(p)
+
+    group.__name__ = test.__name__
+    return group
+
+
+# Check the headers of responses
+@server_group
+def test_headers(h: HttpTest, url: str, host: str, docroot: str):
+    gzip_header = {"Accept-Encoding": "gzip"}
+
+    # Check response headers upon success
+    h.in_response_header(f"{url}/", "Connection", "close")
+
+    index_size = os.path.getsize(f"{docroot}/index.html")
+    h.in_response_header(
+        f"{url}/", "Content-Length", str(index_size)
+    )
+
+    date_text = time.strftime("%a, %d %b %y %T %Z", time.gmtime())
+    h.in_response_header(f"{url}/", "Date", date_text)
+
+    if not h.in_response_header(
+        f"{url}/", "Content-Type", "text/html"
+    ):
+        h.log("NOTE: This is a bonus task.")
+
+    if not h.in_response_header(
+        f"{url}/countdown.js",
+        "Content-Type",
+        "application/javascript",
+    ):
+        h.log("NOTE: This is a bonus task.")
+
+    if not h.in_response_header(
+        f"{url}/solarized.css", "Content-Type", "text/css"
+    ):
+        h.log("NOTE: This is a bonus task.")
+
+    # Check if the response header contains the gzip if we request gzip
+    if not h.in_response_header(
+        f"{url}/",
+        "Content-Encoding",
+        "gzip",
+        headers=gzip_header,
+    ):
+        h.log("NOTE: This is a bonus task.")
+
+    # If the client doesn't tell the server that it understands gzip the
+    # server cannot answer with gzip
+    if not h.notin_response_header(
+        f"{url}/", "Content-Encoding", "gzip"
+    ):
+        h.log(
+            "NOTE: The server cannot send the client gzip data if the"
+            + "client didn't tell the server that it understands gzip"
+        )
+
+    # Check headers of failing requests
+    h.in_response_header(
+        f"{url}/doesnotexist", "Connection", "close"
+    )
+    h.in_response_header(
+        f"{url}/", "Connection", "close", method="POST"
+    )
+
+
+# Check if the responses contain the files
+@server_group
+def test_bodies(h: HttpTest, url: str, host: str, docroot: str):
+    gzip_header = {"Accept-Encoding": "gzip"}
+
+    # Check if response is the same as the file
+    h.compare_response_body(
+        f"{url}/", f"{docroot}/index.html"
+    )
+    h.compare_response_body(
+        f"{url}/index.html", f"{docroot}/index.html"
+    )
+    h.compare_response_body(
+        f"{url}/countdown.js", f"{docroot}/countdown.js"
+    )
+    h.compare_response_body(
+        f"{url}/cat.png", f"{docroot}/cat.png"
+    )
+    h.compare_response_body(
+        f"{url}/solarized.css", f"{docroot}/solarized.css"
+    )
+
+    h.compare_response_body(
+        f"{url}/",
+        f"{docroot}/index.html",
+        headers=gzip_header,
+    )
+    h.compare_response_body(
+        f"{url}/index.html",
+        f"{docroot}/index.html",
+        headers=gzip_header,
+    )
+    h.compare_response_body(
+        f"{url}/countdown.js",
+        f"{docroot}/countdown.js",
+        headers=gzip_header,
+    )
+    h.compare_response_body(
+        f"{url}/cat.png",
+        f"{docroot}/cat.png",
+        headers=gzip_header,
+    )
+    h.compare_response_body(
+        f"{url}/solarized.css",
+        f"{docroot}/solarized.css",
+        headers=gzip_header,
+    )
+
+
+# Check if the Content-Length matches the body
+@server_group
+def test_content_length(h: HttpTest, url: str, host: str, docroot: str):
+    gzip_header = {"Accept-Encoding": "gzip"}
+
+    # Check the content-lenght
+    h.verify_content_length(f"{url}/")
+    h.verify_content_length(f"{url}/countdown.js")
+    h.verify_content_length(f"{url}/cat.png")
+    h.verify_content_length(f"{url}/solarized.css")
+    h.verify_content_length(f"{url}/", headers=gzip_header)
+    h.verify_content_length(
+        f"{url}/countdown.js", headers=gzip_header
+    )
+    h.verify_content_length(
+        f"{url}/cat.png", headers=gzip_header
+    )
+    h.verify_content_length(
+        f"{url}/solarized.css", headers=gzip_header
+    )
+
+
+# Check the status codes for good and bad requests
+@server_group
+def test_status_codes(h: HttpTest, url: str, host: str, docroot: str):
+    gzip_header = {"Accept-Encoding": "gzip"}
+
+    # Check Status codes upon success
+    h.is_statuscode(f"{url}/", 200)
+    h.is_statuscode(f"{url}/index.html", 200)
+    h.is_statuscode(f"{url}/countdown.js", 200)
+    h.is_statuscode(f"{url}/cat.png", 200)
+    h.is_statuscode(f"{url}/solarized.css", 200)
+    h.is_statuscode(f"{url}/", 200, headers=gzip_header)
+    h.is_statuscode(
+        f"{url}/index.html", 200, headers=gzip_header
+    )
+    h.is_statuscode(
+        f"{url}/countdown.js", 200, headers=gzip_header
+    )
+    h.is_statuscode(
+        f"{url}/cat.png", 200, headers=gzip_header
+    )
+    h.is_statuscode(
+        f"{url}/solarized.css", 200, headers=gzip_header
+    )
+
+    # Check status codes of failed requests
+    h.is_statuscode(
+        f"{url}/doesnotexist", 404, method="GET"
+    )
+    h.is_statuscode(
+        f"{url}/doesnotexist",
+        404,
+        method="GET",
+        headers=gzip_header,
+    )
+    h.is_statuscode(f"{url}/index.html", 501, method="HEAD")
+    h.is_statuscode(
+        f"{url}/index.html",
+        501,
+        method="HEAD",
+        headers=gzip_header,
+    )
+    h.is_statuscode(f"{url}/index.html", 501, method="POST")
+    h.is_statuscode(f"{url}/index.html", 501, method="PUT")
+    h.is_statuscode(
+        f"{url}/index.html", 501, method="DELETE"
+    )
+    h.is_statuscode(
+        f"{url}/index.html", 501, method="CONNECT"
+    )
+    h.is_statuscode(
+        f"{url}/index.html", 501, method="OPTIONS"
+    )
+    h.is_statuscode(
+        f"{url}/index.html", 501, method="TRACE"
+    )
+    h.is_statuscode(
+        f"{url}/index.html", 501, method="PATCH"
+    )
+
+
+# Send malformed requests the server has to reject
+@server_group
+def test_bad_requests(h: HttpTest, url: str, host: str, docroot: str):
+    # Now lets simulate a client so bad we have to write it ourself.
+    # Oh boy/girl this will be fun 😈
+    first = "GET / HTTP/1.0"
+    res = send_bad_request(host, first)
+    if res.status == 400:
+        h.test_passed()
+    else:
+        h.test_failed()
+        h.log(
+            f'A request with "{first}" responded with status {res.status} instead of 400'
+        )
+
+    first = "GET / HTTP/1.3"
+    res = send_bad_request(host, first)
+    if res.status == 400:
+        h.test_passed()
+    else:
+        h.test_failed()
+        h.log(
+            f'A request with "{first}" responded with status {res.status} instead of 400'
+        )
+
+    first = "GET HTTP/1.1"
+    res = send_bad_request(host, first)
+    if res.status == 400:
+        h.test_passed()
+    else:
+        h.test_failed()
+        h.log(
+            f'A request with "{first}" responded with status {res.status} instead of 400'
+        )
+
+    first = "GET / HTTP/1.1 supersecrethiddenfieldthatshouldnotbeaccepted"
+    res = send_bad_request(host, first)
+    if res.status == 400:
+        h.test_passed()
+    else:
+        h.test_failed()
+        h.log(
+            f'A request with "{first}" responded with status {res.status} instead of 400'
+        )
+
+
+# Like server_group, but the server is started without valgrind and the test
+# gets the server process to inspect its memory and filedescriptors.
+def stress_group(test):
+    def group(h: HttpTest):
+        port = free_port()
+        docroot = h.isolated_docroot("__docroot")
+        p = h.start_server(
+            f"{SERVER} -p {port} {docroot}", port=port, valgrind=False
+        )
+        try:
+            test(h, p, port, docroot)
+        finally:
+            h.stop_server(p, show_output=False)
+
+    group.__name__ = test.__name__
+    return group
+
+
+# Request a file larger than the memory we allow the server to use. Servers
+# that read the whole file into memory fail here.
+@stress_group
+def stress_large_file(
+    h: HttpTest, server: subprocess.Popen, port: int, docroot: str
+):
+    create_sparse_file(os.path.join(docroot, "large.bin"), STRESS_SIZE)
+
+    before = process_stats(server.pid)
+    with PeakMonitor(server.pid) as monitor:
+        start = time.monotonic()
+        status, size = raw_get(port, "/large.bin")
+        elapsed = time.monotonic() - start
+
+    mib = size / (1024 * 1024)
+    h.log(f"Served {mib:.0f} MiB in {elapsed:.2f}s ({mib / elapsed:.0f} MiB/s)")
+    if status == 200 and size == STRESS_SIZE:
+        h.test_passed()
+    else:
+        h.test_failed()
+        h.log(
+            f"Requesting a {STRESS_SIZE} bytes large file returned status "
+            + f"{status} and {size} bytes"
+        )
+
+    h.within_limit(
+        "Memory growth (KiB) while serving a large file",
+        monitor.peak_rss_kb - before["rss_kb"],
+        STRESS_RSS_LIMIT,
+    )
+    h.within_limit(
+        "Open filedescriptors after serving a large file",
+        settled_fds(server.pid, before["fds"]),
+        before["fds"],
+    )
+
+
+# Open a lot of connections at the same time, all of them should be answered.
+@stress_group
+def stress_connections(
+    h: HttpTest, server: subprocess.Popen, port: int, docroot: str
+):
+    before = process_stats(server.pid)
+    with PeakMonitor(server.pid) as monitor:
+        start = time.monotonic()
+        with ThreadPoolExecutor(max_workers=STRESS_CONNECTIONS) as pool:
+            results = list(
+                pool.map(
+                    lambda _: raw_get(port, "/index.html"),
+                    range(STRESS_CONNECTIONS),
+                )
             )
-
-        first = "GET HTTP/1.1"
-        res = send_bad_request("localhost:1337", first)
-        if res.status == 400:
-            h.test_passed()
-        else:
-            h.test_failed()
-            print(
-                f'A request with "{first}" responded with status {res.status} instead of 400'
+        elapsed = time.monotonic() - start
+
+    # Servers with admission control may reject clients when they are
+    # overloaded, that counts as answered as long as they do it properly.
+    ok = sum(1 for status, _ in results if status == 200)
+    rejected = sum(1 for status, _ in results if status in (429, 503))
+    h.log(
+        f"{ok} of {STRESS_CONNECTIONS} simultaneous requests succeeded and "
+        + f"{rejected} were rejected in {elapsed:.2f}s "
+        + f"({ok / elapsed:.0f} req/s)"
+    )
+    if ok + rejected == STRESS_CONNECTIONS:
+        h.test_passed()
+    else:
+        h.test_failed()
+        h.log(
+            f"{STRESS_CONNECTIONS - ok - rejected} simultaneous requests failed"
+        )
+
+    h.within_limit(
+        f"Memory growth (KiB) with {STRESS_CONNECTIONS} connections",
+        monitor.peak_rss_kb - before["rss_kb"],
+        STRESS_RSS_LIMIT,
+    )
+    h.within_limit(
+        f"Open filedescriptors after {STRESS_CONNECTIONS} connections",
+        settled_fds(server.pid, before["fds"]),
+        before["fds"],
+    )
+
+
+# Open connections that send only half of the request header and then stall.
+# The server should still answer other clients while they are open.
+@stress_group
+def stress_slowloris(
+    h: HttpTest, server: subprocess.Popen, port: int, docroot: str
+):
+    before = process_stats(server.pid)
+    slow = []
+    for _ in range(50):
+        try:
+            s = socket.create_connection(("localhost", port), 2)
+        except OSError:
+            # The listen backlog is full, which is enough to block the server
+            break
+        s.sendall(b"GET /index.html HTTP/1.1\r\nHost: loc")
+        slow.append(s)
+
+    status, _ = raw_get(port, "/index.html", timeout=5)
+    if status == 200:
+        h.test_passed()
+    else:
+        h.test_failed()
+        h.log("The server didn't answer while slow clients were connected.")
+        h.log("NOTE: Only servers with read timeouts or concurrency pass this.")
+
+    for s in slow:
+        s.close()
+
+    status, _ = raw_get(port, "/index.html", timeout=5)
+    if status == 200:
+        h.test_passed()
+    else:
+        h.test_failed()
+        h.log("The server didn't recover after slow clients disconnected.")
+        if server.poll() is not None:
+            h.log(f"The server exited with {server.returncode}.")
+
+    h.within_limit(
+        "Open filedescriptors after slow clients disconnected",
+        settled_fds(server.pid, before["fds"]),
+        before["fds"],
+    )
+
+
+# Clients that disconnect while the body is still being sent must not crash
+# the server (e.g. with SIGPIPE) or leak its filedescriptors.
+@stress_group
+def stress_disconnect(
+    h: HttpTest, server: subprocess.Popen, port: int, docroot: str
+):
+    create_sparse_file(
+        os.path.join(docroot, "large.bin"), min(STRESS_SIZE, 256 * 1024 * 1024)
+    )
+
+    before = process_stats(server.pid)
+    for _ in range(20):
+        try:
+            s = socket.create_connection(("localhost", port), 5)
+            s.sendall(
+                b"GET /large.bin HTTP/1.1\r\nHost: localhost\r\n"
+                + b"Connection: close\r\n\r\n"
             )
-
-        first = "GET / HTTP/1.1 supersecrethiddenfieldthatshouldnotbeaccepted"
-        res = send_bad_request("localhost:1337", first)
-        if res.status == 400:
-            h.test_passed()
-        else:
-            h.test_failed()
-            print(
-                f'A request with "{first}" responded with status {res.status} instead of 400'
+            s.recv(64 * 1024)
+        except OSError:
+            # The server died or refused us, checked below
+            break
+        # Close with RST instead of FIN, like a crashing client would
+        s.setsockopt(
+            socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0)
+        )
+        s.close()
+
+    time.sleep(0.5)
+    if server.poll() is None:
+        h.test_passed()
+    else:
+        h.test_failed()
+        h.log(
+            f"The server exited with {server.returncode} after clients "
+            + "disconnected in the middle of the body."
+        )
+        return
+
+    status, _ = raw_get(port, "/index.html", timeout=5)
+    if status == 200:
+        h.test_passed()
+    else:
+        h.test_failed()
+        h.log("The server didn't answer after clients disconnected.")
+
+    h.within_limit(
+        "Open filedescriptors after clients disconnected",
+        settled_fds(server.pid, before["fds"]),
+        before["fds"],
+    )
+
+
+# Create a file of size bytes without writing them to disk.
+def create_sparse_file(path: str, size: int):
+    with open(path, "wb") as f:
+        f.truncate(size)
+
+
+# Send a GET request for path and read the response without keeping the body
+# in memory. Returns the status code (0 if there was none) and the number of
+# bytes in the body.
+def raw_get(port: int, path: str, timeout: float = 30):
+    try:
+        s = socket.create_connection(("localhost", port), timeout)
+    except OSError:
+        return 0, 0
+
+    with s:
+        try:
+            s.sendall(
+                f"GET {path} HTTP/1.1\r\nHost: localhost\r\n".encode()
+                + b"Connection: close\r\n\r\n"
             )
+            head = b""
+            while b"\r\n\r\n" not in head:
+                chunk = s.recv(4096)
+                if not chunk:
+                    return 0, 0
+                head += chunk
+
+            head, body = head.split(b"\r\n\r\n", 1)
+            size = len(body)
+            while True:
+                chunk = s.recv(1024 * 1024)
+                if not chunk:
+                    break
+                size += len(chunk)
+        except OSError:
+            return 0, 0
 
-    except Exception as e:
-        h.stop_server(p)
-        raise e
-
-    h.stop_server(p)
-
-    # Print the statistics and results
-    h.print_result()
+    try:
+        return int(head.split(b" ")[1]), size
+    except (IndexError, ValueError):
+        return 0, size
+
+
+# Wait up to timeout seconds for the number of open filedescriptors of the
+# server to drop to expected and return the number it has.
+def settled_fds(pid: int, expected: int, timeout: float = 2) -> int:
+    deadline = time.monotonic() + timeout
+    fds = process_stats(pid)["fds"]
+    while fds > expected and time.monotonic() < deadline:
+        time.sleep(0.05)
+        fds = process_stats(pid)["fds"]
+    return fds
 
 
 # Send a really bad request to the server.